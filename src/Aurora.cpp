@@ -23,10 +23,12 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.*/
 
 #include <iostream>
+#include <future>
 
 #include "ArScene.h"
 #include "ArIntegrator.h"
 #include "ArParser.h"
+#include "ArFilm.h"
 
 using namespace std;
 using namespace Aurora;
@@ -40,7 +42,31 @@ static void usage(const char *msg = nullptr)
 
 	fprintf(stderr, R"(usage: Aurora [<options>] <filename.json...>
 Rendering options:
+  --batch              Parse and preprocess the next scene file while the
+                       current one is rendering.
+  --checkpoint <sec>   Render progressively and save the raw film and its
+                       number of samples per pixel to <image>.checkpoint
+                       every <sec> seconds and at the end of the render.
   --help               Print this help text.
+  --hugepages <mode>   Back the per-thread memory arenas with huge pages
+                       (none, transparent or explicit). Default: none.
+  --liveview <file>    Publish the film to the memory-mapped <file> while
+                       rendering, e.g. /dev/shm/aurora for a live preview.
+  --merge              Treat the input files as film snapshots written by
+                       --shard and merge them into the final image. All N
+                       shards of the render have to be given once each.
+  --passspp <num>      Render progressively in passes of <num> samples per
+                       pixel over the whole image. Default: all at once.
+  --resume             Continue the render from <image>.checkpoint and only
+                       take the samples per pixel it doesn't hold yet.
+  --shard <i/N>        Render only the i-th of N disjoint subsets of image
+                       tiles and write a film snapshot <image>.shard<i>of<N>
+                       instead of the image.
+  --timelimit <sec>    Render progressively and don't start another pass
+                       that would end after <sec> seconds.
+  --writeinterval <sec>
+                       Render progressively and write the image after a
+                       pass once <sec> seconds passed since the last write.
 
 Logging options:
   --logdir <dir>       Specify directory that log files should be written to.
@@ -67,6 +93,7 @@ int main(int argc, char *argv[])
 	}
 
 	std::vector<std::string> filenames;
+	bool batch = false, merge = false;
 	for (int i = 1; i < argc; ++i) 
 	{
 		if (!strcmp(argv[i], "--logdir") || !strcmp(argv[i], "-logdir")) 
@@ -100,6 +127,78 @@ int main(int argc, char *argv[])
 		{
 			FLAGS_v = atoi(argv[i] + 4);
 		}
+		else if (!strcmp(argv[i], "--batch") || !strcmp(argv[i], "-batch"))
+		{
+			batch = true;
+		}
+		else if (!strcmp(argv[i], "--checkpoint") || !strcmp(argv[i], "-checkpoint"))
+		{
+			if (i + 1 == argc)
+				usage("missing value after --checkpoint argument");
+			aOptions.checkpointInterval = atof(argv[++i]);
+			if (aOptions.checkpointInterval <= 0)
+				usage("invalid value after --checkpoint argument, expected a positive number");
+		}
+		else if (!strcmp(argv[i], "--resume") || !strcmp(argv[i], "-resume"))
+		{
+			aOptions.resume = true;
+		}
+		else if (!strcmp(argv[i], "--liveview") || !strcmp(argv[i], "-liveview"))
+		{
+			if (i + 1 == argc)
+				usage("missing value after --liveview argument");
+			aOptions.liveFramebuffer = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--merge") || !strcmp(argv[i], "-merge"))
+		{
+			merge = true;
+		}
+		else if (!strcmp(argv[i], "--shard") || !strcmp(argv[i], "-shard"))
+		{
+			if (i + 1 == argc)
+				usage("missing value after --shard argument");
+			if (sscanf(argv[++i], "%d/%d", &aOptions.shardIndex, &aOptions.shardCount) != 2 ||
+				aOptions.shardCount < 1 || aOptions.shardIndex < 0 || aOptions.shardIndex >= aOptions.shardCount)
+				usage("invalid shard after --shard argument, expected i/N with 0 <= i < N");
+		}
+		else if (!strcmp(argv[i], "--passspp") || !strcmp(argv[i], "-passspp"))
+		{
+			if (i + 1 == argc)
+				usage("missing value after --passspp argument");
+			aOptions.passSpp = atoi(argv[++i]);
+			if (aOptions.passSpp < 1)
+				usage("invalid value after --passspp argument, expected a positive number");
+		}
+		else if (!strcmp(argv[i], "--timelimit") || !strcmp(argv[i], "-timelimit"))
+		{
+			if (i + 1 == argc)
+				usage("missing value after --timelimit argument");
+			aOptions.timeLimit = atof(argv[++i]);
+			if (aOptions.timeLimit <= 0)
+				usage("invalid value after --timelimit argument, expected a positive number");
+		}
+		else if (!strcmp(argv[i], "--writeinterval") || !strcmp(argv[i], "-writeinterval"))
+		{
+			if (i + 1 == argc)
+				usage("missing value after --writeinterval argument");
+			aOptions.writeInterval = atof(argv[++i]);
+			if (aOptions.writeInterval <= 0)
+				usage("invalid value after --writeinterval argument, expected a positive number");
+		}
+		else if (!strcmp(argv[i], "--hugepages") || !strcmp(argv[i], "-hugepages"))
+		{
+			if (i + 1 == argc)
+				usage("missing value after --hugepages argument");
+			const char *mode = argv[++i];
+			if (!strcmp(mode, "none"))
+				aOptions.hugePages = AHugePages::ANone;
+			else if (!strcmp(mode, "transparent"))
+				aOptions.hugePages = AHugePages::ATransparent;
+			else if (!strcmp(mode, "explicit"))
+				aOptions.hugePages = AHugePages::AExplicit;
+			else
+				usage("unknown mode after --hugepages argument");
+		}
 		else if (!strcmp(argv[i], "--logtostderr")) 
 		{
 			FLAGS_logtostderr = true;
@@ -124,24 +223,96 @@ int main(int argc, char *argv[])
 		printf("See the file LICENSE.txt for the conditions of the license.\n");
 	}
 
-	auto parsing_func = [](const std::string &filename) -> void
+	if (merge)
+	{
+		//Note: sum up the raw pixel values of all the shards and write out the final image, the
+		//      snapshots have to be exactly the shards 0 to N - 1 of one render
+		if (filenames.empty())
+			usage("need to set the film snapshots to merge");
+		AFilm::ASnapshotInfo info;
+		AFilm::ptr film = AFilm::readSnapshot(filenames[0], info);
+		if (film == nullptr)
+			return 1;
+		std::vector<std::string> shards(info.shardCount);
+		shards[info.shardIndex] = filenames[0];
+		for (size_t i = 1; i < filenames.size(); ++i)
+		{
+			AFilm::ASnapshotInfo shardInfo;
+			if (!film->mergeSnapshot(filenames[i], &shardInfo))
+				return 1;
+			if (shardInfo.shardCount != info.shardCount || shardInfo.samplesPerPixel != info.samplesPerPixel)
+			{
+				LOG(ERROR) << filenames[i] << " is shard " << shardInfo.shardIndex << " of " << shardInfo.shardCount
+					<< " with " << shardInfo.samplesPerPixel << " samples per pixel, but " << filenames[0] << " is shard "
+					<< info.shardIndex << " of " << info.shardCount << " with " << info.samplesPerPixel << " samples per pixel";
+				return 1;
+			}
+			if (!shards[shardInfo.shardIndex].empty())
+			{
+				LOG(ERROR) << filenames[i] << " and " << shards[shardInfo.shardIndex] << " are both shard "
+					<< shardInfo.shardIndex << " of " << shardInfo.shardCount;
+				return 1;
+			}
+			shards[shardInfo.shardIndex] = filenames[i];
+		}
+		for (int i = 0; i < info.shardCount; ++i)
+		{
+			if (shards[i].empty())
+			{
+				LOG(ERROR) << "Shard " << i << " of " << info.shardCount << " is missing";
+				return 1;
+			}
+		}
+		film->writeImageToFile(film->getSplatScale());
+		AFilm::waitForPendingWrites();
+		return 0;
+	}
+
+	struct ARenderJob
 	{
 		AScene::ptr scene = nullptr;
 		AIntegrator::ptr integrator = nullptr;
+	};
+
+	auto parsing_func = [](const std::string &filename) -> ARenderJob
+	{
+		ARenderJob job;
 
-		AParser::parser(filename, scene, integrator);
+		AParser::parser(filename, job.scene, job.integrator);
 
-		CHECK_NE(scene, nullptr);
-		CHECK_NE(integrator, nullptr);
+		CHECK_NE(job.scene, nullptr);
+		CHECK_NE(job.integrator, nullptr);
 
-		integrator->preprocess(*scene);
-		integrator->render(*scene);
+		job.integrator->preprocess(*job.scene);
+		return job;
 	};
 	
-	for (const auto & f : filenames)
+	if (batch && filenames.size() > 1)
 	{
-		parsing_func(f);
+		//Note: scene i + 1 is parsed on a background thread while scene i is rendered,
+		//      both share the same worker threads and mesh cache
+		std::future<ARenderJob> next = std::async(std::launch::async, parsing_func, filenames[0]);
+		for (size_t i = 0; i < filenames.size(); ++i)
+		{
+			ARenderJob job = next.get();
+			if (i + 1 < filenames.size())
+			{
+				next = std::async(std::launch::async, parsing_func, filenames[i + 1]);
+			}
+			job.integrator->render(*job.scene);
+		}
 	}
+	else
+	{
+		for (const auto & f : filenames)
+		{
+			ARenderJob job = parsing_func(f);
+			job.integrator->render(*job.scene);
+		}
+	}
+
+	// Images are encoded in the background, make sure all of them are on disk
+	AFilm::waitForPendingWrites();
 
 	return 0;
 }
\ No newline at end of file
@@ -391,6 +391,173 @@ namespace Aurora
 		return false;
 	}
 
+	void AKdTree::occluded(const ARay *rays, int nRays, bool *occluded) const
+	{
+		for (int first = 0; first < nRays; first += aKdMaxPacketSize)
+		{
+			occludedPacket(rays + first, glm::min(nRays - first, aKdMaxPacketSize), occluded + first);
+		}
+	}
+
+	void AKdTree::occludedPacket(const ARay *rays, int nRays, bool *occluded) const
+	{
+		// Note: the nodes are fetched once for all the rays that visit them. The packet follows the
+		//       order of its first ray, the other rays only differ in the children they visit and
+		//       their ranges, which are computed per ray. Shadow rays of the same shading point
+		//       usually share their origin, the side of a split plane they start on is then known
+		//       for all of them at once.
+		constexpr int maxTodo = 64;
+		AKdPacketToDo todo[maxTodo];
+		int todoPos = 0;
+
+		// Compute initial parametric ranges of rays inside kd-tree extent
+		AVector3f invDir[aKdMaxPacketSize];
+		bool sharedOrigin = true;
+		AKdPacketToDo &root = todo[todoPos++];
+		root.node = &m_nodes[0];
+		root.nRays = 0;
+		for (int i = 0; i < nRays; ++i)
+		{
+			occluded[i] = false;
+			sharedOrigin = sharedOrigin && rays[i].m_origin == rays[0].m_origin;
+			invDir[i] = AVector3f(1 / rays[i].m_dir.x, 1 / rays[i].m_dir.y, 1 / rays[i].m_dir.z);
+			Float tMin, tMax;
+			if (m_bounds.hit(rays[i], tMin, tMax))
+			{
+				root.rays[root.nRays] = i;
+				root.tMin[root.nRays] = tMin;
+				root.tMax[root.nRays] = tMax;
+				++root.nRays;
+			}
+		}
+		int nRemaining = root.nRays;
+		if (nRemaining == 0)
+		{
+			return;
+		}
+
+		while (todoPos > 0)
+		{
+			// Grab next packet to process from todo list, dropping the rays found occluded meanwhile
+			AKdPacketToDo &packet = todo[--todoPos];
+			AKdPacketToDo current;
+			current.node = packet.node;
+			current.nRays = 0;
+			for (int i = 0; i < packet.nRays; ++i)
+			{
+				if (occluded[packet.rays[i]])
+					continue;
+				current.rays[current.nRays] = packet.rays[i];
+				current.tMin[current.nRays] = packet.tMin[i];
+				current.tMax[current.nRays] = packet.tMax[i];
+				++current.nRays;
+			}
+
+			const AKdTreeNode *currNode = current.node;
+			while (current.nRays > 0)
+			{
+				if (currNode->isLeaf())
+				{
+					// Check for shadow ray intersections inside leaf node, hitable by hitable
+					int nHitables = currNode->numHitables();
+					for (int h = 0; h < nHitables; ++h)
+					{
+						int hitableIndex = (nHitables == 1) ? currNode->m_oneHitable :
+							m_hitableIndices[currNode->m_hitableIndicesOffset + h];
+						const AHitable::ptr &p = m_hitables[hitableIndex];
+						for (int i = 0; i < current.nRays; ++i)
+						{
+							int r = current.rays[i];
+							if (!occluded[r] && p->hit(rays[r]))
+							{
+								occluded[r] = true;
+								if (--nRemaining == 0)
+									return;
+							}
+						}
+					}
+					break;
+				}
+
+				// Process kd-tree interior node
+				int axis = currNode->splitAxis();
+				Float split = currNode->splitPos();
+				const AKdTreeNode *below = currNode + 1;
+				const AKdTreeNode *above = &m_nodes[currNode->aboveChild()];
+
+				const ARay &lead = rays[current.rays[0]];
+				bool packetBelowFirst = (lead.m_origin[axis] < split) ||
+					(lead.m_origin[axis] == split && lead.m_dir[axis] <= 0);
+				bool sharedSide = sharedOrigin && lead.m_origin[axis] != split;
+
+				// Split the packet into the rays visiting the near and the far child, the near
+				// ones are compacted in place and the far ones are enqueued
+				AKdPacketToDo *far = (todoPos < maxTodo) ? &todo[todoPos] : nullptr;
+				if (far != nullptr)
+				{
+					far->node = packetBelowFirst ? above : below;
+					far->nRays = 0;
+				}
+				int nNear = 0;
+				for (int i = 0; i < current.nRays; ++i)
+				{
+					int r = current.rays[i];
+					const ARay &ray = rays[r];
+					Float tMin = current.tMin[i], tMax = current.tMax[i];
+					Float tPlane = (split - ray.m_origin[axis]) * invDir[r][axis];
+					bool belowFirst = sharedSide ? packetBelowFirst : (ray.m_origin[axis] < split) ||
+						(ray.m_origin[axis] == split && ray.m_dir[axis] <= 0);
+
+					// Ranges of the ray in its first and second child, empty if it doesn't visit them
+					Float firstMin = tMin, firstMax = tMax, secondMin = tMin, secondMax = tMax;
+					bool visitFirst = true, visitSecond = true;
+					if (tPlane > tMax || tPlane <= 0)
+					{
+						visitSecond = false;
+					}
+					else if (tPlane < tMin)
+					{
+						visitFirst = false;
+					}
+					else
+					{
+						firstMax = tPlane;
+						secondMin = tPlane;
+					}
+
+					bool nearIsFirst = belowFirst == packetBelowFirst;
+					bool visitNear = nearIsFirst ? visitFirst : visitSecond;
+					bool visitFar = nearIsFirst ? visitSecond : visitFirst;
+					if (visitNear)
+					{
+						current.rays[nNear] = r;
+						current.tMin[nNear] = nearIsFirst ? firstMin : secondMin;
+						current.tMax[nNear] = nearIsFirst ? firstMax : secondMax;
+						++nNear;
+					}
+					if (visitFar)
+					{
+						if (far == nullptr)
+						{
+							LOG(FATAL) << "KdTree packet todo list overflow";
+						}
+						far->rays[far->nRays] = r;
+						far->tMin[far->nRays] = nearIsFirst ? secondMin : firstMin;
+						far->tMax[far->nRays] = nearIsFirst ? secondMax : firstMax;
+						++far->nRays;
+					}
+				}
+
+				if (far != nullptr && far->nRays > 0)
+				{
+					++todoPos;
+				}
+				current.nRays = nNear;
+				currNode = packetBelowFirst ? below : above;
+			}
+		}
+	}
+
 	bool AKdTree::hit(const ARay &ray, ASurfaceInteraction &isect) const
 	{
 		// Compute initial parametric range of ray inside kd-tree extent
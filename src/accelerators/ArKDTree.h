@@ -23,10 +23,15 @@ namespace Aurora
 		virtual bool hit(const ARay &ray) const override;
 		virtual bool hit(const ARay &ray, ASurfaceInteraction &iset) const override;
 
+		virtual void occluded(const ARay *rays, int nRays, bool *occluded) const override;
+
 		virtual std::string toString() const override { return "KdTree[]"; }
 
 	private:
 
+		// Trace up to aKdMaxPacketSize shadow rays through the tree together
+		void occludedPacket(const ARay *rays, int nRays, bool *occluded) const;
+
 		void buildTree(int nodeNum, const ABounds3f &bounds,
 			const std::vector<ABounds3f> &primBounds, int *primNums,
 			int nprims, int depth,
@@ -51,6 +56,17 @@ namespace Aurora
 		const AKdTreeNode *node;
 		Float tMin, tMax;
 	};
+
+	constexpr int aKdMaxPacketSize = 16;
+
+	//Note: shadow rays visiting a node together, every ray keeps its own parametric range
+	struct AKdPacketToDo
+	{
+		const AKdTreeNode *node;
+		int nRays;
+		int rays[aKdMaxPacketSize];
+		Float tMin[aKdMaxPacketSize], tMax[aKdMaxPacketSize];
+	};
 }
 
 #endif
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "ArPerspectiveCamera.h"
 
+#include "ArLight.h"
+
 namespace Aurora
 {
 	AURORA_REGISTER_CLASS(APerspectiveCamera, "Perspective")
@@ -32,6 +34,8 @@ namespace Aurora
 
 	void APerspectiveCamera::initialize()
 	{
+		AProjectiveCamera::initialize();
+
 		// Compute image plane bounds at $z=1$ for _PerspectiveCamera_
 		AVector2i res = m_film->getResolution();
 		AVector3f pMin = m_rasterToCamera(AVector3f(0, 0, 0), 1.0f);
@@ -39,8 +43,6 @@ namespace Aurora
 		pMin /= pMin.z;
 		pMax /= pMax.z;
 		A = glm::abs((pMax.x - pMin.x) * (pMax.y - pMin.y));
-
-		AProjectiveCamera::initialize();
 	}
 
 	Float APerspectiveCamera::castingRay(const ACameraSample &sample, ARay &ray) const
@@ -52,4 +54,80 @@ namespace Aurora
 		ray = m_cameraToWorld(ray);
 		return 1.f;
 	}
+
+	ASpectrum APerspectiveCamera::We(const ARay &ray, AVector2f *pRaster2) const
+	{
+		// Check if the ray direction is forward-facing
+		Float cosTheta = dot(ray.direction(), m_cameraToWorld(AVector3f(0, 0, 1), 0.0f));
+		if (cosTheta <= 0)
+			return 0;
+
+		// Map ray $(\p{}, \w{})$ onto the raster grid at $z=1$
+		AVector3f pFocus = ray(1 / cosTheta);
+		AVector3f pRaster = inverse(m_rasterToCamera)(inverse(m_cameraToWorld)(pFocus, 1.0f), 1.0f);
+
+		// Return raster position if requested
+		if (pRaster2 != nullptr)
+			*pRaster2 = AVector2f(pRaster.x, pRaster.y);
+
+		// Return zero importance for out of bounds points
+		ABounds2i sampleBounds = m_film->getSampleBounds();
+		if (pRaster.x < sampleBounds.m_pMin.x || pRaster.x >= sampleBounds.m_pMax.x ||
+			pRaster.y < sampleBounds.m_pMin.y || pRaster.y >= sampleBounds.m_pMax.y)
+			return 0;
+
+		// Return importance of the pinhole camera for the point on the image plane
+		Float cos2Theta = cosTheta * cosTheta;
+		return ASpectrum(1 / (A * cos2Theta * cos2Theta));
+	}
+
+	void APerspectiveCamera::pdf_We(const ARay &ray, Float &pdfPos, Float &pdfDir) const
+	{
+		// Return zero probability for out of bounds points
+		Float cosTheta = dot(ray.direction(), m_cameraToWorld(AVector3f(0, 0, 1), 0.0f));
+		if (cosTheta <= 0)
+		{
+			pdfPos = pdfDir = 0;
+			return;
+		}
+
+		AVector3f pFocus = ray(1 / cosTheta);
+		AVector3f pRaster = inverse(m_rasterToCamera)(inverse(m_cameraToWorld)(pFocus, 1.0f), 1.0f);
+
+		ABounds2i sampleBounds = m_film->getSampleBounds();
+		if (pRaster.x < sampleBounds.m_pMin.x || pRaster.x >= sampleBounds.m_pMax.x ||
+			pRaster.y < sampleBounds.m_pMin.y || pRaster.y >= sampleBounds.m_pMax.y)
+		{
+			pdfPos = pdfDir = 0;
+			return;
+		}
+
+		//Note: the pinhole is treated as a lens of unit area, the factors cancel out in the estimates
+		pdfPos = 1;
+		pdfDir = 1 / (A * cosTheta * cosTheta * cosTheta);
+	}
+
+	ASpectrum APerspectiveCamera::sample_Wi(const AInteraction &ref, const AVector2f &u,
+		AVector3f &wi, Float &pdf, AVector2f &pRaster, AVisibilityTester &vis) const
+	{
+		// The pinhole is the only point on the lens
+		AVector3f pLensWorld = m_cameraToWorld(AVector3f(0, 0, 0), 1.0f);
+		AVector3f nLens = m_cameraToWorld(AVector3f(0, 0, 1), 0.0f);
+		AInteraction lensIntr(pLensWorld, nLens, nLens);
+
+		// Populate arguments and compute the importance value
+		vis = AVisibilityTester(ref, lensIntr);
+		wi = lensIntr.p - ref.p;
+		Float dist = length(wi);
+		if (dist == 0)
+		{
+			pdf = 0;
+			return 0;
+		}
+		wi /= dist;
+
+		// Compute PDF for importance arriving at |ref|
+		pdf = (dist * dist) / absDot(lensIntr.n, wi);
+		return We(lensIntr.spawnRay(-wi), &pRaster);
+	}
 }
\ No newline at end of file
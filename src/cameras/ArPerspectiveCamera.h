@@ -16,11 +16,10 @@ namespace Aurora
 
 		virtual Float castingRay(const ACameraSample &sample, ARay &ray) const override;
 
-		//Spectrum We(const Ray &ray, Point2f *pRaster2 = nullptr) const;
-		//void Pdf_We(const Ray &ray, Float *pdfPos, Float *pdfDir) const;
-		//Spectrum Sample_Wi(const Interaction &ref, const Point2f &sample,
-		//	Vector3f *wi, Float *pdf, Point2f *pRaster,
-		//	VisibilityTester *vis) const;
+		virtual ASpectrum We(const ARay &ray, AVector2f *pRaster2 = nullptr) const override;
+		virtual void pdf_We(const ARay &ray, Float &pdfPos, Float &pdfDir) const override;
+		virtual ASpectrum sample_Wi(const AInteraction &ref, const AVector2f &u,
+			AVector3f &wi, Float &pdf, AVector2f &pRaster, AVisibilityTester &vis) const override;
 
 		virtual void activate() override { initialize(); }
 
@@ -0,0 +1,6 @@
+#include "ArAurora.h"
+
+namespace Aurora
+{
+	AOptions aOptions;
+}
@@ -3,9 +3,12 @@
 
 #include <limits>
 #include <memory>
+#include <string>
 
 #include "glog/logging.h"
 
+#include "ArMemory.h"
+
 #if defined(_MSC_VER)
 #define NOMINMAX
 #endif
@@ -33,6 +36,7 @@ namespace Aurora
 	using Byte = unsigned char;
 
 	constexpr static Float aShadowEpsilon = 0.0001f;
+	constexpr static Float aRayOriginEpsilon = 1e-5f;	//relative to the magnitude of the point
 	constexpr static Float aPi = 3.14159265358979323846f;
 	constexpr static Float aInvPi = 0.31830988618379067154f;
 	constexpr static Float aInv2Pi = 0.15915494309189533577f;
@@ -48,6 +52,9 @@ namespace Aurora
 	inline Float lerp(Float t, Float v1, Float v2) { return (1 - t) * v1 + t * v2; }
 	inline Float gamma(int n) { return (n * aMachineEpsilon) / (1 - n * aMachineEpsilon); }
 
+	inline Float safeSqrt(Float x) { return glm::sqrt(glm::max((Float)0, x)); }
+	inline Float safeAcos(Float x) { return glm::acos(glm::clamp(x, (Float)-1, (Float)1)); }
+
 	inline Float gammaCorrect(Float value) 
 	{
 		if (value <= 0.0031308f)
@@ -93,6 +100,7 @@ namespace Aurora
 	class ARGBSpectrum;
 	class AInteraction;
 	class ADistribution1D;
+	class ALightDistribution;
 	class AVisibilityTester;
 	class ASurfaceInteraction;
 
@@ -100,6 +108,21 @@ namespace Aurora
 
 	using ASpectrum = ARGBSpectrum;
 
+	// Options specified on the command line which apply to every render
+	struct AOptions
+	{
+		AHugePages hugePages = AHugePages::ANone;	//page backing of the per-thread memory arenas
+		int shardIndex = 0, shardCount = 1;			//render only the tiles t with t % shardCount == shardIndex
+		int passSpp = 0;							//samples per pixel of a progressive pass, 0 -> all at once
+		Float timeLimit = 0;						//seconds after which no further pass is started, 0 -> none
+		Float writeInterval = 0;					//seconds between intermediate images, 0 -> final image only
+		Float checkpointInterval = 0;				//seconds between film checkpoints, 0 -> no checkpoints
+		bool resume = false;						//continue from the checkpoint of a previous run
+		std::string liveFramebuffer;				//file the film is published to while rendering, empty -> none
+	};
+
+	extern AOptions aOptions;
+
 	// TransportMode Declarations
 	enum class ATransportMode { aRadiance, aImportance };
 
@@ -47,10 +47,7 @@ namespace Aurora
 		if (matchingComps == 0) 
 		{
 			pdf = 0;
-			if (sampledType)
-			{
-				sampledType = ABxDFType(0);
-			}
+			sampledType = ABxDFType(0);
 			return ASpectrum(0);
 		}
 		int comp = glm::min((int)glm::floor(u[0] * matchingComps), matchingComps - 1);
@@ -75,22 +72,18 @@ namespace Aurora
 		AVector3f wi, wo = worldToLocal(woWorld);
 		if (wo.z == 0)
 		{
+			pdf = 0;
+			sampledType = ABxDFType(0);
 			return 0.f;
 		}
 		
 		pdf = 0;
-		if (sampledType)
-		{
-			sampledType = bxdf->m_type;
-		}
+		sampledType = bxdf->m_type;
 		ASpectrum f = bxdf->sample_f(wo, wi, uRemapped, pdf, sampledType);
 
 		if (pdf == 0) 
 		{
-			if (sampledType)
-			{
-				sampledType = ABxDFType(0);
-			}
+			sampledType = ABxDFType(0);
 			return 0;
 		}
 
@@ -9,6 +9,24 @@ namespace Aurora
 
 	ACamera::~ACamera() {}
 
+	ASpectrum ACamera::We(const ARay &ray, AVector2f *pRaster2) const
+	{
+		LOG(FATAL) << "Camera::We() is not implemented!";
+		return ASpectrum(0.f);
+	}
+
+	void ACamera::pdf_We(const ARay &ray, Float &pdfPos, Float &pdfDir) const
+	{
+		LOG(FATAL) << "Camera::pdf_We() is not implemented!";
+	}
+
+	ASpectrum ACamera::sample_Wi(const AInteraction &ref, const AVector2f &u,
+		AVector3f &wi, Float &pdf, AVector2f &pRaster, AVisibilityTester &vis) const
+	{
+		LOG(FATAL) << "Camera::sample_Wi() is not implemented!";
+		return ASpectrum(0.f);
+	}
+
 	//-------------------------------------------AProjectiveCamera-------------------------------------
 
 	void AProjectiveCamera::initialize()
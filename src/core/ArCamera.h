@@ -10,12 +10,13 @@ namespace Aurora
 {
 	struct ACameraSample
 	{
-		AVector2f pFilm;
+		AVector2f pFilm = AVector2f(0.f);
+		Float filterWeight = 1;		//filter value over pdf of an importance sampled filter offset
 	};
 
 	inline std::ostream &operator<<(std::ostream &os, const ACameraSample &cs) 
 	{
-		os << "[ pFilm: " << cs.pFilm << " ]";
+		os << "[ pFilm: " << cs.pFilm << ", filterWeight: " << cs.filterWeight << " ]";
 		return os;
 	}
 
@@ -31,11 +32,14 @@ namespace Aurora
 
 		virtual Float castingRay(const ACameraSample &sample, ARay &ray) const = 0;
 
-		//virtual spectrum We(const ARay &ray, APoint2f *pRaster2 = nullptr) const;
-		//virtual void pdf_We(const ARay &ray, Float *pdfPos, Float *pdfDir) const;
+		//Note: importance emitted by the camera along |ray| and the raster position it arrives at,
+		//      only implemented by cameras that can be reached by light subpaths
+		virtual ASpectrum We(const ARay &ray, AVector2f *pRaster2 = nullptr) const;
+		virtual void pdf_We(const ARay &ray, Float &pdfPos, Float &pdfDir) const;
 
-		//virtual Spectrum Sample_Wi(const Interaction &ref, const APoint2f &u,
-		//	AVector3f *wi, Float *pdf, APoint2f *pRaster, VisibilityTester *vis) const;
+		// Sample a point on the camera lens that is visible from |ref|, the counterpart of ALight::sample_Li
+		virtual ASpectrum sample_Wi(const AInteraction &ref, const AVector2f &u,
+			AVector3f &wi, Float &pdf, AVector2f &pRaster, AVisibilityTester &vis) const;
 
 		virtual AClassType getClassType() const override { return AClassType::AECamera; }
 
@@ -0,0 +1,175 @@
+#include "ArDenoiser.h"
+
+#include "ArParallel.h"
+
+#include <cstring>
+
+namespace Aurora
+{
+	//Note: exp(-x) for x >= 0 from the exponent bits and a polynomial of the fraction (relative
+	//      error below 1e-5), free of branches and calls so that a loop of it vectorizes. The
+	//      integer and fraction parts are split by adding 1.5 * 2^23, the float rounds off the
+	//      fraction and leaves the integer in its low mantissa bits. The bits of non-negative
+	//      floats are ordered like the floats, so the clamping is done on integers as well.
+	static inline float expNegative(float x)
+	{
+		int32_t xBits;
+		std::memcpy(&xBits, &x, sizeof(xBits));
+		const int32_t maxBits = 0x42fc0000;	//126.f, exp(-126) is zero in a float
+		xBits = (xBits < maxBits) ? xBits : maxBits;
+		std::memcpy(&x, &xBits, sizeof(x));
+
+		float t = x * -1.44269504f;
+		float r = t + 12582912.f;
+		float f = t - (r - 12582912.f);
+		int32_t n;
+		std::memcpy(&n, &r, sizeof(n));
+		int32_t e = n - 0x4b400000 + 127;
+		e = (e > 0) ? e : 0;
+		int32_t bits = e << 23;
+		float scale;
+		std::memcpy(&scale, &bits, sizeof(scale));
+		return scale * (1.f + f * (0.693147182f + f * (0.240226507f + f * (0.0555041087f
+			+ f * (0.00961812911f + f * 0.00133335581f)))));
+	}
+
+	ADenoiser::ADenoiser(int iterations, Float sigmaColor, Float sigmaNormal, Float sigmaAlbedo)
+		: m_iterations(iterations), m_sigmaColor(sigmaColor), m_sigmaNormal(sigmaNormal), m_sigmaAlbedo(sigmaAlbedo) {}
+
+	void ADenoiser::denoise(int width, int height, Float *rgb, const Float *albedo, const Float *normal) const
+	{
+		const int nPixels = width * height;
+		if (nPixels == 0 || m_iterations <= 0)
+			return;
+
+		// Note: all buffers are planar so that the inner loops over a row run over contiguous
+		//       memory without branches and can be vectorized by the compiler
+		std::vector<Float> color[3], filtered[3], alb[3], nor[3], demodulation[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			color[c].resize(nPixels);
+			filtered[c].resize(nPixels);
+			alb[c].resize(nPixels);
+			nor[c].resize(nPixels);
+			demodulation[c].resize(nPixels);
+		}
+
+		for (int i = 0; i < nPixels; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				// Dark albedos are left alone, dividing by them would only amplify the noise
+				Float a = albedo[3 * i + c];
+				demodulation[c][i] = (a > 0.01f) ? a : 1;
+				color[c][i] = rgb[3 * i + c] / demodulation[c][i];
+				alb[c][i] = a;
+				nor[c][i] = normal[3 * i + c];
+			}
+		}
+
+		// The filter compares the tone mapped luminance so that one threshold fits all brightness levels
+		std::vector<Float> key(nPixels);
+		auto computeKeys = [&]() -> void
+		{
+			for (int i = 0; i < nPixels; ++i)
+			{
+				Float y = 0.212671f * color[0][i] + 0.715160f * color[1][i] + 0.072169f * color[2][i];
+				key[i] = y / (1 + glm::max(y, (Float)0));
+			}
+		};
+
+		static const Float kernel[5] = { 1.f / 16, 1.f / 4, 3.f / 8, 1.f / 4, 1.f / 16 };
+		const Float invSigmaNormal2 = 1 / (m_sigmaNormal * m_sigmaNormal);
+		const Float invSigmaAlbedo2 = 1 / (m_sigmaAlbedo * m_sigmaAlbedo);
+		for (int iteration = 0; iteration < m_iterations; ++iteration)
+		{
+			// The color threshold shrinks with the growing footprint of the kernel
+			const int step = 1 << iteration;
+			const Float sigmaColor = m_sigmaColor / (Float)(1 << iteration);
+			const Float invSigmaColor2 = 1 / (sigmaColor * sigmaColor);
+			computeKeys();
+
+			AParallelUtils::parallelFor((size_t)0, (size_t)height, [&](const size_t &row)
+			{
+				// Note: the row is filtered in blocks whose sums and weights live in local arrays,
+				//       the compiler knows that those don't alias the image buffers and vectorizes
+				//       the loops over a block without any run-time checks
+				const int blockSize = 64;
+				const int y = (int)row;
+				for (int b0 = 0; b0 < width; b0 += blockSize)
+				{
+					const int b1 = glm::min(width, b0 + blockSize);
+					Float sum[3][blockSize] = {}, weightSum[blockSize] = {}, weight[blockSize];
+
+					for (int ky = 0; ky < 5; ++ky)
+					{
+						const int qy = y + (ky - 2) * step;
+						if (qy < 0 || qy >= height)
+							continue;
+
+						for (int kx = 0; kx < 5; ++kx)
+						{
+							// Only the pixels whose tap lies inside the image
+							const int dx = (kx - 2) * step;
+							const int x0 = glm::max(b0, -dx), x1 = glm::min(b1, width - dx);
+							if (x0 >= x1)
+								continue;
+							const Float h = kernel[kx] * kernel[ky];
+							const int p = y * width + x0, q = qy * width + dx + x0, n = x1 - x0, i0 = x0 - b0;
+							const Float *keyP = key.data() + p, *keyQ = key.data() + q;
+							const Float *norP[3], *norQ[3], *albP[3], *albQ[3], *colorQ[3];
+							for (int c = 0; c < 3; ++c)
+							{
+								norP[c] = nor[c].data() + p;
+								norQ[c] = nor[c].data() + q;
+								albP[c] = alb[c].data() + p;
+								albQ[c] = alb[c].data() + q;
+								colorQ[c] = color[c].data() + q;
+							}
+
+							// Range weights of the taps first, then the weighted sums
+							for (int i = 0; i < n; ++i)
+							{
+								Float dKey = keyP[i] - keyQ[i];
+								Float dNormal = 0, dAlbedo = 0;
+								for (int c = 0; c < 3; ++c)
+								{
+									Float dn = norP[c][i] - norQ[c][i];
+									Float da = albP[c][i] - albQ[c][i];
+									dNormal += dn * dn;
+									dAlbedo += da * da;
+								}
+								weight[i0 + i] = h * expNegative((float)(dKey * dKey * invSigmaColor2
+									+ dNormal * invSigmaNormal2 + dAlbedo * invSigmaAlbedo2));
+							}
+							for (int i = 0; i < n; ++i)
+							{
+								for (int c = 0; c < 3; ++c)
+									sum[c][i0 + i] += weight[i0 + i] * colorQ[c][i];
+								weightSum[i0 + i] += weight[i0 + i];
+							}
+						}
+					}
+
+					// Note: the center tap always has a positive weight
+					for (int c = 0; c < 3; ++c)
+					{
+						for (int x = b0; x < b1; ++x)
+							filtered[c][y * width + x] = sum[c][x - b0] / weightSum[x - b0];
+					}
+				}
+			}, AExecutionPolicy::APARALLEL);
+
+			for (int c = 0; c < 3; ++c)
+				color[c].swap(filtered[c]);
+		}
+
+		// Modulate the filtered illumination with the albedo again
+		for (int i = 0; i < nPixels; ++i)
+		{
+			for (int c = 0; c < 3; ++c)
+				rgb[3 * i + c] = color[c][i] * demodulation[c][i];
+		}
+	}
+
+}
\ No newline at end of file
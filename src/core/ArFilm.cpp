@@ -1,5 +1,16 @@
 #include "ArFilm.h"
 
+#include "ArDenoiser.h"
+
+#include <chrono>
+#include <future>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
 
@@ -13,6 +24,7 @@ namespace Aurora
 		AVector2f _res = props.getVector2f("Resolution", AVector2f(800, 600));
 		m_resolution = AVector2i(static_cast<int>(_res.x), static_cast<int>(_res.y));
 		m_filename = props.getString("Filename", "rendered.png");
+		m_hdrFilename = props.getString("HDRFilename", "");
 
 		AVector2f _cropMin = props.getVector2f("CropMin", AVector2f(0.0f));
 		AVector2f _cropMax = props.getVector2f("CropMax", AVector2f(1.0f));
@@ -28,6 +40,9 @@ namespace Aurora
 		m_diagonal = props.getFloat("Diagonal", 35.f);
 		m_scale = props.getFloat("Scale", 1.0f);
 		m_maxSampleLuminance = props.getFloat("MaxLum", aInfinity);
+		m_denoise = props.getBoolean("Denoise", false);
+		m_filterSampling = props.getBoolean("FilterSampling", false);
+		m_denoiseIterations = props.getInteger("DenoiseIterations", 5);
 
 		//Filter
 		{
@@ -60,7 +75,23 @@ namespace Aurora
 
 	void AFilm::initialize()
 	{
+		m_mergeTimeNS = 0;
+		m_cameraSamples = 0;
 		m_pixels = std::unique_ptr<APixel[]>(new APixel[m_croppedPixelBounds.area()]);
+		if (m_denoise)
+		{
+			m_features = std::unique_ptr<AFeaturePixel[]>(new AFeaturePixel[m_croppedPixelBounds.area()]);
+		}
+
+		//Note: films restored from snapshots have no filter
+		if (m_filter == nullptr)
+			return;
+		m_samplePixels = getSampleBounds().area();
+
+		if (m_filterSampling)
+		{
+			m_filterSampler.reset(new AFilterSampler(*m_filter));
+		}
 
 		//Precompute filter weight table
 		//Note: we assume that filtering function f(x,y)=f(|x|,|y|)
@@ -76,10 +107,39 @@ namespace Aurora
 				m_filterTable[offset] = m_filter->evaluate(p);
 			}
 		}
+
+		// Choose how the tiles add the samples to the pixels
+		const AVector2f radius = m_filter->m_radius;
+		switch (m_filter->getShape())
+		{
+		case AFilterShape::ABox:
+			m_accumulation = (radius.x == 0.5f && radius.y == 0.5f) ? AFilmAccumulation::ABoxPixel : AFilmAccumulation::ABox;
+			break;
+		case AFilterShape::ASeparable:
+			m_accumulation = (2 * glm::max(radius.x, radius.y) + 1 <= AFilmTile::aMaxSeparableSpan && m_filterTable[0] > 0) ?
+				AFilmAccumulation::ASeparable : AFilmAccumulation::AGeneric;
+			if (m_accumulation == AFilmAccumulation::ASeparable)
+			{
+				// f(x, y) = f(x, 0) * f(0, y) / f(0, 0) for the cells of the table, the tiles share the factors
+				for (int i = 0; i < filterTableWidth; ++i)
+				{
+					m_filterTableX[i] = m_filterTable[i];
+					m_filterTableY[i] = m_filterTable[i * filterTableWidth] / m_filterTable[0];
+				}
+			}
+			break;
+		default:
+			m_accumulation = AFilmAccumulation::AGeneric;
+			break;
+		}
 	}
 
 	ABounds2i AFilm::getSampleBounds() const
 	{
+		CHECK(m_filter != nullptr);
+		// Filter sampled camera samples are taken per pixel, the filter offset is part of the sample
+		if (m_filterSampling)
+			return m_croppedPixelBounds;
 		ABounds2f floatBounds(
 			floor(AVector2f(m_croppedPixelBounds.m_pMin) + AVector2f(0.5f, 0.5f) - m_filter->m_radius),
 			ceil(AVector2f(m_croppedPixelBounds.m_pMax) - AVector2f(0.5f, 0.5f) + m_filter->m_radius));
@@ -88,85 +148,414 @@ namespace Aurora
 
 	std::unique_ptr<AFilmTile> AFilm::getFilmTile(const ABounds2i &sampleBounds)
 	{
+		CHECK(m_filter != nullptr);
+
+		// Every sample only contributes to its own pixel, the tile owns all its pixels
+		if (m_filterSampling)
+		{
+			ABounds2i tilePixelBounds = intersect(sampleBounds, m_croppedPixelBounds);
+			return std::unique_ptr<AFilmTile>(new AFilmTile(tilePixelBounds, tilePixelBounds, sampleBounds, m_filter->m_radius,
+				m_filterTable, filterTableWidth, m_maxSampleLuminance, m_denoise, true));
+		}
+
 		// Bound image pixels that samples in _sampleBounds_ contribute to
 		AVector2f halfPixel = AVector2f(0.5f, 0.5f);
 		ABounds2f floatBounds = (ABounds2f)sampleBounds;
 		AVector2i p0 = (AVector2i)ceil(floatBounds.m_pMin - halfPixel - m_filter->m_radius);
 		AVector2i p1 = (AVector2i)floor(floatBounds.m_pMax - halfPixel + m_filter->m_radius) + AVector2i(1, 1);
 		ABounds2i tilePixelBounds = intersect(ABounds2i(p0, p1), m_croppedPixelBounds);
-		return std::unique_ptr<AFilmTile>(new AFilmTile(tilePixelBounds, m_filter->m_radius,
-			m_filterTable, filterTableWidth, m_maxSampleLuminance));
+
+		// Bound image pixels whose whole filter support lies inside _sampleBounds_,
+		// since the sample bounds of tiles are disjoint no other tile touches them
+		AVector2i o0 = (AVector2i)ceil(floatBounds.m_pMin - halfPixel + m_filter->m_radius);
+		AVector2i o1 = (AVector2i)ceil(floatBounds.m_pMax - halfPixel - m_filter->m_radius);
+		ABounds2i ownedPixelBounds = intersect(ABounds2i(o0, max(o0, o1)), tilePixelBounds);
+
+		return std::unique_ptr<AFilmTile>(new AFilmTile(tilePixelBounds, ownedPixelBounds, sampleBounds, m_filter->m_radius,
+			m_filterTable, filterTableWidth, m_maxSampleLuminance, m_denoise, false, m_accumulation,
+			m_filterTableX, m_filterTableY));
 	}
 
 	void AFilm::mergeFilmTile(std::unique_ptr<AFilmTile> tile)
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
+		auto start = std::chrono::steady_clock::now();
+		const ABounds2i ownedBounds = tile->getOwnedPixelBounds();
 		for (AVector2i pixel : tile->getPixelBounds()) 
 		{
 			// Merge _pixel_ into _Film::pixels_
 			const AFilmTilePixel &tilePixel = tile->getPixel(pixel);
+			if (tilePixel.m_filterWeightSum == 0 && tilePixel.m_contribSum.isBlack())
+				continue;
+
 			APixel &mergePixel = getPixel(pixel);
 			Float xyz[3];
 			tilePixel.m_contribSum.toXYZ(xyz);
-			for (int i = 0; i < 3; ++i)
+			if (insideExclusive(pixel, ownedBounds))
+			{
+				// Only this tile writes the pixel, no read-modify-write atomics needed
+				for (int i = 0; i < 3; ++i)
+				{
+					mergePixel.m_xyz[i] = mergePixel.m_xyz[i] + xyz[i];
+				}
+				mergePixel.m_filterWeightSum = mergePixel.m_filterWeightSum + tilePixel.m_filterWeightSum;
+			}
+			else
 			{
-				mergePixel.m_xyz[i] += xyz[i];
+				// Pixel in filter overlap region shared with neighbouring tiles
+				for (int i = 0; i < 3; ++i)
+				{
+					mergePixel.m_xyz[i].add(xyz[i]);
+				}
+				mergePixel.m_filterWeightSum.add(tilePixel.m_filterWeightSum);
+			}
+		}
+		if (tile->isRecordingFeatures())
+		{
+			const ABounds2i featureBounds = intersect(tile->getSampleBounds(), m_croppedPixelBounds);
+			const int width = m_croppedPixelBounds.m_pMax.x - m_croppedPixelBounds.m_pMin.x;
+			for (AVector2i pixel : featureBounds)
+			{
+				const AFilmTileFeature &tileFeature = tile->getFeatures(pixel);
+				AFeaturePixel &feature = m_features[(pixel.x - m_croppedPixelBounds.m_pMin.x) +
+					(pixel.y - m_croppedPixelBounds.m_pMin.y) * width];
+				Float albedo[3];
+				tileFeature.m_albedo.toRGB(albedo);
+				for (int i = 0; i < 3; ++i)
+				{
+					feature.m_albedo[i] += albedo[i];
+					feature.m_normal[i] += tileFeature.m_normal[i];
+				}
+				feature.m_weight += tileFeature.m_weight;
+			}
+		}
+
+		m_cameraSamples += tile->getCameraSampleCount();
+		updateLiveFramebuffer();
+
+		m_mergeTimeNS += std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+	}
+
+	void AFilm::updateLiveFramebuffer()
+	{
+		if (aOptions.liveFramebuffer.empty())
+			return;
+
+		std::call_once(m_liveFramebufferFlag, [this]() -> void
+		{
+			AVector2i extent = m_croppedPixelBounds.diagonal();
+			m_liveFramebuffer.reset(new ALiveFramebuffer(aOptions.liveFramebuffer, extent.x, extent.y,
+				[this](float *rgb) -> void { fillLiveFramebuffer(rgb); }));
+			if (!m_liveFramebuffer->isValid())
+				m_liveFramebuffer.reset();
+		});
+
+		// The publisher thread converts the film, the render threads only set a flag
+		if (m_liveFramebuffer)
+			m_liveFramebuffer->markDirty();
+	}
+
+	void AFilm::fillLiveFramebuffer(float *rgb) const
+	{
+		const int nPixels = m_croppedPixelBounds.area();
+		for (int i = 0; i < nPixels; ++i)
+		{
+			const APixel &pixel = m_pixels[i];
+			Float xyz[3] = { pixel.m_xyz[0], pixel.m_xyz[1], pixel.m_xyz[2] };
+			Float pixelRGB[3];
+			XYZToRGB(xyz, pixelRGB);
+			Float filterWeightSum = pixel.m_filterWeightSum;
+			Float invWt = (filterWeightSum != 0) ? m_scale / filterWeightSum : m_scale;
+			for (int c = 0; c < 3; ++c)
+			{
+				rgb[3 * i + c] = (float)glm::max((Float)0, pixelRGB[c] * invWt);
 			}
-			mergePixel.m_filterWeightSum += tilePixel.m_filterWeightSum;
 		}
 	}
 
 	void AFilm::writeImageToFile(Float splatScale)
 	{
+		LOG(INFO) << "Film tile merging took " << m_mergeTimeNS / 1000000 << " ms over all threads";
 		LOG(INFO) << "Converting image to RGB and computing final weighted pixel values";
+		const AVector2i extent = m_croppedPixelBounds.diagonal();
 		std::unique_ptr<Float[]> rgb(new Float[3 * m_croppedPixelBounds.area()]);
-		std::unique_ptr<Byte[]>  dst(new Byte[3 * m_croppedPixelBounds.area()]);
-		int offset = 0;
-		for (AVector2i p : m_croppedPixelBounds) 
+		AParallelUtils::parallelFor((size_t)0, (size_t)extent.y, [&](const size_t &row)
 		{
-			// Convert pixel XYZ color to RGB
-			APixel &pixel = getPixel(p);
-			XYZToRGB(pixel.m_xyz, &rgb[3 * offset]);
+			for (int x = 0; x < extent.x; ++x)
+			{
+				// Convert pixel XYZ color to RGB
+				const int offset = (int)row * extent.x + x;
+				APixel &pixel = getPixel(m_croppedPixelBounds.m_pMin + AVector2i(x, (int)row));
+				Float xyz[3] = { pixel.m_xyz[0], pixel.m_xyz[1], pixel.m_xyz[2] };
+				XYZToRGB(xyz, &rgb[3 * offset]);
 
-			// Normalize pixel with weight sum
-			Float filterWeightSum = pixel.m_filterWeightSum;
-			if (filterWeightSum != 0) 
+				// Normalize pixel with weight sum
+				Float filterWeightSum = pixel.m_filterWeightSum;
+				if (filterWeightSum != 0)
+				{
+					Float invWt = (Float)1 / filterWeightSum;
+					rgb[3 * offset + 0] = glm::max((Float)0, rgb[3 * offset + 0] * invWt);
+					rgb[3 * offset + 1] = glm::max((Float)0, rgb[3 * offset + 1] * invWt);
+					rgb[3 * offset + 2] = glm::max((Float)0, rgb[3 * offset + 2] * invWt);
+				}
+
+				// Add splat value at pixel
+				Float splatRGB[3];
+				Float splatXYZ[3] = { pixel.m_splatXYZ[0], pixel.m_splatXYZ[1],  pixel.m_splatXYZ[2] };
+				XYZToRGB(splatXYZ, splatRGB);
+				rgb[3 * offset + 0] += splatScale * splatRGB[0];
+				rgb[3 * offset + 1] += splatScale * splatRGB[1];
+				rgb[3 * offset + 2] += splatScale * splatRGB[2];
+
+				// Scale pixel value by _scale_
+				rgb[3 * offset + 0] *= m_scale;
+				rgb[3 * offset + 1] *= m_scale;
+				rgb[3 * offset + 2] *= m_scale;
+			}
+		}, AExecutionPolicy::APARALLEL);
+
+		if (m_denoise)
+		{
+			denoise(rgb.get());
+		}
+
+		writeImage(m_filename, rgb.get());
+		if (!m_hdrFilename.empty())
+		{
+			writeImage(m_hdrFilename, rgb.get());
+		}
+	}
+
+	//-------------------------------------------ImageOutput-------------------------------------
+
+	enum class AImageFormat { APNG, APFM, AEXR };
+
+	static AImageFormat imageFormat(const std::string &filename)
+	{
+		size_t dot = filename.find_last_of('.');
+		std::string extension = dot == std::string::npos ? "" : filename.substr(dot + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(),
+			[](char c) -> char { return (char)std::tolower((unsigned char)c); });
+		if (extension == "pfm")
+			return AImageFormat::APFM;
+		if (extension == "exr")
+			return AImageFormat::AEXR;
+		return AImageFormat::APNG;
+	}
+
+	//Note: the smallest linear values that are written as the bytes 1 to 255, quantizing a value
+	//      is a binary search over them instead of a pow() per channel. Every threshold is moved
+	//      to the exact boundary of 255 * gammaCorrect(v) + 0.5, so that the bytes are the same.
+	static const std::vector<Float> &byteThresholds()
+	{
+		static const std::vector<Float> thresholds = []() -> std::vector<Float>
+		{
+			auto toByte = [](Float v) -> int { return (int)clamp(255.f * gammaCorrect(v) + 0.5f, 0.f, 255.f); };
+			std::vector<Float> t(255);
+			for (int b = 1; b <= 255; ++b)
 			{
-				Float invWt = (Float)1 / filterWeightSum;
-				rgb[3 * offset + 0] = glm::max((Float)0, rgb[3 * offset + 0] * invWt);
-				rgb[3 * offset + 1] = glm::max((Float)0, rgb[3 * offset + 1] * invWt);
-				rgb[3 * offset + 2] = glm::max((Float)0, rgb[3 * offset + 2] * invWt);
+				Float v = inverseGammaCorrect((b - (Float)0.5) / 255);
+				while (toByte(v) < b)
+					v = std::nextafter(v, aInfinity);
+				while (v > 0 && toByte(std::nextafter(v, (Float)0)) >= b)
+					v = std::nextafter(v, (Float)0);
+				t[b - 1] = v;
 			}
+			return t;
+		}();
+		return thresholds;
+	}
+
+	static bool writePFM(const std::string &filename, int width, int height, const float *rgb)
+	{
+		std::ofstream out(filename, std::ios::binary);
+		if (!out)
+			return false;
+		// Negative scale -> little endian, the scanlines are stored from the bottom to the top
+		out << "PF\n" << width << " " << height << "\n-1.0\n";
+		for (int y = height - 1; y >= 0; --y)
+		{
+			out.write(reinterpret_cast<const char*>(rgb + 3 * (size_t)y * width), 3 * width * sizeof(float));
+		}
+		return (bool)out;
+	}
+
+	//Note: a single part scanline OpenEXR file without compression. The data window is the
+	//      cropped pixel bounds and the display window the full resolution of the film, every
+	//      scanline holds the B, G and R channels (sorted by name) as 32-bit floats.
+	static bool writeEXR(const std::string &filename, const ABounds2i &dataWindow,
+		const AVector2i &resolution, const float *rgb)
+	{
+		std::vector<char> header;
+		auto putBytes = [&header](const void *data, size_t size)
+		{
+			header.insert(header.end(), (const char*)data, (const char*)data + size);
+		};
+		auto putInt = [&putBytes](int32_t v) { putBytes(&v, 4); };
+		auto putFloat = [&putBytes](float v) { putBytes(&v, 4); };
+		auto putString = [&putBytes](const char *str) { putBytes(str, strlen(str) + 1); };
+		auto putAttribute = [&](const char *name, const char *type, int32_t size)
+		{
+			putString(name);
+			putString(type);
+			putInt(size);
+		};
+		auto putBox = [&](int xMin, int yMin, int xMax, int yMax)
+		{
+			putInt(xMin); putInt(yMin); putInt(xMax); putInt(yMax);
+		};
 
-			// Add splat value at pixel
-			Float splatRGB[3];
-			Float splatXYZ[3] = { pixel.m_splatXYZ[0], pixel.m_splatXYZ[1],  pixel.m_splatXYZ[2] };
-			XYZToRGB(splatXYZ, splatRGB);
-			rgb[3 * offset + 0] += splatScale * splatRGB[0];
-			rgb[3 * offset + 1] += splatScale * splatRGB[1];
-			rgb[3 * offset + 2] += splatScale * splatRGB[2];
+		const int width = dataWindow.m_pMax.x - dataWindow.m_pMin.x;
+		const int height = dataWindow.m_pMax.y - dataWindow.m_pMin.y;
 
-			// Scale pixel value by _scale_
-			rgb[3 * offset + 0] *= m_scale;
-			rgb[3 * offset + 1] *= m_scale;
-			rgb[3 * offset + 2] *= m_scale;
+		putInt(20000630);	//magic number
+		putInt(2);			//version 2, single part scanline file
+		putAttribute("channels", "chlist", 3 * 18 + 1);
+		for (const char *channel : { "B", "G", "R" })
+		{
+			putString(channel);
+			putInt(2);		//FLOAT
+			putInt(0);		//pLinear and reserved bytes
+			putInt(1);		//x sampling
+			putInt(1);		//y sampling
+		}
+		header.push_back(0);
+		putAttribute("compression", "compression", 1);
+		header.push_back(0);	//NO_COMPRESSION
+		putAttribute("dataWindow", "box2i", 16);
+		putBox(dataWindow.m_pMin.x, dataWindow.m_pMin.y, dataWindow.m_pMax.x - 1, dataWindow.m_pMax.y - 1);
+		putAttribute("displayWindow", "box2i", 16);
+		putBox(0, 0, resolution.x - 1, resolution.y - 1);
+		putAttribute("lineOrder", "lineOrder", 1);
+		header.push_back(0);	//INCREASING_Y
+		putAttribute("pixelAspectRatio", "float", 4);
+		putFloat(1.f);
+		putAttribute("screenWindowCenter", "v2f", 8);
+		putFloat(0.f); putFloat(0.f);
+		putAttribute("screenWindowWidth", "float", 4);
+		putFloat(1.f);
+		header.push_back(0);
 
-#define TO_BYTE(v) (uint8_t) clamp(255.f * gammaCorrect(v) + 0.5f, 0.f, 255.f)
-			dst[3 * offset + 0] = TO_BYTE(rgb[3 * offset + 0]);
-			dst[3 * offset + 1] = TO_BYTE(rgb[3 * offset + 1]);
-			dst[3 * offset + 2] = TO_BYTE(rgb[3 * offset + 2]);
+		// Offset table of the scanlines
+		const int32_t dataSize = 3 * width * (int32_t)sizeof(float);
+		uint64_t offset = header.size() + (uint64_t)height * sizeof(uint64_t);
+		for (int y = 0; y < height; ++y, offset += 8 + dataSize)
+		{
+			putBytes(&offset, sizeof(uint64_t));
+		}
 
-			++offset;
+		std::ofstream out(filename, std::ios::binary);
+		if (!out)
+			return false;
+		out.write(header.data(), header.size());
+		std::vector<float> scanline(3 * width);
+		for (int y = 0; y < height; ++y)
+		{
+			const float *row = rgb + 3 * (size_t)y * width;
+			for (int x = 0; x < width; ++x)
+			{
+				scanline[x] = row[3 * x + 2];
+				scanline[width + x] = row[3 * x + 1];
+				scanline[2 * width + x] = row[3 * x + 0];
+			}
+			int32_t yCoord = dataWindow.m_pMin.y + y;
+			out.write(reinterpret_cast<const char*>(&yCoord), 4);
+			out.write(reinterpret_cast<const char*>(&dataSize), 4);
+			out.write(reinterpret_cast<const char*>(scanline.data()), dataSize);
 		}
+		return (bool)out;
+	}
+
+	void AFilm::writeImage(const std::string &filename, const Float *rgb) const
+	{
+		LOG(INFO) << "Writing image " << filename << " with bounds " << m_croppedPixelBounds;
+		const AVector2i extent = m_croppedPixelBounds.diagonal();
+		const AImageFormat format = imageFormat(filename);
+		std::future<void> encoding;
 
-		LOG(INFO) << "Writing image " << m_filename << " with bounds " << m_croppedPixelBounds;
-		auto extent = m_croppedPixelBounds.diagonal();
-		stbi_write_png(m_filename.c_str(),
-			extent.x,
-			extent.y,
-			3,
-			static_cast<void*>(dst.get()),
-			extent.x * 3);
+		//Note: the rows are converted in parallel, only the file encoding is done on a separate
+		//      thread so that the caller can move on to the next render
+		if (format == AImageFormat::APNG)
+		{
+			const std::vector<Float> &thresholds = byteThresholds();
+			std::shared_ptr<std::vector<Byte>> dst = std::make_shared<std::vector<Byte>>(3 * m_croppedPixelBounds.area());
+			AParallelUtils::parallelFor((size_t)0, (size_t)extent.y, [&](const size_t &row)
+			{
+				const size_t begin = 3 * row * extent.x, end = begin + 3 * extent.x;
+				for (size_t i = begin; i < end; ++i)
+				{
+					(*dst)[i] = (Byte)(std::upper_bound(thresholds.begin(), thresholds.end(), rgb[i]) - thresholds.begin());
+				}
+			}, AExecutionPolicy::APARALLEL);
+
+			encoding = std::async(std::launch::async, [filename, extent, dst]() -> void
+			{
+				if (!stbi_write_png(filename.c_str(), extent.x, extent.y, 3,
+					static_cast<void*>(dst->data()), extent.x * 3))
+				{
+					LOG(ERROR) << "Failed to write image " << filename;
+				}
+			});
+		}
+		else
+		{
+			std::shared_ptr<std::vector<float>> dst = std::make_shared<std::vector<float>>(3 * m_croppedPixelBounds.area());
+			std::copy(rgb, rgb + dst->size(), dst->begin());
+			const ABounds2i dataWindow = m_croppedPixelBounds;
+			const AVector2i resolution = m_resolution;
+			encoding = std::async(std::launch::async, [filename, format, dataWindow, resolution, dst]() -> void
+			{
+				const AVector2i extent = dataWindow.diagonal();
+				bool written = (format == AImageFormat::APFM) ?
+					writePFM(filename, extent.x, extent.y, dst->data()) :
+					writeEXR(filename, dataWindow, resolution, dst->data());
+				if (!written)
+				{
+					LOG(ERROR) << "Failed to write image " << filename;
+				}
+			});
+		}
+
+		std::lock_guard<std::mutex> lock(m_pendingWritesMutex);
+		m_pendingWrites.push_back(encoding.share());
+	}
+
+	void AFilm::denoise(Float *rgb) const
+	{
+		const int nPixels = m_croppedPixelBounds.area();
+		std::unique_ptr<Float[]> albedo(new Float[3 * nPixels]), normal(new Float[3 * nPixels]);
+		for (int i = 0; i < nPixels; ++i)
+		{
+			const AFeaturePixel &feature = m_features[i];
+			Float invWeight = (feature.m_weight > 0) ? 1 / feature.m_weight : 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				albedo[3 * i + c] = feature.m_albedo[c] * invWeight;
+				normal[3 * i + c] = feature.m_normal[c] * invWeight;
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		AVector2i extent = m_croppedPixelBounds.diagonal();
+		ADenoiser(m_denoiseIterations).denoise(extent.x, extent.y, rgb, albedo.get(), normal.get());
+		LOG(INFO) << "Denoising took " << std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count() << " ms";
+	}
+
+	std::mutex AFilm::m_pendingWritesMutex;
+	std::vector<std::shared_future<void>> AFilm::m_pendingWrites;
+
+	void AFilm::waitForPendingWrites()
+	{
+		std::vector<std::shared_future<void>> pending;
+		{
+			std::lock_guard<std::mutex> lock(m_pendingWritesMutex);
+			pending.swap(m_pendingWrites);
+		}
+		for (auto &write : pending)
+		{
+			write.wait();
+		}
 	}
 
 	void AFilm::setImage(const ASpectrum *img) const
@@ -175,12 +564,21 @@ namespace Aurora
 		for (int i = 0; i < nPixels; ++i) 
 		{
 			APixel &p = m_pixels[i];
-			img[i].toXYZ(p.m_xyz);
+			Float xyz[3];
+			img[i].toXYZ(xyz);
+			p.m_xyz[0] = xyz[0];
+			p.m_xyz[1] = xyz[1];
+			p.m_xyz[2] = xyz[2];
 			p.m_filterWeightSum = 1;
 			p.m_splatXYZ[0] = p.m_splatXYZ[1] = p.m_splatXYZ[2] = 0;
 		}
 	}
 
+	Float AFilm::getSplatScale() const
+	{
+		return (m_cameraSamples > 0) ? (Float)m_samplePixels / m_cameraSamples : 1;
+	}
+
 	void AFilm::addSplat(const AVector2f &p, ASpectrum v)
 	{
 		//Note:Rather than computing the final pixel value as a weighted
@@ -235,5 +633,272 @@ namespace Aurora
 			}
 			pixel.m_filterWeightSum = 0;
 		}
+		m_cameraSamples = 0;
+		if (m_denoise)
+		{
+			for (int i = 0; i < m_croppedPixelBounds.area(); ++i)
+			{
+				m_features[i] = AFeaturePixel();
+			}
+		}
+	}
+
+	//-------------------------------------------Film snapshot-------------------------------------
+
+	//Note: layout of a snapshot file (native byte order)
+	//      magic, version, resolution, cropped pixel bounds, scale, camera samples, pixels of the
+	//      sample bounds, samples per pixel, shard index and count, denoising, filename, followed by
+	//      xyz[3], filterWeightSum, splatXYZ[3] of every pixel and for denoising films albedo[3],
+	//      normal[3], weight of every pixel. All floating point values are stored as doubles, which
+	//      is lossless for Float.
+	static const char aSnapshotMagic[4] = { 'A', 'F', 'L', 'M' };
+	static constexpr int32_t aSnapshotVersion = 5;
+
+	struct ASnapshotHeader
+	{
+		char magic[4];
+		int32_t version;
+		int32_t resolution[2];
+		int32_t bounds[4];
+		double scale;
+		int64_t cameraSamples, samplePixels;
+		int64_t samplesPerPixel;
+		int32_t shardIndex, shardCount;
+		int32_t denoise, denoiseIterations;
+		int32_t filenameLength;
+	};
+
+	static bool readSnapshotHeader(std::ifstream &in, const std::string &filename,
+		ASnapshotHeader &header, std::string &imageFilename)
+	{
+		if (!in)
+		{
+			LOG(ERROR) << "Failed to open film snapshot " << filename;
+			return false;
+		}
+		in.read(reinterpret_cast<char*>(&header), sizeof(ASnapshotHeader));
+		if (!in || memcmp(header.magic, aSnapshotMagic, 4) != 0 || header.version != aSnapshotVersion
+			|| header.filenameLength < 0 || header.shardCount < 1 || header.shardIndex < 0
+			|| header.shardIndex >= header.shardCount)
+		{
+			LOG(ERROR) << filename << " is not a valid film snapshot";
+			return false;
+		}
+		imageFilename.resize(header.filenameLength);
+		in.read(&imageFilename[0], header.filenameLength);
+		return (bool)in;
+	}
+
+	//Note: the data is written to a temporary file first and then renamed, so that an interrupted
+	//      write never destroys the previous snapshot of the same name
+	static bool writeSnapshotData(const std::string &filename, const std::vector<char> &data)
+	{
+		const std::string tmpFilename = filename + ".tmp";
+		{
+			std::ofstream out(tmpFilename, std::ios::binary);
+			if (!out)
+			{
+				LOG(ERROR) << "Failed to create film snapshot " << filename;
+				return false;
+			}
+			out.write(data.data(), data.size());
+			if (!out)
+			{
+				LOG(ERROR) << "Failed to write film snapshot " << filename;
+				return false;
+			}
+		}
+#ifdef AURORA_WINDOWS_OS
+		std::remove(filename.c_str());
+#endif
+		if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0)
+		{
+			LOG(ERROR) << "Failed to rename " << tmpFilename << " to " << filename;
+			return false;
+		}
+		return true;
+	}
+
+	std::shared_ptr<std::vector<char>> AFilm::serializeSnapshot(int64_t samplesPerPixel) const
+	{
+		ASnapshotHeader header;
+		memset(&header, 0, sizeof(ASnapshotHeader));
+		memcpy(header.magic, aSnapshotMagic, 4);
+		header.version = aSnapshotVersion;
+		header.resolution[0] = m_resolution.x;
+		header.resolution[1] = m_resolution.y;
+		header.bounds[0] = m_croppedPixelBounds.m_pMin.x;
+		header.bounds[1] = m_croppedPixelBounds.m_pMin.y;
+		header.bounds[2] = m_croppedPixelBounds.m_pMax.x;
+		header.bounds[3] = m_croppedPixelBounds.m_pMax.y;
+		header.scale = m_scale;
+		header.cameraSamples = m_cameraSamples;
+		header.samplePixels = m_samplePixels;
+		header.samplesPerPixel = samplesPerPixel;
+		header.shardIndex = aOptions.shardIndex;
+		header.shardCount = aOptions.shardCount;
+		header.denoise = m_denoise;
+		header.denoiseIterations = m_denoiseIterations;
+		header.filenameLength = static_cast<int32_t>(m_filename.size());
+
+		int nPixels = m_croppedPixelBounds.area();
+		size_t pixelsOffset = sizeof(ASnapshotHeader) + m_filename.size();
+		std::shared_ptr<std::vector<char>> data = std::make_shared<std::vector<char>>(
+			pixelsOffset + (m_denoise ? 14 : 7) * nPixels * sizeof(double));
+		memcpy(data->data(), &header, sizeof(ASnapshotHeader));
+		memcpy(data->data() + sizeof(ASnapshotHeader), m_filename.data(), m_filename.size());
+
+		double *values = reinterpret_cast<double*>(data->data() + pixelsOffset);
+		for (int i = 0; i < nPixels; ++i)
+		{
+			const APixel &pixel = m_pixels[i];
+			double v[7] = { pixel.m_xyz[0], pixel.m_xyz[1], pixel.m_xyz[2], pixel.m_filterWeightSum,
+				pixel.m_splatXYZ[0], pixel.m_splatXYZ[1], pixel.m_splatXYZ[2] };
+			memcpy(&values[7 * i], v, sizeof(v));
+		}
+
+		if (m_denoise)
+		{
+			double *features = values + 7 * nPixels;
+			for (int i = 0; i < nPixels; ++i)
+			{
+				const AFeaturePixel &feature = m_features[i];
+				double v[7] = { feature.m_albedo[0], feature.m_albedo[1], feature.m_albedo[2],
+					feature.m_normal[0], feature.m_normal[1], feature.m_normal[2], feature.m_weight };
+				memcpy(&features[7 * i], v, sizeof(v));
+			}
+		}
+		return data;
+	}
+
+	bool AFilm::writeSnapshot(const std::string &filename, int64_t samplesPerPixel) const
+	{
+		LOG(INFO) << "Writing film snapshot " << filename << " with bounds " << m_croppedPixelBounds;
+		return writeSnapshotData(filename, *serializeSnapshot(samplesPerPixel));
+	}
+
+	bool AFilm::writeSnapshotAsync(const std::string &filename, int64_t samplesPerPixel)
+	{
+		// Skip this snapshot rather than wait for the previous one
+		if (m_snapshotWrite.valid() &&
+			m_snapshotWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			LOG(WARNING) << "Film snapshot " << filename << " is still being written, skipping a snapshot";
+			return false;
+		}
+
+		LOG(INFO) << "Writing film snapshot " << filename << " in the background";
+		std::shared_ptr<std::vector<char>> data = serializeSnapshot(samplesPerPixel);
+		m_snapshotWrite = std::async(std::launch::async, [filename, data]() -> void
+		{
+			writeSnapshotData(filename, *data);
+		}).share();
+
+		std::lock_guard<std::mutex> lock(m_pendingWritesMutex);
+		m_pendingWrites.push_back(m_snapshotWrite);
+		return true;
+	}
+
+	bool AFilm::mergeSnapshot(const std::string &filename, ASnapshotInfo *info)
+	{
+		std::ifstream in(filename, std::ios::binary);
+		ASnapshotHeader header;
+		std::string imageFilename;
+		if (!readSnapshotHeader(in, filename, header, imageFilename))
+			return false;
+
+		ABounds2i bounds(AVector2i(header.bounds[0], header.bounds[1]), AVector2i(header.bounds[2], header.bounds[3]));
+		if (bounds.m_pMin != m_croppedPixelBounds.m_pMin || bounds.m_pMax != m_croppedPixelBounds.m_pMax)
+		{
+			LOG(ERROR) << "Film snapshot " << filename << " has bounds " << bounds
+				<< " but the film has bounds " << m_croppedPixelBounds;
+			return false;
+		}
+		if (header.samplePixels != m_samplePixels)
+		{
+			LOG(ERROR) << "Film snapshot " << filename << " has " << header.samplePixels
+				<< " pixels of sample bounds but the film has " << m_samplePixels;
+			return false;
+		}
+		if ((header.denoise != 0) != m_denoise)
+		{
+			LOG(ERROR) << "Film snapshot " << filename << (m_denoise ? " has no denoising features but the film"
+				" is denoised" : " has denoising features but the film isn't denoised");
+			return false;
+		}
+
+		int nPixels = m_croppedPixelBounds.area();
+		std::vector<double> values((m_denoise ? 14 : 7) * nPixels);
+		in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(double));
+		if (!in)
+		{
+			LOG(ERROR) << "Film snapshot " << filename << " is truncated";
+			return false;
+		}
+
+		for (int i = 0; i < nPixels; ++i)
+		{
+			APixel &pixel = m_pixels[i];
+			const double *v = &values[7 * i];
+			pixel.m_xyz[0] = pixel.m_xyz[0] + v[0];
+			pixel.m_xyz[1] = pixel.m_xyz[1] + v[1];
+			pixel.m_xyz[2] = pixel.m_xyz[2] + v[2];
+			pixel.m_filterWeightSum = pixel.m_filterWeightSum + v[3];
+			pixel.m_splatXYZ[0] = pixel.m_splatXYZ[0] + v[4];
+			pixel.m_splatXYZ[1] = pixel.m_splatXYZ[1] + v[5];
+			pixel.m_splatXYZ[2] = pixel.m_splatXYZ[2] + v[6];
+		}
+		if (m_denoise)
+		{
+			const double *features = &values[7 * nPixels];
+			for (int i = 0; i < nPixels; ++i)
+			{
+				AFeaturePixel &feature = m_features[i];
+				const double *v = &features[7 * i];
+				for (int c = 0; c < 3; ++c)
+				{
+					feature.m_albedo[c] += v[c];
+					feature.m_normal[c] += v[3 + c];
+				}
+				feature.m_weight += v[6];
+			}
+		}
+		m_cameraSamples += header.cameraSamples;
+
+		if (info != nullptr)
+		{
+			info->samplesPerPixel = header.samplesPerPixel;
+			info->shardIndex = header.shardIndex;
+			info->shardCount = header.shardCount;
+		}
+
+		LOG(INFO) << "Merged film snapshot " << filename;
+		return true;
+	}
+
+	AFilm::ptr AFilm::readSnapshot(const std::string &filename, ASnapshotInfo &info)
+	{
+		ASnapshotHeader header;
+		std::string imageFilename;
+		{
+			std::ifstream in(filename, std::ios::binary);
+			if (!readSnapshotHeader(in, filename, header, imageFilename))
+				return nullptr;
+		}
+
+		// Set the cropped pixel bounds directly since they can't be recovered exactly from a crop window
+		AVector2i resolution(header.resolution[0], header.resolution[1]);
+		AFilm::ptr film = std::make_shared<AFilm>(resolution, ABounds2f(AVector2f(0, 0), AVector2f(1, 1)),
+			nullptr, imageFilename, 35.f, (Float)header.scale);
+		film->m_croppedPixelBounds = ABounds2i(AVector2i(header.bounds[0], header.bounds[1]),
+			AVector2i(header.bounds[2], header.bounds[3]));
+		film->m_denoise = header.denoise != 0;
+		film->m_denoiseIterations = header.denoiseIterations;
+		film->initialize();
+		film->m_samplePixels = header.samplePixels;
+
+		if (!film->mergeSnapshot(filename, &info))
+			return nullptr;
+		return film;
 	}
-}
\ No newline at end of file
+}
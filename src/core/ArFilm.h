@@ -6,13 +6,21 @@
 #include "ArSpectrum.h"
 #include "ArFilter.h"
 #include "ArParallel.h"
+#include "ArLiveFramebuffer.h"
 
 #include <memory>
 #include <vector>
+#include <future>
 
 namespace Aurora
 {
 
+	//Note: how a film tile adds a sample to the pixels within the filter radius, chosen once per
+	//      film by the shape of its filter. A box filter has a constant weight and the box of the
+	//      radius 0.5 covers exactly one pixel, a separable filter multiplies the weights of the
+	//      row and the column instead of looking up the full table.
+	enum class AFilmAccumulation { AGeneric, ABox, ABoxPixel, ASeparable };
+
 	class AFilm final : public AObject
 	{
 	public:
@@ -25,15 +33,59 @@ namespace Aurora
 
 		ABounds2i getSampleBounds() const;
 		const AVector2i getResolution() const { return m_resolution; }
+		const ABounds2i &getCroppedPixelBounds() const { return m_croppedPixelBounds; }
 
 		std::unique_ptr<AFilmTile> getFilmTile(const ABounds2i &sampleBounds);
 		void mergeFilmTile(std::unique_ptr<AFilmTile> tile);
 
+		//Note: the image file is encoded and written asynchronously,
+		//      call waitForPendingWrites() to make sure it is on disk.
+		//      The extension of the file name selects the format, ".pfm" and ".exr" keep the
+		//      linear radiance as 32-bit floats and anything else is written as an sRGB png.
+		//      A film with a "HDRFilename" writes a float image of the same pixels alongside.
 		void writeImageToFile(Float splatScale = 1);
 
+		static void waitForPendingWrites();
+
+		//Note: a snapshot stores the raw XYZ, filter weight and splat sums of the film, the feature
+		//      sums of a denoising film, the number of samples per pixel they hold and the shard (see
+		//      --shard) of the process that wrote it, snapshots of disjoint shards of a frame add up
+		//      to the full frame exactly
+		struct ASnapshotInfo
+		{
+			int64_t samplesPerPixel = 0;
+			int shardIndex = 0, shardCount = 1;
+		};
+
+		bool writeSnapshot(const std::string &filename, int64_t samplesPerPixel = 0) const;
+		bool mergeSnapshot(const std::string &filename, ASnapshotInfo *info = nullptr);
+
+		//Note: copies the film and writes it on a background thread, the snapshot is skipped
+		//      if the previous one of this film is still being written
+		bool writeSnapshotAsync(const std::string &filename, int64_t samplesPerPixel = 0);
+
+		//Note: a film without a filter that is only able to hold merged snapshots
+		static AFilm::ptr readSnapshot(const std::string &filename, ASnapshotInfo &info);
+
+		const std::string &getFilename() const { return m_filename; }
+
+		//Note: a film in filter sampling mode has the camera samples importance sample the filter
+		//      around the pixel centers (getCameraSample() with this sampler) and adds every sample
+		//      to its own pixel only. The sample bounds are the pixel bounds then, so that the tiles
+		//      don't overlap. Returns nullptr if the film splats the samples over the filter.
+		const AFilterSampler *getFilterSampler() const { return m_filterSampler.get(); }
+
+		//Note: a denoising film records the albedo and normal at the first hit of the camera
+		//      rays and filters the image with them before it's written
+		bool isDenoising() const { return m_denoise; }
+
 		void setImage(const ASpectrum *img) const;
 		void addSplat(const AVector2f &p, ASpectrum v);
 
+		//Note: a light path is splatted for every camera sample (see ABDPTIntegrator), the splats
+		//      are averaged over the camera samples the film received per pixel of its sample bounds
+		Float getSplatScale() const;
+
 		void clear();
 
 		virtual void activate() override { initialize(); }
@@ -44,10 +96,27 @@ namespace Aurora
 	private:
 		void initialize();
 
+		// Filter the scaled rgb values of the pixels with the recorded features
+		void denoise(Float *rgb) const;
+
+		// Encode the rgb values of the cropped pixels in the format of |filename| and queue the write
+		void writeImage(const std::string &filename, const Float *rgb) const;
+
+		// Mark the live framebuffer dirty, it's created by the first update of the film
+		void updateLiveFramebuffer();
+
+		// The weighted and scaled rgb values of the cropped pixels without the splats
+		void fillLiveFramebuffer(float *rgb) const;
+
+		std::shared_ptr<std::vector<char>> serializeSnapshot(int64_t samplesPerPixel) const;
+
 	private:
 
 		//Note: XYZ is a display independent representation of color,
 		//      and this is why we choose to use XYZ color herein.
+		//      Pixels are merged without a global lock: the pixels owned exclusively by
+		//      a tile are updated with plain loads and stores while the pixels shared
+		//      with neighbouring tiles (filter overlap) are updated by atomic adds.
 		struct APixel 
 		{
 			APixel() 
@@ -55,32 +124,68 @@ namespace Aurora
 				m_xyz[0] = m_xyz[1] = m_xyz[2] = m_filterWeightSum = 0; 
 			}
 
-			Float m_xyz[3];				//xyz color of the pixel
-			Float m_filterWeightSum;	//the sum of filter weight values
-			AAtomicFloat m_splatXYZ[3]; //unweighted sum of samples splats
-			Float m_pad;				//unused, ensure sizeof(APixel) -> 32 bytes
+			AAtomicFloat m_xyz[3];			//xyz color of the pixel
+			AAtomicFloat m_filterWeightSum;	//the sum of filter weight values
+			AAtomicFloat m_splatXYZ[3];		//unweighted sum of samples splats
+			Float m_pad;					//unused, ensure sizeof(APixel) -> 32 bytes
 		};
 
 		AVector2i m_resolution; //(width, height)
 		std::string m_filename;
+		std::string m_hdrFilename;	//optional float image written next to m_filename
 		std::unique_ptr<APixel[]> m_pixels;
 
 		Float m_diagonal;
 		ABounds2i m_croppedPixelBounds;	//actual rendering window
 
 		std::unique_ptr<AFilter> m_filter;
-		std::mutex m_mutex;
+
+		//Note: box filtered averages of the features of the samples taken in a pixel, since the
+		//      sample bounds of tiles are disjoint the tiles merge their features without atomics
+		struct AFeaturePixel
+		{
+			Float m_albedo[3] = { 0, 0, 0 };
+			Float m_normal[3] = { 0, 0, 0 };
+			Float m_weight = 0;
+		};
+
+		bool m_filterSampling = false;
+		std::unique_ptr<AFilterSampler> m_filterSampler;
+
+		bool m_denoise = false;
+		int m_denoiseIterations = 5;
+		std::unique_ptr<AFeaturePixel[]> m_features;
 
 		//Note: precomputed filter weights table
 		static constexpr int filterTableWidth = 16;
 		Float m_filterTable[filterTableWidth * filterTableWidth];
+		Float m_filterTableX[filterTableWidth], m_filterTableY[filterTableWidth];	//separable factors of the table
+		AFilmAccumulation m_accumulation = AFilmAccumulation::AGeneric;
 
 		Float m_scale;
 		Float m_maxSampleLuminance;
 
+		//Note: accumulated wall time spent in mergeFilmTile by all threads
+		std::atomic<int64_t> m_mergeTimeNS;
+
+		//Note: camera samples of the merged tiles and snapshots, taken over the m_samplePixels
+		//      pixels of the sample bounds
+		std::atomic<int64_t> m_cameraSamples;
+		int64_t m_samplePixels = 0;
+
+		//Note: image encodings still in flight, shared by all films
+		static std::mutex m_pendingWritesMutex;
+		static std::vector<std::shared_future<void>> m_pendingWrites;
+
+		std::shared_future<void> m_snapshotWrite;
+
+		//Note: declared last, its publisher thread reads the pixels until it's destroyed
+		std::once_flag m_liveFramebufferFlag;
+		ALiveFramebuffer::ptr m_liveFramebuffer;
+
 		APixel &getPixel(const AVector2i &p)
 		{
-			CHECK(insideExclusive(p, m_croppedPixelBounds));
+			DCHECK(insideExclusive(p, m_croppedPixelBounds));
 			int width = m_croppedPixelBounds.m_pMax.x - m_croppedPixelBounds.m_pMin.x;
 			int index = (p.x - m_croppedPixelBounds.m_pMin.x) + (p.y - m_croppedPixelBounds.m_pMin.y) * width;
 			return m_pixels[index];
@@ -94,90 +199,272 @@ namespace Aurora
 		Float m_filterWeightSum = 0.f;		//sum of the filter weights
 	};
 
+	//Note: running mean and variance (Welford) of the luminance of the samples taken in a pixel
+	struct APixelVariance
+	{
+		int64_t m_nSamples = 0;
+		Float m_mean = 0.f, m_m2 = 0.f;
+
+		void add(Float v)
+		{
+			++m_nSamples;
+			Float delta = v - m_mean;
+			m_mean += delta / m_nSamples;
+			m_m2 += delta * (v - m_mean);
+		}
+
+		Float variance() const { return (m_nSamples > 1) ? m_m2 / (m_nSamples - 1) : 0.f; }
+
+		// Standard error of the mean relative to the mean, dark pixels are judged by an absolute error
+		Float relativeError() const
+		{
+			if (m_nSamples < 2)
+				return aInfinity;
+			return glm::sqrt(variance() / m_nSamples) / glm::max(m_mean, (Float)0.01f);
+		}
+	};
+
+	//Note: first hit albedo and shading normal of the samples taken in a pixel
+	struct AFilmTileFeature
+	{
+		ASpectrum m_albedo = 0.f;
+		AVector3f m_normal = AVector3f(0.f);
+		Float m_weight = 0.f;
+	};
+
 	class AFilmTile final
 	{
 	public:
+		//Note: the separable accumulation keeps the weights of a row and a column on the stack
+		static constexpr int aMaxSeparableSpan = 16;
+
 		// FilmTile Public Methods
-		AFilmTile(const ABounds2i &pixelBounds, const AVector2f &filterRadius, const Float *filterTable,
-			int filterTableSize, Float maxSampleLuminance)
-			: m_pixelBounds(pixelBounds), m_filterRadius(filterRadius),
-			m_invFilterRadius(1 / filterRadius.x, 1 / filterRadius.y),
+		AFilmTile(const ABounds2i &pixelBounds, const ABounds2i &ownedPixelBounds, const ABounds2i &sampleBounds,
+			const AVector2f &filterRadius, const Float *filterTable, int filterTableSize, Float maxSampleLuminance,
+			bool recordFeatures = false, bool filterSampling = false,
+			AFilmAccumulation accumulation = AFilmAccumulation::AGeneric,
+			const Float *filterTableX = nullptr, const Float *filterTableY = nullptr)
+			: m_pixelBounds(pixelBounds), m_ownedPixelBounds(ownedPixelBounds), m_sampleBounds(sampleBounds),
+			m_filterRadius(filterRadius), m_invFilterRadius(1 / filterRadius.x, 1 / filterRadius.y),
 			m_filterTable(filterTable), m_filterTableSize(filterTableSize),
-			m_maxSampleLuminance(maxSampleLuminance) 
+			m_maxSampleLuminance(maxSampleLuminance), m_filterSampling(filterSampling), m_accumulation(accumulation),
+			m_filterTableX(filterTableX), m_filterTableY(filterTableY)
 		{
+			DCHECK(m_accumulation != AFilmAccumulation::ASeparable || (m_filterTableX && m_filterTableY));
 			m_pixels = std::vector<AFilmTilePixel>(glm::max(0, pixelBounds.area()));
+			if (recordFeatures)
+				m_features.resize(glm::max(0, sampleBounds.area()));
 		}
 
 		void addSample(const AVector2f &pFilm, ASpectrum L, Float sampleWeight = 1.f) 
 		{
+			++m_cameraSamples;
 			if (L.y() > m_maxSampleLuminance)
 				L *= m_maxSampleLuminance / L.y();
 
-			// Compute sample's raster bounds
+			switch (m_accumulation)
+			{
+			case AFilmAccumulation::ABoxPixel:
+				accumulate<AFilmAccumulation::ABoxPixel>(pFilm, L, sampleWeight);
+				break;
+			case AFilmAccumulation::ABox:
+				accumulate<AFilmAccumulation::ABox>(pFilm, L, sampleWeight);
+				break;
+			case AFilmAccumulation::ASeparable:
+				accumulate<AFilmAccumulation::ASeparable>(pFilm, L, sampleWeight);
+				break;
+			default:
+				accumulate<AFilmAccumulation::AGeneric>(pFilm, L, sampleWeight);
+				break;
+			}
+		}
+
+		//Note: the sample of a camera sample that importance sampled the filter around |pixel|,
+		//      it only contributes to that pixel with the filter value over pdf as its weight
+		void addPixelSample(const AVector2i &pixel, ASpectrum L, Float sampleWeight, Float filterWeight)
+		{
+			++m_cameraSamples;
+			if (L.y() > m_maxSampleLuminance)
+				L *= m_maxSampleLuminance / L.y();
+
+			AFilmTilePixel &tilePixel = getPixel(pixel);
+			tilePixel.m_contribSum += L * (sampleWeight * filterWeight);
+			tilePixel.m_filterWeightSum += filterWeight;
+		}
+
+		bool isFilterSampling() const { return m_filterSampling; }
+
+		AFilmTilePixel &getPixel(const AVector2i &p) 
+		{
+			DCHECK(insideExclusive(p, m_pixelBounds));
+			int width = m_pixelBounds.m_pMax.x - m_pixelBounds.m_pMin.x;
+			int index = (p.x - m_pixelBounds.m_pMin.x) + (p.y - m_pixelBounds.m_pMin.y) * width;
+			return m_pixels[index];
+		}
+
+		const AFilmTilePixel &getPixel(const AVector2i &p) const 
+		{
+			DCHECK(insideExclusive(p, m_pixelBounds));
+			int width =m_pixelBounds.m_pMax.x - m_pixelBounds.m_pMin.x;
+			int index = (p.x - m_pixelBounds.m_pMin.x) + (p.y - m_pixelBounds.m_pMin.y) * width;
+			return m_pixels[index];
+		}
+
+		ABounds2i getPixelBounds() const { return m_pixelBounds; }
+
+		//Note: sample statistics are kept per pixel of the sample bounds, they are only
+		//      allocated by the first call since non-adaptive rendering doesn't need them
+		void addVarianceSample(const AVector2i &pixel, const ASpectrum &L)
+		{
+			if (m_variances.empty())
+				m_variances.resize(glm::max(0, m_sampleBounds.area()));
+			const_cast<APixelVariance&>(getVariance(pixel)).add(L.y());
+		}
+
+		const APixelVariance &getVariance(const AVector2i &p) const
+		{
+			DCHECK(insideExclusive(p, m_sampleBounds));
+			int width = m_sampleBounds.m_pMax.x - m_sampleBounds.m_pMin.x;
+			return m_variances[(p.x - m_sampleBounds.m_pMin.x) + (p.y - m_sampleBounds.m_pMin.y) * width];
+		}
+
+		//Note: pixels that no other tile could contribute to
+		ABounds2i getOwnedPixelBounds() const { return m_ownedPixelBounds; }
+
+		ABounds2i getSampleBounds() const { return m_sampleBounds; }
+
+		bool isRecordingFeatures() const { return !m_features.empty(); }
+
+		int64_t getCameraSampleCount() const { return m_cameraSamples; }
+
+		void addFeatures(const AVector2i &pixel, const ASpectrum &albedo, const AVector3f &normal)
+		{
+			AFilmTileFeature &feature = m_features[featureIndex(pixel)];
+			feature.m_albedo += albedo;
+			feature.m_normal += normal;
+			feature.m_weight += 1;
+		}
+
+		const AFilmTileFeature &getFeatures(const AVector2i &pixel) const { return m_features[featureIndex(pixel)]; }
+
+	private:
+		template <AFilmAccumulation Mode>
+		void accumulate(const AVector2f &pFilm, const ASpectrum &L, Float sampleWeight)
+		{
 			AVector2f pFilmDiscrete = pFilm - AVector2f(0.5f, 0.5f);
+			if (Mode == AFilmAccumulation::ABoxPixel)
+			{
+				// The pixel whose center is within half a pixel, a sample on the border of two
+				// pixels belongs to the one on its right (bottom)
+				AVector2i p((int)glm::floor(pFilm.x), (int)glm::floor(pFilm.y));
+				if (insideExclusive(p, m_pixelBounds))
+				{
+					AFilmTilePixel &pixel = getPixel(p);
+					pixel.m_contribSum += L * sampleWeight;
+					pixel.m_filterWeightSum += 1;
+				}
+				return;
+			}
+
+			// Compute sample's raster bounds
 			AVector2i p0 = (AVector2i)ceil(pFilmDiscrete - m_filterRadius);
 			AVector2i p1 = (AVector2i)floor(pFilmDiscrete + m_filterRadius) + AVector2i(1, 1);
 			p0 = max(p0, m_pixelBounds.m_pMin);
 			p1 = min(p1, m_pixelBounds.m_pMax);
+			if (p0.x >= p1.x || p0.y >= p1.y)
+				return;
 
 			// Loop over filter support and add sample to pixel arrays
+			if (Mode == AFilmAccumulation::ABox)
+			{
+				const ASpectrum contrib = L * sampleWeight;
+				for (int y = p0.y; y < p1.y; ++y)
+				{
+					AFilmTilePixel *row = &getPixel(AVector2i(p0.x, y));
+					for (int x = 0; x < p1.x - p0.x; ++x)
+					{
+						row[x].m_contribSum += contrib;
+						row[x].m_filterWeightSum += 1;
+					}
+				}
+				return;
+			}
 
 			// Precompute $x$ and $y$ filter table offsets
-			int *ifx = ALLOCA(int, p1.x - p0.x);
+			int *ifx = (Mode == AFilmAccumulation::ASeparable) ? nullptr : ALLOCA(int, p1.x - p0.x);
+			Float wx[aMaxSeparableSpan], wy[aMaxSeparableSpan];
 			for (int x = p0.x; x < p1.x; ++x) 
 			{
 				Float fx = glm::abs((x - pFilmDiscrete.x) * m_invFilterRadius.x * m_filterTableSize);
-				ifx[x - p0.x] = glm::min((int)glm::floor(fx), m_filterTableSize - 1);
+				int i = glm::min((int)glm::floor(fx), m_filterTableSize - 1);
+				if (Mode == AFilmAccumulation::ASeparable)
+					wx[x - p0.x] = m_filterTableX[i];
+				else
+					ifx[x - p0.x] = i;
 			}
 
-			int *ify = ALLOCA(int, p1.y - p0.y);
+			int *ify = (Mode == AFilmAccumulation::ASeparable) ? nullptr : ALLOCA(int, p1.y - p0.y);
 			for (int y = p0.y; y < p1.y; ++y) 
 			{
-				Float fy = std::abs((y - pFilmDiscrete.y) * m_invFilterRadius.y * m_filterTableSize);
-				ify[y - p0.y] = glm::min((int)std::floor(fy), m_filterTableSize - 1);
+				Float fy = glm::abs((y - pFilmDiscrete.y) * m_invFilterRadius.y * m_filterTableSize);
+				int i = glm::min((int)glm::floor(fy), m_filterTableSize - 1);
+				if (Mode == AFilmAccumulation::ASeparable)
+					wy[y - p0.y] = m_filterTableY[i];
+				else
+					ify[y - p0.y] = i;
 			}
 
+			const ASpectrum contrib = L * sampleWeight;
 			for (int y = p0.y; y < p1.y; ++y) 
 			{
-				for (int x = p0.x; x < p1.x; ++x) 
+				AFilmTilePixel *row = &getPixel(AVector2i(p0.x, y));
+				if (Mode == AFilmAccumulation::ASeparable)
+				{
+					// Scale the contribution by the weight of the row once
+					const Float rowWeight = wy[y - p0.y];
+					if (rowWeight == 0)
+						continue;
+					const ASpectrum rowContrib = contrib * rowWeight;
+					for (int x = 0; x < p1.x - p0.x; ++x)
+					{
+						row[x].m_contribSum += rowContrib * wx[x];
+						row[x].m_filterWeightSum += rowWeight * wx[x];
+					}
+					continue;
+				}
+				for (int x = 0; x < p1.x - p0.x; ++x) 
 				{
 					// Evaluate filter value at $(x,y)$ pixel
-					int offset = ify[y - p0.y] * m_filterTableSize + ifx[x - p0.x];
-					Float filterWeight = m_filterTable[offset];
+					Float filterWeight = m_filterTable[ify[y - p0.y] * m_filterTableSize + ifx[x]];
 
 					// Update pixel values with filtered sample contribution
-					AFilmTilePixel &pixel = getPixel(AVector2i(x, y));
-					pixel.m_contribSum += L * sampleWeight * filterWeight;
-					pixel.m_filterWeightSum += filterWeight;
+					row[x].m_contribSum += contrib * filterWeight;
+					row[x].m_filterWeightSum += filterWeight;
 				}
 			}
 		}
 
-		AFilmTilePixel &getPixel(const AVector2i &p) 
-		{
-			CHECK(insideExclusive(p, m_pixelBounds));
-			int width = m_pixelBounds.m_pMax.x - m_pixelBounds.m_pMin.x;
-			int index = (p.x - m_pixelBounds.m_pMin.x) + (p.y - m_pixelBounds.m_pMin.y) * width;
-			return m_pixels[index];
-		}
-
-		const AFilmTilePixel &getPixel(const AVector2i &p) const 
-		{
-			CHECK(insideExclusive(p, m_pixelBounds));
-			int width =m_pixelBounds.m_pMax.x - m_pixelBounds.m_pMin.x;
-			int index = (p.x - m_pixelBounds.m_pMin.x) + (p.y - m_pixelBounds.m_pMin.y) * width;
-			return m_pixels[index];
-		}
-
-		ABounds2i getPixelBounds() const { return m_pixelBounds; }
-
-	private:
 		const ABounds2i m_pixelBounds;
+		const ABounds2i m_ownedPixelBounds;
+		const ABounds2i m_sampleBounds;
 		const AVector2f m_filterRadius, m_invFilterRadius;
 		const Float *m_filterTable;
 		const int m_filterTableSize;
 		std::vector<AFilmTilePixel> m_pixels;
+		std::vector<APixelVariance> m_variances;
+		std::vector<AFilmTileFeature> m_features;
 		const Float m_maxSampleLuminance;
+		const bool m_filterSampling;
+		const AFilmAccumulation m_accumulation;
+		int64_t m_cameraSamples = 0;
+		const Float *m_filterTableX, *m_filterTableY;	//separable factors of the filter table
+
+		int featureIndex(const AVector2i &p) const
+		{
+			DCHECK(insideExclusive(p, m_sampleBounds));
+			int width = m_sampleBounds.m_pMax.x - m_sampleBounds.m_pMin.x;
+			return (p.x - m_sampleBounds.m_pMin.x) + (p.y - m_sampleBounds.m_pMin.y) * width;
+		}
 		
 		friend class Film;
 	};
@@ -1,8 +1,44 @@
 #include "ArFilter.h"
 
+#include "ArLightDistrib.h"
+
 namespace Aurora
 {
 	AFilter::AFilter(const APropertyList &props) :
 		m_radius(props.getVector2f("Radius", AVector2f(0.5f))),
 		m_invRadius(AVector2f(1 / m_radius.x, 1 / m_radius.y)) {}
+
+	//-------------------------------------------AFilterSampler-------------------------------------
+
+	AFilterSampler::AFilterSampler(const AFilter &filter, int samplesPerRadius) : m_radius(filter.m_radius),
+		m_nx(2 * samplesPerRadius), m_ny(2 * samplesPerRadius), m_f(m_nx * m_ny)
+	{
+		// Tabulate the filter at the centers of the cells over [-radius, radius]^2
+		std::vector<Float> absF(m_f.size());
+		for (int y = 0; y < m_ny; ++y)
+		{
+			for (int x = 0; x < m_nx; ++x)
+			{
+				AVector2f p(lerp((x + 0.5f) / m_nx, -m_radius.x, m_radius.x), lerp((y + 0.5f) / m_ny, -m_radius.y, m_radius.y));
+				m_f[y * m_nx + x] = filter.evaluate(p);
+				absF[y * m_nx + x] = glm::abs(m_f[y * m_nx + x]);
+			}
+		}
+		m_distrib.reset(new ADistribution2D(absF.data(), m_nx, m_ny));
+	}
+
+	AFilterSampler::~AFilterSampler() = default;
+
+	AVector2f AFilterSampler::sample(const AVector2f &u, Float &weight) const
+	{
+		Float pdf;
+		AVector2f p = m_distrib->sampleContinuous(u, &pdf);
+		int x = glm::min((int)(p.x * m_nx), m_nx - 1);
+		int y = glm::min((int)(p.y * m_ny), m_ny - 1);
+
+		// The pdf is with respect to [0,1]^2, the filter domain is 4 * radius.x * radius.y large
+		pdf /= 4 * m_radius.x * m_radius.y;
+		weight = pdf > 0 ? m_f[y * m_nx + x] / pdf : 0;
+		return AVector2f(lerp(p.x, -m_radius.x, m_radius.x), lerp(p.y, -m_radius.y, m_radius.y));
+	}
 }
\ No newline at end of file
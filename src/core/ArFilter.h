@@ -5,8 +5,14 @@
 #include "ArMathUtils.h"
 #include "ArRtti.h"
 
+#include <vector>
+
 namespace Aurora
 {
+	//Note: the shapes of filters the film has specialized accumulation paths for, the filter
+	//      of a separable shape is the product f(x, y) = fx(x) * fy(y) of two positive functions
+	enum class AFilterShape { AGeneric, ABox, ASeparable };
+
 	class AFilter : public AObject
 	{
 	public:
@@ -19,11 +25,35 @@ namespace Aurora
 
 		virtual Float evaluate(const AVector2f &p) const = 0;
 
+		virtual AFilterShape getShape() const { return AFilterShape::AGeneric; }
+
 		virtual AClassType getClassType() const override { return AClassType::AEFilter; }
 
 		const AVector2f m_radius, m_invRadius;
 	};
 
+	class ADistribution2D;
+
+	//Note: importance sampling of a filter for the camera samples. The filter is tabulated over
+	//      its support and an offset from the pixel center is sampled proportionally to the
+	//      absolute values of the table, its weight is the filter value over the pdf. Within a
+	//      cell of the table the weight is constant, it's the integral of |f| with the sign of f.
+	class AFilterSampler
+	{
+	public:
+		AFilterSampler(const AFilter &filter, int samplesPerRadius = 32);
+		~AFilterSampler();
+
+		// Offset of the sample from the center of its pixel, |weight| is f(offset) / pdf(offset)
+		AVector2f sample(const AVector2f &u, Float &weight) const;
+
+	private:
+		AVector2f m_radius;
+		int m_nx, m_ny;
+		std::vector<Float> m_f;
+		std::unique_ptr<ADistribution2D> m_distrib;
+	};
+
 }
 
 #endif
\ No newline at end of file
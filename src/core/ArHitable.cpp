@@ -48,6 +48,12 @@ namespace Aurora
 
 	//-------------------------------------------AHitableAggregate-------------------------------------
 
+	void AHitableAggregate::occluded(const ARay *rays, int nRays, bool *occluded) const
+	{
+		for (int i = 0; i < nRays; ++i)
+			occluded[i] = hit(rays[i]);
+	}
+
 	const AAreaLight *AHitableAggregate::getAreaLight() const { return nullptr; }
 
 	const AMaterial *AHitableAggregate::getMaterial() const { return nullptr; }
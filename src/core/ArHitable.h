@@ -66,6 +66,11 @@ namespace Aurora
 	class AHitableAggregate : public AHitable
 	{
 	public:
+		typedef std::shared_ptr<AHitableAggregate> ptr;
+
+		//Note: occlusion of a batch of shadow rays, |occluded[i]| tells whether |rays[i]| hits anything.
+		//      The rays are tested one by one unless the aggregate can trace them together
+		virtual void occluded(const ARay *rays, int nRays, bool *occluded) const;
 
 		virtual const AAreaLight *getAreaLight() const override;
 		virtual const AMaterial *getMaterial() const override;
@@ -7,6 +7,9 @@
 #include "ArLightDistrib.h"
 #include "ArParallel.h"
 
+#include <algorithm>
+#include <fstream>
+
 namespace Aurora
 {
 	//-------------------------------------------ASamplerIntegrator-------------------------------------
@@ -23,100 +26,408 @@ namespace Aurora
 		constexpr int tileSize = 16;
 		AVector2i nTiles((sampleExtent.x + tileSize - 1) / tileSize, (sampleExtent.y + tileSize - 1) / tileSize);
 
-		AReporter reporter(nTiles.x * nTiles.y, "Rendering");
-	 	AParallelUtils::parallelFor((size_t)0, (size_t)(nTiles.x * nTiles.y), [&](const size_t &t)
+		allocateArenas();
+
+		// Select the tiles of this shard, each tile keeps its own sampler seed
+		// so that the shards of a frame add up to the single process result
+		const int shardIndex = aOptions.shardIndex, shardCount = aOptions.shardCount;
+		const int nShardTiles = (nTiles.x * nTiles.y - shardIndex + shardCount - 1) / shardCount;
+
+		AFilm &film = *m_camera->m_film;
+		const std::string shardSuffix = (shardCount > 1) ? stringPrintf(".shard%dof%d", shardIndex, shardCount) : "";
+		const std::string checkpointFilename = film.getFilename() + shardSuffix + ".checkpoint";
+
+		// Continue from the samples per pixel held by the checkpoint of a previous run
+		const int64_t spp = sampler->getSamplingNumber();
+		int64_t firstSample = 0;
+		if (aOptions.resume && sampler->isAdaptive())
+		{
+			// Note: the adaptive sampler decides the samples of a pixel from all the samples taken
+			//       before, which a checkpoint doesn't hold.
+			LOG(ERROR) << "Can't resume adaptive sampling, rendering from scratch";
+		}
+		else if (aOptions.resume)
 		{
-			
-			AVector2i tile(t % nTiles.x, t / nTiles.x);
-			MemoryArena arena;
+			AFilm::ASnapshotInfo checkpoint;
+			if (std::ifstream(checkpointFilename).good() && film.mergeSnapshot(checkpointFilename, &checkpoint))
+			{
+				firstSample = checkpoint.samplesPerPixel;
+				LOG(INFO) << "Resuming from " << checkpointFilename << " with " << firstSample << " samples per pixel";
+				if (firstSample > spp)
+				{
+					LOG(WARNING) << "The checkpoint holds more than the " << spp << " samples per pixel of the sampler";
+				}
+			}
+			else
+			{
+				LOG(WARNING) << "No checkpoint to resume from, rendering from scratch";
+			}
+		}
 
-			// Get sampler instance for tile
-			int seed = t;
-			std::unique_ptr<ASampler> tileSampler = sampler->clone(seed);
+		// In progressive mode the samples of every pixel are taken in passes over all the tiles,
+		// the film accumulates the passes so that the image can be written out after any of them
+		int64_t passSpp = glm::max((int64_t)1, spp - firstSample);
+		if (aOptions.passSpp > 0 || aOptions.timeLimit > 0 || aOptions.writeInterval > 0 ||
+			aOptions.checkpointInterval > 0 || firstSample > 0)
+		{
+			if (sampler->isAdaptive())
+			{
+				LOG(WARNING) << "Progressive rendering isn't supported by adaptive sampling, rendering in one pass";
+			}
+			else
+			{
+				passSpp = glm::min(passSpp, (int64_t)glm::max(1, aOptions.passSpp));
+			}
+		}
+		const int nPasses = (int)((glm::max((int64_t)0, spp - firstSample) + passSpp - 1) / passSpp);
 
-			// Compute sample bounds for tile
-			int x0 = sampleBounds.m_pMin.x + tile.x * tileSize;
-			int x1 = glm::min(x0 + tileSize, sampleBounds.m_pMax.x);
-			int y0 = sampleBounds.m_pMin.y + tile.y * tileSize;
-			int y1 = glm::min(y0 + tileSize, sampleBounds.m_pMax.y);
-			ABounds2i tileBounds(AVector2i(x0, y0), AVector2i(x1, y1));
-			LOG(INFO) << "Starting image tile " << tileBounds;
+		int64_t endSample = firstSample;
 
-			// Get _FilmTile_ for tile
-			std::unique_ptr<AFilmTile> filmTile = m_camera->m_film->getFilmTile(tileBounds);
+		// A shard beyond the last tile renders nothing, its empty snapshot still completes the set
+		if (nShardTiles <= 0 && shardCount > 1)
+		{
+			LOG(WARNING) << "Shard " << shardIndex << " of " << shardCount << " has no tiles, the image only has "
+				<< nTiles.x * nTiles.y << " tiles. Writing an empty snapshot";
+			film.writeSnapshot(film.getFilename() + shardSuffix, spp);
+			return;
+		}
 
-			// Loop over pixels in tile to render them
-			for (AVector2i pixel : tileBounds)
+		auto writeFilm = [&]() -> void
+		{
+			if (shardCount > 1)
+			{
+				film.writeSnapshot(film.getFilename() + shardSuffix, endSample);
+			}
+			else
 			{
-				tileSampler->startPixel(pixel);
+				film.writeImageToFile(film.getSplatScale());
+			}
+		};
+
+		AReporter reporter(nShardTiles * nPasses, "Rendering");
+		Float lastWriteMS = 0, lastCheckpointMS = 0;
+		int pass = 0;
+		for (; pass < nPasses; ++pass)
+		{
+			const int64_t passFirstSample = endSample;
+			endSample = glm::min(passFirstSample + passSpp, spp);
 
-				do
+			AParallelUtils::parallelFor((size_t)0, (size_t)nShardTiles, [&](const size_t &k)
+			{
+				const size_t t = shardIndex + k * shardCount;
+				AVector2i tile(t % nTiles.x, t / nTiles.x);
+				MemoryArena &arena = *m_arenas[AParallelUtils::getThreadIndex()];
+
+				// Get sampler instance for tile, every pass continues the sample sequence of the
+				// pixels with another random number stream, which only depends on its first sample
+				int seed = (int)(t + passFirstSample * nTiles.x * nTiles.y);
+				std::unique_ptr<ASampler> tileSampler = sampler->clone(seed);
+				if (endSample - passFirstSample < spp)
 				{
-					// Initialize _CameraSample_ for current sample
-					ACameraSample cameraSample = tileSampler->getCameraSample(pixel);
+					tileSampler->setSampleRange(passFirstSample, endSample);
+				}
 
-					// Generate camera ray for current sample
-					ARay ray;
-					Float rayWeight = m_camera->castingRay(cameraSample, ray);
+				// Compute sample bounds for tile
+				int x0 = sampleBounds.m_pMin.x + tile.x * tileSize;
+				int x1 = glm::min(x0 + tileSize, sampleBounds.m_pMax.x);
+				int y0 = sampleBounds.m_pMin.y + tile.y * tileSize;
+				int y1 = glm::min(y0 + tileSize, sampleBounds.m_pMax.y);
+				ABounds2i tileBounds(AVector2i(x0, y0), AVector2i(x1, y1));
+				LOG(INFO) << "Starting image tile " << tileBounds;
 
-					// Evaluate radiance along camera ray
-					ASpectrum L(0.f);
-					if (rayWeight > 0)
-					{
-						L = Li(ray, scene, *tileSampler, arena);
-					}
+				// Get _FilmTile_ for tile
+				std::unique_ptr<AFilmTile> filmTile = film.getFilmTile(tileBounds);
 
-					// Issue warning if unexpected radiance value returned
-					if (L.hasNaNs())
-					{
-						LOG(ERROR) << stringPrintf(
-							"Not-a-number radiance value returned "
-							"for pixel (%d, %d), sample %d. Setting to black.",
-							pixel.x, pixel.y,
-							(int)tileSampler->currentSampleNumber());
-						L = ASpectrum(0.f);
-					}
-					else if (L.y() < -1e-5)
-					{
-						LOG(ERROR) << stringPrintf(
-							"Negative luminance value, %f, returned "
-							"for pixel (%d, %d), sample %d. Setting to black.",
-							L.y(), pixel.x, pixel.y,
-							(int)tileSampler->currentSampleNumber());
-						L = ASpectrum(0.f);
-					}
-					else if (std::isinf(L.y()))
-					{
-						LOG(ERROR) << stringPrintf(
-							"Infinite luminance value returned "
-							"for pixel (%d, %d), sample %d. Setting to black.",
-							pixel.x, pixel.y,
-							(int)tileSampler->currentSampleNumber());
-						L = ASpectrum(0.f);
-					}
-					VLOG(1) << "Camera sample: " << cameraSample << " -> ray: " << ray << " -> L = " << L;
+				renderTile(scene, tileBounds, *tileSampler, *filmTile, arena);
+
+				LOG(INFO) << "Finished image tile " << tileBounds;
 
-					// Add camera ray's contribution to image
-					filmTile->addSample(cameraSample.pFilm, L, rayWeight);
+				film.mergeFilmTile(std::move(filmTile));
+				reporter.update();
 
-					// Free _MemoryArena_ memory from computing image sample value
-					arena.Reset();
+			}, AExecutionPolicy::APARALLEL);
 
-				} while (tileSampler->startNextSample());
+			if (pass + 1 == nPasses)
+				continue;
+
+			// Don't start a pass that is not expected to finish within the time limit
+			Float elapsedMS = reporter.elapsedMS();
+			if (aOptions.timeLimit > 0 && elapsedMS * (pass + 2) / (pass + 1) > aOptions.timeLimit * 1000)
+			{
+				LOG(INFO) << "Time limit reached after " << endSample << " samples per pixel";
+				++pass;
+				break;
+			}
+
+			if (aOptions.writeInterval > 0 && elapsedMS - lastWriteMS >= aOptions.writeInterval * 1000)
+			{
+				// Intermediate images go to the same file, the previous one has to be on disk first
+				AFilm::waitForPendingWrites();
+				writeFilm();
+				lastWriteMS = elapsedMS;
 			}
-			LOG(INFO) << "Finished image tile " << tileBounds;
 
-			m_camera->m_film->mergeFilmTile(std::move(filmTile));
-			reporter.update();
-			
-		}, AExecutionPolicy::APARALLEL);
+			// The film is copied between the passes and written while the next pass renders
+			if (aOptions.checkpointInterval > 0 && elapsedMS - lastCheckpointMS >= aOptions.checkpointInterval * 1000)
+			{
+				film.writeSnapshotAsync(checkpointFilename, endSample);
+				lastCheckpointMS = elapsedMS;
+			}
+		}
 
 		reporter.done();
 
-		LOG(INFO) << "Rendering finished";
+		LOG(INFO) << "Rendering finished after " << pass << " of " << nPasses << " passes";
+
+		size_t arenaTotal = 0, arenaPeak = 0, arenaBlocks = 0;
+		for (const auto &arena : m_arenas)
+		{
+			arenaTotal += arena->TotalAllocated();
+			arenaPeak = glm::max(arenaPeak, arena->HighWaterMark());
+			arenaBlocks += arena->NumBlockAllocations();
+		}
+		LOG(INFO) << "Memory arenas: " << arenaTotal << " bytes reserved in " << arenaBlocks
+			<< " blocks, peak per-thread usage " << arenaPeak << " bytes";
+
+		if (nPasses > 1)
+		{
+			AFilm::waitForPendingWrites();
+		}
+		writeFilm();
+
+		// The last checkpoint allows to add more samples to the finished image later on
+		if (aOptions.checkpointInterval > 0)
+		{
+			film.writeSnapshotAsync(checkpointFilename, endSample);
+		}
+	}
+
+	void ASamplerIntegrator::allocateArenas()
+	{
+		// Allocate per-thread arenas, the kernel still maps their pages lazily
+		if (m_arenas.size() != (size_t)numSystemCores())
+		{
+			m_arenas.clear();
+			for (int i = 0; i < numSystemCores(); ++i)
+			{
+				m_arenas.push_back(MemoryArena::CreateAligned(262144, aOptions.hugePages));
+			}
+		}
+	}
+
+	void ASamplerIntegrator::renderTile(const AScene &scene, const ABounds2i &tileBounds,
+		ASampler &tileSampler, AFilmTile &filmTile, MemoryArena &arena)
+	{
+		if (tileSampler.isAdaptive())
+		{
+			renderTileAdaptive(scene, tileBounds, tileSampler, filmTile, arena);
+			return;
+		}
 
-		m_camera->m_film->writeImageToFile();
+		// Loop over pixels in tile to render them
+		for (AVector2i pixel : tileBounds)
+		{
+			tileSampler.startPixel(pixel);
 
+			do
+			{
+				renderSample(scene, pixel, tileSampler, filmTile, arena);
+			} while (tileSampler.startNextSample());
+		}
+	}
+
+	void ASamplerIntegrator::renderTileAdaptive(const AScene &scene, const ABounds2i &tileBounds,
+		ASampler &tileSampler, AFilmTile &filmTile, MemoryArena &arena)
+	{
+		const int64_t minSpp = tileSampler.getMinSamplingNumber();
+		const int64_t maxSpp = tileSampler.getSamplingNumber();
+		const Float threshold = tileSampler.getAdaptiveThreshold();
+
+		// The tile never takes more samples than the non-adaptive render would
+		int64_t budget = tileSampler.getTargetSamplingNumber() * tileBounds.area();
+
+		std::vector<AVector2i> pixels;
+		for (AVector2i pixel : tileBounds)
+		{
+			pixels.push_back(pixel);
+		}
+		std::vector<int64_t> nSamples(pixels.size(), 0);
+
+		// Continue the sample sequence of pixel _i_ with _count_ more samples
+		auto takeSamples = [&](size_t i, int64_t count) -> void
+		{
+			tileSampler.startPixel(pixels[i]);
+			tileSampler.setSampleNumber(nSamples[i]);
+			for (int64_t s = 0; s < count; ++s)
+			{
+				ASpectrum L = renderSample(scene, pixels[i], tileSampler, filmTile, arena);
+				filmTile.addVarianceSample(pixels[i], L);
+				tileSampler.startNextSample();
+			}
+			nSamples[i] += count;
+			budget -= count;
+		};
+
+		// Every pixel takes the minimum number of samples first
+		for (size_t i = 0; i < pixels.size(); ++i)
+		{
+			takeSamples(i, minSpp);
+		}
+
+		// Then the pixels that haven't converged yet take more samples in rounds,
+		// the noisiest ones first in case the budget runs out
+		std::vector<std::pair<Float, size_t>> unconverged;
+		while (budget > 0)
+		{
+			unconverged.clear();
+			for (size_t i = 0; i < pixels.size(); ++i)
+			{
+				Float error = filmTile.getVariance(pixels[i]).relativeError();
+				if (nSamples[i] < maxSpp && error > threshold)
+					unconverged.push_back(std::make_pair(error, i));
+			}
+			if (unconverged.empty())
+				break;
+
+			std::sort(unconverged.begin(), unconverged.end(),
+				[](const std::pair<Float, size_t> &a, const std::pair<Float, size_t> &b) { return a.first > b.first; });
+			for (const auto &pixel : unconverged)
+			{
+				int64_t count = glm::min(glm::min(minSpp, maxSpp - nSamples[pixel.second]), budget);
+				if (count <= 0)
+					break;
+				takeSamples(pixel.second, count);
+			}
+		}
+
+		VLOG(1) << "Adaptive sampling of tile " << tileBounds << " left " << budget << " samples of its budget";
+	}
+
+	ASpectrum ASamplerIntegrator::renderSample(const AScene &scene, const AVector2i &pixel,
+		ASampler &tileSampler, AFilmTile &filmTile, MemoryArena &arena)
+	{
+		// Initialize _CameraSample_ for current sample
+		ACameraSample cameraSample = tileSampler.getCameraSample(pixel, m_camera->m_film->getFilterSampler());
+
+		// Generate camera ray for current sample
+		ARay ray;
+		Float rayWeight = m_camera->castingRay(cameraSample, ray);
+
+		// Evaluate radiance along camera ray
+		ASpectrum L(0.f);
+		if (rayWeight > 0)
+		{
+			L = Li(ray, scene, tileSampler, arena);
+		}
+
+		// Issue warning if unexpected radiance value returned
+		checkRadiance(L, pixel, tileSampler.currentSampleNumber());
+
+		VLOG(1) << "Camera sample: " << cameraSample << " -> ray: " << ray << " -> L = " << L;
+
+		// Add camera ray's contribution to image
+		if (filmTile.isFilterSampling())
+		{
+			filmTile.addPixelSample(pixel, L, rayWeight, cameraSample.filterWeight);
+		}
+		else
+		{
+			filmTile.addSample(cameraSample.pFilm, L, rayWeight);
+		}
+
+		if (filmTile.isRecordingFeatures())
+		{
+			addFeatures(scene, ray, pixel, filmTile, arena);
+		}
+
+		// Free _MemoryArena_ memory from computing image sample value
+		arena.Reset();
+
+		return L;
+	}
+
+	void ASamplerIntegrator::addFeatures(const AScene &scene, const ARay &cameraRay, const AVector2i &pixel,
+		AFilmTile &filmTile, MemoryArena &arena) const
+	{
+		// Follow perfectly specular surfaces, so that mirrors and glass show the features
+		// of what they reflect, and give up after a few bounces
+		ASpectrum albedo(0.f), beta(1.f);
+		AVector3f normal(0.f);
+		ARay ray(cameraRay);
+		const ABxDFType nonSpecular = ABxDFType(BSDF_ALL & ~BSDF_SPECULAR);
+		for (int bounces = 0; bounces < 4; ++bounces)
+		{
+			ASurfaceInteraction isect;
+			if (!scene.hit(ray, isect))
+				break;
+
+			isect.computeScatteringFunctions(ray, arena, true);
+			if (!isect.bsdf)
+			{
+				ray = isect.spawnRay(ray.direction());
+				continue;
+			}
+
+			AVector3f wi;
+			Float pdf;
+			ABxDFType sampledType;
+			if (isect.bsdf->numComponents(nonSpecular) > 0)
+			{
+				// Estimate the albedo with a few stratified directions of the BSDF,
+				// the fixed directions keep the sample's random numbers untouched
+				constexpr int nDirections = 2;
+				ASpectrum rho(0.f);
+				for (int y = 0; y < nDirections; ++y)
+				{
+					for (int x = 0; x < nDirections; ++x)
+					{
+						AVector2f u((x + 0.5f) / nDirections, (y + 0.5f) / nDirections);
+						ASpectrum f = isect.bsdf->sample_f(isect.wo, wi, u, pdf, sampledType, nonSpecular);
+						if (pdf > 0)
+							rho += f * absDot(wi, isect.n) / pdf;
+					}
+				}
+				albedo = beta * rho / (Float)(nDirections * nDirections);
+				normal = isect.n;
+				break;
+			}
+
+			ASpectrum f = isect.bsdf->sample_f(isect.wo, wi, AVector2f(0.5f, 0.5f), pdf, sampledType, BSDF_ALL);
+			if (f.isBlack() || pdf == 0)
+				break;
+			beta *= f * absDot(wi, isect.n) / pdf;
+			ray = isect.spawnRay(wi);
+		}
+
+		filmTile.addFeatures(pixel, albedo, normal);
+	}
+
+	void ASamplerIntegrator::checkRadiance(ASpectrum &L, const AVector2i &pixel, int64_t sampleNumber)
+	{
+		if (L.hasNaNs())
+		{
+			LOG(ERROR) << stringPrintf(
+				"Not-a-number radiance value returned "
+				"for pixel (%d, %d), sample %d. Setting to black.",
+				pixel.x, pixel.y, (int)sampleNumber);
+			L = ASpectrum(0.f);
+		}
+		else if (L.y() < -1e-5)
+		{
+			LOG(ERROR) << stringPrintf(
+				"Negative luminance value, %f, returned "
+				"for pixel (%d, %d), sample %d. Setting to black.",
+				L.y(), pixel.x, pixel.y, (int)sampleNumber);
+			L = ASpectrum(0.f);
+		}
+		else if (std::isinf(L.y()))
+		{
+			LOG(ERROR) << stringPrintf(
+				"Infinite luminance value returned "
+				"for pixel (%d, %d), sample %d. Setting to black.",
+				pixel.x, pixel.y, (int)sampleNumber);
+			L = ASpectrum(0.f);
+		}
 	}
 
 	ASpectrum ASamplerIntegrator::specularReflect(const ARay &ray, const ASurfaceInteraction &isect,
@@ -169,9 +480,43 @@ namespace Aurora
 
 	//------------------------------------------Utility functions-------------------------------------
 
+	AShadowRayBatch::AShadowRayBatch(MemoryArena &arena, int capacity) : m_capacity(capacity)
+	{
+		m_rays = arena.Alloc<ARay>(capacity);
+		m_L = arena.Alloc<ASpectrum>(capacity);
+		m_occluded = arena.Alloc<bool>(capacity, false);
+	}
+
+	void AShadowRayBatch::add(const ARay &ray, const ASpectrum &L)
+	{
+		CHECK_LT(m_nRays, m_capacity);
+		m_rays[m_nRays] = ray;
+		m_L[m_nRays] = L * m_weight;
+		++m_nRays;
+	}
+
+	ASpectrum AShadowRayBatch::resolve(const AScene &scene)
+	{
+		ASpectrum L(0.f);
+		scene.occluded(m_rays, m_nRays, m_occluded);
+		for (int i = 0; i < m_nRays; ++i)
+		{
+			if (!m_occluded[i])
+				L += m_L[i];
+		}
+		m_nRays = 0;
+		return L;
+	}
+
 	ASpectrum uiformSampleAllLights(const AInteraction &it, const AScene &scene,
 		MemoryArena &arena, ASampler &sampler, const std::vector<int> &nLightSamples)
 	{
+		// The shadow rays of all the lights are tested as one batch
+		int nShadowRays = 0;
+		for (size_t j = 0; j < scene.m_lights.size(); ++j)
+			nShadowRays += nLightSamples[j];
+		AShadowRayBatch shadowRays(arena, nShadowRays);
+
 		ASpectrum L(0.f);
 		for (size_t j = 0; j < scene.m_lights.size(); ++j)
 		{
@@ -183,27 +528,30 @@ namespace Aurora
 
 			if (!uLightArray || !uScatteringArray)
 			{
-				// Use a single sample for illumination from _light_
-				AVector2f uLight = sampler.get2D();
-				AVector2f uScattering = sampler.get2D();
-				L += estimateDirect(it, uScattering, *light, uLight, scene, sampler, arena);
+				// Stratify the samples of the light here if the sampler doesn't provide arrays
+				AVector2f *uLight = arena.Alloc<AVector2f>(nSamples, false);
+				AVector2f *uScattering = arena.Alloc<AVector2f>(nSamples, false);
+				latinHypercube(uLight, nSamples, sampler);
+				latinHypercube(uScattering, nSamples, sampler);
+				uLightArray = uLight;
+				uScatteringArray = uScattering;
 			}
-			else
+
+			// Estimate direct lighting using sample arrays
+			ASpectrum Ld(0.f);
+			shadowRays.setWeight((Float)1 / nSamples);
+			for (int k = 0; k < nSamples; ++k)
 			{
-				// Estimate direct lighting using sample arrays
-				ASpectrum Ld(0.f);
-				for (int k = 0; k < nSamples; ++k)
-				{
-					Ld += estimateDirect(it, uScatteringArray[k], *light, uLightArray[k], scene, sampler, arena);
-				}
-				L += Ld / nSamples;
+				Ld += estimateDirect(it, uScatteringArray[k], *light, uLightArray[k], scene, sampler, arena,
+					false, &shadowRays);
 			}
+			L += Ld / nSamples;
 		}
-		return L;
+		return L + shadowRays.resolve(scene);
 	}
 
 	ASpectrum uniformSampleOneLight(const AInteraction &it, const AScene &scene,
-		MemoryArena &arena, ASampler &sampler, const ADistribution1D *lightDistrib)
+		MemoryArena &arena, ASampler &sampler, const ALightDistribution *lightDistrib)
 	{
 		// Randomly choose a single light to sample, _light_
 		int nLights = int(scene.m_lights.size());
@@ -216,7 +564,7 @@ namespace Aurora
 
 		if (lightDistrib != nullptr) 
 		{
-			lightSampledIndex = lightDistrib->sampleDiscrete(sampler.get1D(), &lightPdf);
+			lightSampledIndex = lightDistrib->sample(sampler.get1D(), it.p, it.n, lightPdf);
 			if (lightPdf == 0) 
 				return ASpectrum(0.f);
 		}
@@ -227,14 +575,34 @@ namespace Aurora
 		}
 
 		const ALight::ptr &light = scene.m_lights[lightSampledIndex];
-		AVector2f uLight = sampler.get2D();
-		AVector2f uScattering = sampler.get2D();
+		const int nSamples = light->m_nSamples;
+		if (nSamples == 1)
+		{
+			AVector2f uLight = sampler.get2D();
+			AVector2f uScattering = sampler.get2D();
+			return estimateDirect(it, uScattering, *light, uLight, scene, sampler, arena) / lightPdf;
+		}
 
-		return estimateDirect(it, uScattering, *light, uLight, scene, sampler, arena) / lightPdf;
+		// Take the stratified samples the light asks for and test their shadow rays as one batch
+		AVector2f *uLight = arena.Alloc<AVector2f>(nSamples, false);
+		AVector2f *uScattering = arena.Alloc<AVector2f>(nSamples, false);
+		latinHypercube(uLight, nSamples, sampler);
+		latinHypercube(uScattering, nSamples, sampler);
+
+		AShadowRayBatch shadowRays(arena, nSamples);
+		shadowRays.setWeight(1 / (nSamples * lightPdf));
+		ASpectrum Ld(0.f);
+		for (int k = 0; k < nSamples; ++k)
+		{
+			Ld += estimateDirect(it, uScattering[k], *light, uLight[k], scene, sampler, arena,
+				false, &shadowRays);
+		}
+		return Ld / (nSamples * lightPdf) + shadowRays.resolve(scene);
 	}
 
 	ASpectrum estimateDirect(const AInteraction &it, const AVector2f &uScattering, const ALight &light,
-		const AVector2f &uLight, const AScene &scene, ASampler &sampler, MemoryArena &arena, bool specular)
+		const AVector2f &uLight, const AScene &scene, ASampler &sampler, MemoryArena &arena, bool specular,
+		AShadowRayBatch *shadowRays)
 	{
 		ABxDFType bsdfFlags = specular ? BSDF_ALL : ABxDFType(BSDF_ALL & ~BSDF_SPECULAR);
 
@@ -257,24 +625,26 @@ namespace Aurora
 
 			if (!f.isBlack())
 			{
-				// Compute effect of visibility for light source sample
-				if (!visibility.unoccluded(scene))
+				// Light's contribution to reflected radiance if the light sample is visible
+				ASpectrum Ll;
+				if (isDeltaLight(light.m_flags))
 				{
-					Li = ASpectrum(0.f);
+					Ll = f * Li / lightPdf;
+				}
+				else
+				{
+					Float weight = powerHeuristic(1, lightPdf, 1, scatteringPdf);
+					Ll = f * Li * weight / lightPdf;
 				}
 
-				// Add light's contribution to reflected radiance
-				if (!Li.isBlack())
+				// Compute effect of visibility for light source sample
+				if (shadowRays != nullptr)
 				{
-					if (isDeltaLight(light.m_flags))
-					{
-						Ld += f * Li / lightPdf;
-					}
-					else
-					{
-						Float weight = powerHeuristic(1, lightPdf, 1, scatteringPdf);
-						Ld += f * Li * weight / lightPdf;
-					}
+					shadowRays->add(visibility.P0().spawnRayTo(visibility.P1()), Ll);
+				}
+				else if (visibility.unoccluded(scene))
+				{
+					Ld += Ll;
 				}
 			}
 		}
@@ -7,6 +7,7 @@
 #include "ArCamera.h"
 #include "ArHitable.h"
 #include "ArRtti.h"
+#include "ArMemory.h"
 
 namespace Aurora
 {
@@ -37,6 +38,10 @@ namespace Aurora
 
 		virtual void render(const AScene &scene) override;
 
+		//Note: render all the samples of one image tile, called concurrently for different tiles
+		virtual void renderTile(const AScene &scene, const ABounds2i &tileBounds,
+			ASampler &tileSampler, AFilmTile &filmTile, MemoryArena &arena);
+
 		virtual ASpectrum Li(const ARay &ray, const AScene &scene,
 			ASampler &sampler, MemoryArena &arena, int depth = 0) const = 0;
 
@@ -47,18 +52,66 @@ namespace Aurora
 			const AScene &scene, ASampler &sampler, MemoryArena &arena, int depth) const;
 
 	protected:
+		// Create the arenas of the worker threads unless they already exist
+		void allocateArenas();
+
+		// Sample the pixels of the tile by their estimated error, see ASampler::isAdaptive()
+		void renderTileAdaptive(const AScene &scene, const ABounds2i &tileBounds,
+			ASampler &tileSampler, AFilmTile &filmTile, MemoryArena &arena);
+
+		// Trace the current sample of the sampler and add it to the film tile, returns its radiance
+		ASpectrum renderSample(const AScene &scene, const AVector2i &pixel,
+			ASampler &tileSampler, AFilmTile &filmTile, MemoryArena &arena);
+
+		// Add the albedo and normal of the first non-specular surface seen by the camera ray to
+		// the tile, used by the denoiser of the film
+		void addFeatures(const AScene &scene, const ARay &ray, const AVector2i &pixel,
+			AFilmTile &filmTile, MemoryArena &arena) const;
+
+		// Replace NaN, negative and infinite radiance values by black with an error message
+		static void checkRadiance(ASpectrum &L, const AVector2i &pixel, int64_t sampleNumber);
+
 		ACamera::ptr m_camera;
 		ASampler::ptr m_sampler;
+
+		//Note: one arena per worker thread, kept alive across tiles and renders
+		//      so that their blocks are only requested from the system once
+		std::vector<MemoryArena::ptr> m_arenas;
+	};
+
+	//Note: shadow rays of the light samples of one shading point. They are tested together by
+	//      resolve(), which sums the contributions of the unoccluded ones
+	class AShadowRayBatch final
+	{
+	public:
+		AShadowRayBatch(MemoryArena &arena, int capacity);
+
+		// Scale of the contributions added from now on
+		void setWeight(Float weight) { m_weight = weight; }
+
+		void add(const ARay &ray, const ASpectrum &L);
+
+		ASpectrum resolve(const AScene &scene);
+
+	private:
+		ARay *m_rays;
+		ASpectrum *m_L;
+		bool *m_occluded;
+		int m_nRays = 0, m_capacity;
+		Float m_weight = 1;
 	};
 
 	ASpectrum uiformSampleAllLights(const AInteraction &it, const AScene &scene,
 		MemoryArena &arena, ASampler &sampler, const std::vector<int> &nLightSamples);
 
 	ASpectrum uniformSampleOneLight(const AInteraction &it, const AScene &scene,
-		MemoryArena &arena, ASampler &sampler, const ADistribution1D *lightDistrib);
+		MemoryArena &arena, ASampler &sampler, const ALightDistribution *lightDistrib);
 
+	//Note: with |shadowRays| the light sample isn't tested for occlusion, its shadow ray and
+	//      contribution go to the batch and only the BSDF sample is part of the returned estimate
 	ASpectrum estimateDirect(const AInteraction &it, const AVector2f &uShading, const ALight &light,
-		const AVector2f &uLight, const AScene &scene, ASampler &sampler, MemoryArena &arena, bool specular = false);
+		const AVector2f &uLight, const AScene &scene, ASampler &sampler, MemoryArena &arena, bool specular = false,
+		AShadowRayBatch *shadowRays = nullptr);
 
 }
 
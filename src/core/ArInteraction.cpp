@@ -8,7 +8,7 @@ namespace Aurora
 {
 	ASurfaceInteraction::ASurfaceInteraction(const AVector3f &p, const AVector2f &uv, const AVector3f &wo,
 		const AVector3f &dpdu, const AVector3f &dpdv, const AShape *sh)
-		: AInteraction(p, normalize(cross(dpdu, dpdv)), wo), uv(uv), dpdu(dpdu), dpdv(dpdv), shape(sh) {}
+		: AInteraction(p, normalize(cross(dpdu, dpdv)), wo), uv(uv), dpdu(dpdu), dpdv(dpdv), ng(n), shape(sh) {}
 
 	ASpectrum ASurfaceInteraction::Le(const AVector3f &w) const
 	{
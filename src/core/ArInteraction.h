@@ -16,24 +16,36 @@ namespace Aurora
 		AInteraction(const AVector3f &p, const AVector3f &n, const AVector3f &wo)
 			: p(p), wo(normalize(wo)), n(n) {}
 
+		//Note: the origin of a spawned ray is offset along the normal to the side the ray
+		//      leaves to. The rounding errors of the hit point put it on either side of the
+		//      surface, a ray starting right at it hits its own surface again at random.
+		inline AVector3f offsetRayOrigin(const AVector3f &w) const
+		{
+			if (n == AVector3f(0))
+				return p;
+			AVector3f offset = (aRayOriginEpsilon * (maxComponent(abs(p)) + 1)) * n;
+			return dot(w, n) < 0 ? p - offset : p + offset;
+		}
+
 		inline ARay spawnRay(const AVector3f &d) const
 		{
-			AVector3f o = p;
+			AVector3f o = offsetRayOrigin(d);
 			return ARay(o, d, aInfinity);
 		}
 
 		inline ARay spawnRayTo(const AVector3f &p2) const
 		{
-			AVector3f origin = p;
-			return ARay(origin, p2 - p, 1 - aShadowEpsilon);
+			AVector3f origin = offsetRayOrigin(p2 - p);
+			AVector3f d = p2 - origin;
+			return ARay(origin, d, length(d) * (1 - aShadowEpsilon));
 		}
 
 		inline ARay spawnRayTo(const AInteraction &it) const
 		{
-			AVector3f origin = p;
-			AVector3f target = it.p;
+			AVector3f origin = offsetRayOrigin(it.p - p);
+			AVector3f target = it.offsetRayOrigin(origin - it.p);
 			AVector3f d = target - origin;
-			return ARay(origin, d, 1 - aShadowEpsilon);
+			return ARay(origin, d, length(d) * (1 - aShadowEpsilon));
 		}
 
 	public:
@@ -58,6 +70,7 @@ namespace Aurora
 	public:
 		AVector2f uv;
 		AVector3f dpdu, dpdv;
+		AVector3f ng;			//geometric normal, n is the shading normal of meshes with vertex normals
 
 		ABSDF* bsdf = nullptr;
 
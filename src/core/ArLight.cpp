@@ -10,7 +10,7 @@ namespace Aurora
 
 	ALight::ALight(const APropertyList &props)
 	{
-		m_nSamples = props.getInteger("LightSamples", 1);
+		m_nSamples = glm::max(1, props.getInteger("LightSamples", 1));
 	}
 
 	ALight::ALight(int flags, const ATransform &lightToWorld, int nSamples)
@@ -24,6 +24,76 @@ namespace Aurora
 
 	ASpectrum ALight::Le(const ARay &ray) const { return ASpectrum(0.f); }
 
+	//-------------------------------------------ALightBounds-------------------------------------
+
+	// cos(max(0, theta_a - theta_b)) and sin(max(0, theta_a - theta_b))
+	inline Float cosSubClamped(Float sinTheta_a, Float cosTheta_a, Float sinTheta_b, Float cosTheta_b)
+	{
+		return (cosTheta_a > cosTheta_b) ? 1 : cosTheta_a * cosTheta_b + sinTheta_a * sinTheta_b;
+	}
+
+	inline Float sinSubClamped(Float sinTheta_a, Float cosTheta_a, Float sinTheta_b, Float cosTheta_b)
+	{
+		return (cosTheta_a > cosTheta_b) ? 0 : sinTheta_a * cosTheta_b - cosTheta_a * sinTheta_b;
+	}
+
+	Float ALightBounds::importance(const AVector3f &p, const AVector3f &n) const
+	{
+		// Clamp the squared distance to the centroid so that points inside the bounds don't blow up
+		AVector3f pc = centroid();
+		Float d2 = distanceSquared(p, pc);
+		d2 = glm::max(d2, length(m_bounds.diagonal()) / 2);
+
+		// Angle between the principal normal and the direction to p
+		AVector3f wi = normalize(p - pc);
+		Float cosTheta_w = dot(m_w, wi);
+		if (m_twoSided)
+			cosTheta_w = glm::abs(cosTheta_w);
+		Float sinTheta_w = safeSqrt(1 - cosTheta_w * cosTheta_w);
+
+		// Angle subtended by the bounds as seen from p
+		Float cosTheta_b = boundSubtendedDirections(m_bounds, p).m_cosTheta;
+		Float sinTheta_b = safeSqrt(1 - cosTheta_b * cosTheta_b);
+
+		// Smallest angle between any normal of the cone and any direction towards p
+		Float sinTheta_o = safeSqrt(1 - m_cosTheta_o * m_cosTheta_o);
+		Float cosTheta_x = cosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, m_cosTheta_o);
+		Float sinTheta_x = sinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, m_cosTheta_o);
+		Float cosThetap = cosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+		if (cosThetap <= m_cosTheta_e)
+			return 0;
+
+		Float importance = m_phi * cosThetap / d2;
+
+		// Account for the cosine at the receiving surface
+		if (n != AVector3f(0.f))
+		{
+			Float cosTheta_i = absDot(wi, n);
+			Float sinTheta_i = safeSqrt(1 - cosTheta_i * cosTheta_i);
+			importance *= cosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+		}
+
+		return glm::max(importance, (Float)0);
+	}
+
+	ALightBounds unionBounds(const ALightBounds &a, const ALightBounds &b)
+	{
+		if (a.m_phi == 0)
+			return b;
+		if (b.m_phi == 0)
+			return a;
+
+		ADirectionCone cone = unionCone(ADirectionCone(a.m_w, a.m_cosTheta_o), ADirectionCone(b.m_w, b.m_cosTheta_o));
+		ALightBounds ret;
+		ret.m_bounds = unionBounds(a.m_bounds, b.m_bounds);
+		ret.m_phi = a.m_phi + b.m_phi;
+		ret.m_w = cone.m_w;
+		ret.m_cosTheta_o = cone.m_cosTheta;
+		ret.m_cosTheta_e = glm::min(a.m_cosTheta_e, b.m_cosTheta_e);
+		ret.m_twoSided = a.m_twoSided || b.m_twoSided;
+		return ret;
+	}
+
 	//-------------------------------------------AVisibilityTester-------------------------------------
 
 	bool AVisibilityTester::unoccluded(const AScene &scene) const
@@ -25,6 +25,25 @@ namespace Aurora
 			|| flags & (int)ALightFlags::ALightDeltaDirection;
 	}
 
+	//Note: bounds of the emission of one or more lights, used to estimate how much
+	//      they contribute to a shading point without looking at every light
+	struct ALightBounds
+	{
+		ABounds3f m_bounds;			//spatial bounds of the emitters
+		Float m_phi = 0;			//emitted power
+		AVector3f m_w;				//principal direction of the surface normals
+		Float m_cosTheta_o = 1;		//spread of the surface normals around m_w
+		Float m_cosTheta_e = 0;		//spread of the emission around a surface normal
+		bool m_twoSided = false;
+
+		AVector3f centroid() const { return (m_bounds.m_pMin + m_bounds.m_pMax) / (Float)2; }
+
+		// Conservative estimate of the contribution to point p with normal n (zero if unknown)
+		Float importance(const AVector3f &p, const AVector3f &n) const;
+	};
+
+	ALightBounds unionBounds(const ALightBounds &a, const ALightBounds &b);
+
 	class ALight : public AObject
 	{
 	public:
@@ -37,6 +56,9 @@ namespace Aurora
 
 		virtual ASpectrum power() const = 0;
 
+		//Note: returns false for lights that can't be bounded, e.g. infinite lights
+		virtual bool bounds(ALightBounds &bounds) const { return false; }
+
 		virtual void preprocess(const AScene &scene) {}
 
 		virtual ASpectrum sample_Li(const AInteraction &ref, const AVector2f &u,
@@ -1,44 +1,604 @@
 #include "ArLightDistrib.h"
 
 #include "ArScene.h"
+#include "ArRng.h"
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
 
 namespace Aurora
 {
 	std::unique_ptr<ALightDistribution> createLightSampleDistribution(
 		const std::string &name, const AScene &scene) 
 	{
-		//if (name == "uniform" || scene.m_lights.size() == 1)
+		if (name == "uniform" || scene.m_lights.size() == 1)
 		{
 			return std::unique_ptr<ALightDistribution>{
 				new AUniformLightDistribution(scene)};
 		}
-		//else if (name == "power")
-		//{
-		//	return std::unique_ptr<ALightDistribution>{
-		//		new APowerLightDistribution(scene)};
-		//}
-		//else if (name == "spatial")
-		//{
-		//	return std::unique_ptr<ALightDistribution>{
-		//		new ASpatialLightDistribution(scene)};
-		//}
-		//else 
-		//{
-		//	Error(
-		//		"Light sample distribution type \"%s\" unknown. Using \"spatial\".",
-		//		name.c_str());
-		//	return std::unique_ptr<LightDistribution>{new SpatialLightDistribution(scene)};
-		//}
-	}
-
-	AUniformLightDistribution::AUniformLightDistribution(const AScene &scene) 
+		else if (name == "power")
+		{
+			return std::unique_ptr<ALightDistribution>{
+				new APowerLightDistribution(scene)};
+		}
+		else if (name == "spatial")
+		{
+			return std::unique_ptr<ALightDistribution>{
+				new ASpatialLightDistribution(scene)};
+		}
+		else if (name == "bvh")
+		{
+			return std::unique_ptr<ALightDistribution>{
+				new ALightBVHDistribution(scene)};
+		}
+		else 
+		{
+			LOG(WARNING) << "Light sample distribution type \"" << name << "\" unknown. Using \"bvh\".";
+			return std::unique_ptr<ALightDistribution>{
+				new ALightBVHDistribution(scene)};
+		}
+	}
+
+	//-------------------------------------------ALightDistribution-------------------------------------
+
+	ALightDistribution::ALightDistribution(const AScene &scene)
+	{
+		for (size_t i = 0; i < scene.m_lights.size(); ++i)
+		{
+			m_lightToIndex[scene.m_lights[i].get()] = (int)i;
+		}
+	}
+
+	int ALightDistribution::lightIndex(const ALight *light) const
+	{
+		auto it = m_lightToIndex.find(light);
+		return (it == m_lightToIndex.end()) ? -1 : it->second;
+	}
+
+	//-------------------------------------------AUniformLightDistribution-------------------------------------
+
+	AUniformLightDistribution::AUniformLightDistribution(const AScene &scene) : ALightDistribution(scene)
 	{
 		std::vector<Float> prob(scene.m_lights.size(), Float(1));
-		distrib.reset(new ADistribution1D(&prob[0], int(prob.size())));
+		distrib.reset(new ADistribution1D(prob.data(), int(prob.size())));
+	}
+
+	int AUniformLightDistribution::sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const
+	{
+		if (distrib->count() == 0)
+		{
+			pmf = 0;
+			return -1;
+		}
+		return distrib->sampleDiscrete(u, &pmf);
+	}
+
+	Float AUniformLightDistribution::pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const
+	{
+		return (lightIndex >= 0 && lightIndex < distrib->count()) ? distrib->discretePDF(lightIndex) : 0;
+	}
+
+	//-------------------------------------------APowerLightDistribution-------------------------------------
+
+	static std::unique_ptr<ADistribution1D> computeLightPowerDistribution(const AScene &scene)
+	{
+		if (scene.m_lights.empty())
+			return nullptr;
+		std::vector<Float> lightPower;
+		for (const auto &light : scene.m_lights)
+			lightPower.push_back(light->power().y());
+		return std::unique_ptr<ADistribution1D>(new ADistribution1D(lightPower.data(), (int)lightPower.size()));
+	}
+
+	APowerLightDistribution::APowerLightDistribution(const AScene &scene)
+		: ALightDistribution(scene), distrib(computeLightPowerDistribution(scene)) {}
+
+	int APowerLightDistribution::sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const
+	{
+		if (distrib == nullptr)
+		{
+			pmf = 0;
+			return -1;
+		}
+		return distrib->sampleDiscrete(u, &pmf);
+	}
+
+	Float APowerLightDistribution::pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const
+	{
+		return (distrib != nullptr && lightIndex >= 0 && lightIndex < distrib->count()) ? 
+			distrib->discretePDF(lightIndex) : 0;
+	}
+
+	//-------------------------------------------ASpatialLightDistribution-------------------------------------
+
+	// Voxels are packed with 20 bits per coordinate, the all-ones value marks an empty hash entry
+	static const uint64_t invalidPackedPos = 0xffffffffffffffff;
+
+	ASpatialLightDistribution::ASpatialLightDistribution(const AScene &scene, int maxVoxels)
+		: ALightDistribution(scene), m_scene(scene), m_powerDistrib(computeLightPowerDistribution(scene))
+	{
+		// Compute the number of voxels so that the widest scene bounding box
+		// dimension has maxVoxels voxels and the other dimensions have a number
+		// of voxels so that voxels are roughly cube shaped.
+		ABounds3f b = scene.worldBound();
+		AVector3f diag = b.diagonal();
+		Float bmax = diag[b.maximumExtent()];
+		for (int i = 0; i < 3; ++i) 
+		{
+			m_nVoxels[i] = glm::max(1, int(glm::round(diag[i] / bmax * maxVoxels)));
+			// In the Lookup() method, we require that 20 or fewer bits be
+			// sufficient to represent each coordinate value. It's fairly hard
+			// to imagine that this would ever be a problem.
+			CHECK_LT(m_nVoxels[i], 1 << 20);
+		}
+
+		m_hashTableSize = 4 * m_nVoxels[0] * m_nVoxels[1] * m_nVoxels[2];
+		m_hashTable.reset(new AHashEntry[m_hashTableSize]);
+		for (size_t i = 0; i < m_hashTableSize; ++i) 
+		{
+			m_hashTable[i].m_packedPos.store(invalidPackedPos);
+			m_hashTable[i].m_distribution.store(nullptr);
+		}
+
+		LOG(INFO) << "SpatialLightDistribution: scene bounds " << b << ", voxel res (" << 
+			m_nVoxels[0] << ", " << m_nVoxels[1] << ", " << m_nVoxels[2] << ")";
+	}
+
+	ASpatialLightDistribution::~ASpatialLightDistribution() 
+	{
+		// Gather statistics about how well the computed distributions are and
+		// then release the distributions, the power distribution is shared by many voxels
+		size_t nEntries = 0;
+		for (size_t i = 0; i < m_hashTableSize; ++i) 
+		{
+			AHashEntry &entry = m_hashTable[i];
+			const ADistribution1D *distrib = entry.m_distribution.load();
+			if (distrib != nullptr)
+			{
+				++nEntries;
+				if (distrib != m_powerDistrib.get())
+					delete distrib;
+			}
+		}
+		LOG(INFO) << "SpatialLightDistribution: " << nEntries << " of " << m_hashTableSize 
+			<< " hash table entries were used";
+	}
+
+	const ADistribution1D *ASpatialLightDistribution::lookup(const AVector3f &p) const 
+	{
+		// First, compute integer voxel coordinates for the given point |p|
+		// with respect to the overall voxel grid.
+		AVector3f offset = m_scene.worldBound().offset(p);  // offset in [0,1].
+		AVector3i pi;
+		for (int i = 0; i < 3; ++i)
+		{
+			// The clamp should almost never be necessary, but is there to be
+			// robust to computed intersection points being slightly outside
+			// the scene bounds due to floating-point roundoff error.
+			pi[i] = glm::clamp(int(offset[i] * m_nVoxels[i]), 0, m_nVoxels[i] - 1);
+		}
+
+		// Pack the 3D integer voxel coordinates into a single 64-bit value.
+		uint64_t packedPos = (uint64_t(pi[0]) << 40) | (uint64_t(pi[1]) << 20) | pi[2];
+		CHECK_NE(packedPos, invalidPackedPos);
+
+		// Compute a hash value from the packed voxel coordinates.  We could
+		// just take packedPos mod the hash table size, but since packedPos
+		// isn't necessarily well distributed on its own, it's worthwhile to do
+		// a little work to make sure that its bits values are individually
+		// fairly random. For details of and motivation for the following, see:
+		// http://zimbry.blogspot.ch/2011/09/better-bit-mixing-improving-on.html
+		uint64_t hash = packedPos;
+		hash ^= (hash >> 31);
+		hash *= 0x7fb5d329728ea185;
+		hash ^= (hash >> 27);
+		hash *= 0x81dadef4bc2dd44d;
+		hash ^= (hash >> 33);
+		hash %= m_hashTableSize;
+		CHECK_GE(hash, 0u);
+
+		// Now, see if the hash table already has an entry for the voxel. We'll
+		// use quadratic probing when the hash table entry is already used for
+		// another value; step stores the square root of the probe step.
+		int step = 1;
+		while (true) 
+		{
+			AHashEntry &entry = m_hashTable[hash];
+			// Does the hash table entry at offset |hash| match the current point?
+			uint64_t entryPackedPos = entry.m_packedPos.load(std::memory_order_acquire);
+			if (entryPackedPos == packedPos) 
+			{
+				// Yes! Most of the time, there should already by a light
+				// sampling distribution available.
+				const ADistribution1D *dist = entry.m_distribution.load(std::memory_order_acquire);
+				if (dist == nullptr) 
+				{
+					// Rarely, another thread will have already done a lookup
+					// at this point, found that there isn't a sampling
+					// distribution, and will already be computing the
+					// distribution for the point.  In this case, we spin until
+					// the sampling distribution is ready.  We assume that this
+					// is a rare case, so don't do anything more sophisticated
+					// than spinning.
+					while ((dist = entry.m_distribution.load(std::memory_order_acquire)) == nullptr)
+					{
+						// spin :-(. If we were fancy, we'd have any threads
+						// that hit this instead help out with computing the
+						// distribution for the voxel...
+						std::this_thread::yield();
+					}
+				}
+				// We have a valid sampling distribution.
+				return dist;
+			}
+			else if (entryPackedPos != invalidPackedPos) 
+			{
+				// The hash table entry we're checking has already been
+				// allocated for another voxel. Advance to the next entry with
+				// quadratic probing.
+				hash += step * step;
+				if (hash >= m_hashTableSize)
+					hash %= m_hashTableSize;
+				++step;
+			}
+			else 
+			{
+				// We have found an invalid entry. (Though this may have
+				// changed by the time we try to allocate it below.)
+
+				// Opportunistically try to allocate the entry; we do this with a CAS,
+				// since another thread may be trying to allocate the same entry.
+				uint64_t invalid = invalidPackedPos;
+				if (entry.m_packedPos.compare_exchange_weak(invalid, packedPos)) 
+				{
+					// Success; we've claimed this position for this voxel's
+					// distribution. Now compute the sampling distribution and
+					// add it to the hash table. As long as packedPos has been
+					// set but the entry's distribution pointer is nullptr, any
+					// other threads looking up the distribution for this voxel
+					// will spin wait until the distribution pointer is
+					// written.
+					const ADistribution1D *dist = computeDistribution(pi);
+					entry.m_distribution.store(dist, std::memory_order_release);
+					return dist;
+				}
+			}
+		}
+	}
+
+	const ADistribution1D *ASpatialLightDistribution::computeDistribution(const AVector3i &pi) const 
+	{
+		// Compute the world-space bounding box of the voxel corresponding to |pi|.
+		AVector3f p0(Float(pi[0]) / Float(m_nVoxels[0]), Float(pi[1]) / Float(m_nVoxels[1]),
+			Float(pi[2]) / Float(m_nVoxels[2]));
+		AVector3f p1(Float(pi[0] + 1) / Float(m_nVoxels[0]), Float(pi[1] + 1) / Float(m_nVoxels[1]),
+			Float(pi[2] + 1) / Float(m_nVoxels[2]));
+		ABounds3f voxelBounds(m_scene.worldBound().lerp(p0), m_scene.worldBound().lerp(p1));
+
+		// Compute the sampling distribution. Sample a number of points inside
+		// voxelBounds using stratified samples and compute the average value
+		// of the irradiance for each light source. Then compute a sampling
+		// distribution that samples lights proportional to that value.
+		//Note: the random numbers are seeded by the voxel so that the result doesn't
+		//      depend on which thread happens to compute it
+		ARng rng((uint64_t(pi[0]) << 40) | (uint64_t(pi[1]) << 20) | pi[2]);
+		const int nSamples = 128;
+		std::vector<Float> lightContrib(m_scene.m_lights.size(), Float(0));
+
+		//Note: an occluded light still gets a tenth of its unoccluded weight. Visibility from a
+		//      few points isn't reliable for the whole voxel, and the points may lie inside of
+		//      some geometry where nothing is visible. Only every visibilityStride-th point traces
+		//      shadow rays, the fraction of contribution found visible then scales each light.
+		const int visibilityStride = 8;
+		const Float occludedWeight = 0.1f;
+		std::vector<ARay> shadowRays;
+		std::vector<std::pair<int, Float>> shadowRayContribs;
+		for (int i = 0; i < nSamples; ++i) 
+		{
+			AVector3f po = voxelBounds.lerp(AVector3f(rng.uniformFloat(), rng.uniformFloat(), rng.uniformFloat()));
+			AInteraction intr(po, AVector3f(0.f), AVector3f(1, 0, 0));
+
+			// Use the next two random numbers to sample a point on the light source.
+			AVector2f u(rng.uniformFloat(), rng.uniformFloat());
+			for (size_t j = 0; j < m_scene.m_lights.size(); ++j) 
+			{
+				Float pdf;
+				AVector3f wi;
+				AVisibilityTester vis;
+				ASpectrum Li = m_scene.m_lights[j]->sample_Li(intr, u, wi, pdf, vis);
+				if (pdf > 0) 
+				{
+					Float contrib = Li.y() / pdf;
+					lightContrib[j] += contrib;
+					if (i % visibilityStride == 0 && contrib > 0)
+					{
+						shadowRays.push_back(vis.P0().spawnRayTo(vis.P1()));
+						shadowRayContribs.push_back(std::make_pair(int(j), contrib));
+					}
+				}
+			}
+		}
+
+		if (!shadowRays.empty())
+		{
+			std::unique_ptr<bool[]> occluded(new bool[shadowRays.size()]);
+			m_scene.occluded(shadowRays.data(), int(shadowRays.size()), occluded.get());
+
+			std::vector<Float> testedContrib(lightContrib.size(), Float(0));
+			std::vector<Float> visibleContrib(lightContrib.size(), Float(0));
+			for (size_t k = 0; k < shadowRays.size(); ++k)
+			{
+				const auto &rayContrib = shadowRayContribs[k];
+				testedContrib[rayContrib.first] += rayContrib.second;
+				if (!occluded[k])
+					visibleContrib[rayContrib.first] += rayContrib.second;
+			}
+			for (size_t j = 0; j < lightContrib.size(); ++j)
+			{
+				if (testedContrib[j] > 0)
+					lightContrib[j] *= occludedWeight + (1 - occludedWeight) * visibleContrib[j] / testedContrib[j];
+			}
+		}
+
+		// Voxels that no light reaches are sampled by light power
+		Float sumContrib = std::accumulate(lightContrib.begin(), lightContrib.end(), Float(0));
+		if (sumContrib == 0)
+			return m_powerDistrib.get();
+
+		// We don't want to leave any lights with a zero probability; it's
+		// possible that a light contributes to points in the voxel even though
+		// we didn't find such a point when sampling above.  Therefore, compute
+		// a minimum (small) weight and ensure that all lights are given at
+		// least the corresponding probability.
+		Float avgContrib = sumContrib / (nSamples * lightContrib.size());
+		Float minContrib = Float(.001) * avgContrib;
+		for (size_t i = 0; i < lightContrib.size(); ++i) 
+			lightContrib[i] = glm::max(lightContrib[i], minContrib);
+
+		// Compute a sampling distribution from the accumulated contributions.
+		return new ADistribution1D(&lightContrib[0], int(lightContrib.size()));
+	}
+
+	int ASpatialLightDistribution::sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const
+	{
+		if (m_powerDistrib == nullptr)
+		{
+			pmf = 0;
+			return -1;
+		}
+		return lookup(p)->sampleDiscrete(u, &pmf);
+	}
+
+	Float ASpatialLightDistribution::pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const
+	{
+		if (m_powerDistrib == nullptr || lightIndex < 0 || lightIndex >= m_powerDistrib->count())
+			return 0;
+		return lookup(p)->discretePDF(lightIndex);
+	}
+
+	//-------------------------------------------ALightBVHDistribution-------------------------------------
+
+	// Cost of a node for the split heuristic: its power times the solid angle of its
+	// emission directions and its surface area, penalizing thin bounds along the split axis
+	static Float evaluateCost(const ALightBounds &b, const ABounds3f &bounds, int dim)
+	{
+		Float theta_o = safeAcos(b.m_cosTheta_o), theta_e = safeAcos(b.m_cosTheta_e);
+		Float theta_w = glm::min(theta_o + theta_e, aPi);
+		Float sinTheta_o = safeSqrt(1 - b.m_cosTheta_o * b.m_cosTheta_o);
+		Float M_omega = 2 * aPi * (1 - b.m_cosTheta_o) + aPiOver2 * (2 * theta_w * sinTheta_o
+			- glm::cos(theta_o - 2 * theta_w) - 2 * theta_o * sinTheta_o + b.m_cosTheta_o);
+		Float Kr = maxComponent(bounds.diagonal()) / bounds.diagonal()[dim];
+		return b.m_phi * M_omega * Kr * b.m_bounds.surfaceArea();
+	}
+
+	ALightBVHDistribution::ALightBVHDistribution(const AScene &scene) : ALightDistribution(scene)
+	{
+		std::vector<std::pair<int, ALightBounds>> bvhLights;
+		for (size_t i = 0; i < scene.m_lights.size(); ++i)
+		{
+			ALightBounds lightBounds;
+			if (!scene.m_lights[i]->bounds(lightBounds))
+			{
+				m_infiniteLights.push_back((int)i);
+			}
+			else if (lightBounds.m_phi > 0)
+			{
+				bvhLights.push_back(std::make_pair((int)i, lightBounds));
+			}
+		}
+
+		if (!bvhLights.empty())
+		{
+			buildBVH(bvhLights, 0, (int)bvhLights.size(), 0, 0);
+		}
+
+		LOG(INFO) << "Built light BVH with " << m_nodes.size() << " nodes over " << bvhLights.size()
+			<< " lights, " << m_infiniteLights.size() << " infinite lights";
+	}
+
+	int ALightBVHDistribution::buildBVH(std::vector<std::pair<int, ALightBounds>> &lights, int start, int end,
+		uint64_t bitTrail, int depth)
+	{
+		DCHECK_LT(start, end);
+		// Create a leaf for a single light
+		if (end - start == 1)
+		{
+			int nodeIndex = (int)m_nodes.size();
+			m_nodes.push_back({ lights[start].second, lights[start].first, true });
+			m_lightToBitTrail[lights[start].first] = bitTrail;
+			return nodeIndex;
+		}
+
+		// Compute the bounds of all the lights and their centroids
+		ABounds3f bounds, centroidBounds;
+		for (int i = start; i < end; ++i)
+		{
+			const ALightBounds &lb = lights[i].second;
+			bounds = unionBounds(bounds, lb.m_bounds);
+			centroidBounds = unionBounds(centroidBounds, lb.centroid());
+		}
+
+		// Find the cheapest split among the bucket boundaries of all three axes
+		constexpr int nBuckets = 12;
+		Float minCost = aInfinity;
+		int minCostSplitBucket = -1, minCostSplitDim = -1;
+		auto bucketIndex = [&](const ALightBounds &lb, int dim) -> int
+		{
+			int b = (int)(nBuckets * centroidBounds.offset(lb.centroid())[dim]);
+			return glm::clamp(b, 0, nBuckets - 1);
+		};
+		for (int dim = 0; dim < 3; ++dim)
+		{
+			if (centroidBounds.m_pMax[dim] == centroidBounds.m_pMin[dim])
+				continue;
+
+			ALightBounds bucketLightBounds[nBuckets];
+			for (int i = start; i < end; ++i)
+			{
+				int b = bucketIndex(lights[i].second, dim);
+				bucketLightBounds[b] = unionBounds(bucketLightBounds[b], lights[i].second);
+			}
+
+			for (int i = 0; i < nBuckets - 1; ++i)
+			{
+				ALightBounds b0, b1;
+				for (int j = 0; j <= i; ++j)
+					b0 = unionBounds(b0, bucketLightBounds[j]);
+				for (int j = i + 1; j < nBuckets; ++j)
+					b1 = unionBounds(b1, bucketLightBounds[j]);
+
+				// Note: splits with an empty side cost nothing and are skipped
+				Float cost = evaluateCost(b0, bounds, dim) + evaluateCost(b1, bounds, dim);
+				if (cost > 0 && cost < minCost)
+				{
+					minCost = cost;
+					minCostSplitBucket = i;
+					minCostSplitDim = dim;
+				}
+			}
+		}
+
+		// Partition the lights, fall back to halving them if all centroids coincide
+		int mid = (start + end) / 2;
+		if (minCostSplitDim != -1)
+		{
+			auto pmid = std::partition(lights.begin() + start, lights.begin() + end,
+				[&](const std::pair<int, ALightBounds> &l) -> bool
+			{
+				return bucketIndex(l.second, minCostSplitDim) <= minCostSplitBucket;
+			});
+			int splitMid = (int)(pmid - lights.begin());
+			if (splitMid != start && splitMid != end)
+				mid = splitMid;
+		}
+
+		// The first child directly follows its parent, the second child is referenced by index
+		int nodeIndex = (int)m_nodes.size();
+		m_nodes.push_back({ ALightBounds(), -1, false });
+		CHECK_LT(depth, 64);
+		int child0 = buildBVH(lights, start, mid, bitTrail, depth + 1);
+		DCHECK_EQ(child0, nodeIndex + 1);
+		int child1 = buildBVH(lights, mid, end, bitTrail | (1ull << depth), depth + 1);
+
+		m_nodes[nodeIndex].m_lightBounds = unionBounds(m_nodes[child0].m_lightBounds, m_nodes[child1].m_lightBounds);
+		m_nodes[nodeIndex].m_childOrLightIndex = child1;
+		return nodeIndex;
 	}
 
-	const ADistribution1D *AUniformLightDistribution::lookup(const AVector3f &p) const 
+	int ALightBVHDistribution::sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const
 	{
-		return distrib.get();
+		// Choose between the infinite lights and the tree
+		const int nInfinite = (int)m_infiniteLights.size();
+		Float pInfinite = Float(nInfinite) / (nInfinite + (m_nodes.empty() ? 0 : 1));
+		if (u < pInfinite)
+		{
+			int index = glm::min((int)(u / pInfinite * nInfinite), nInfinite - 1);
+			pmf = pInfinite / nInfinite;
+			return m_infiniteLights[index];
+		}
+
+		if (m_nodes.empty())
+		{
+			pmf = 0;
+			return -1;
+		}
+
+		// Walk down the tree choosing children by their importance, reusing the remapped sample
+		u = glm::min((u - pInfinite) / (1 - pInfinite), aOneMinusEpsilon);
+		int nodeIndex = 0;
+		pmf = 1 - pInfinite;
+		while (true)
+		{
+			const ALightBVHNode &node = m_nodes[nodeIndex];
+			if (node.m_isLeaf)
+			{
+				if (nodeIndex > 0 || node.m_lightBounds.importance(p, n) > 0)
+					return node.m_childOrLightIndex;
+				pmf = 0;
+				return -1;
+			}
+
+			Float ci[2] = {
+				m_nodes[nodeIndex + 1].m_lightBounds.importance(p, n),
+				m_nodes[node.m_childOrLightIndex].m_lightBounds.importance(p, n) };
+			if (ci[0] == 0 && ci[1] == 0)
+			{
+				pmf = 0;
+				return -1;
+			}
+
+			Float nodePmf = ci[0] / (ci[0] + ci[1]);
+			if (u < nodePmf)
+			{
+				pmf *= nodePmf;
+				u = glm::min(u / nodePmf, aOneMinusEpsilon);
+				nodeIndex = nodeIndex + 1;
+			}
+			else
+			{
+				pmf *= 1 - nodePmf;
+				u = glm::min((u - nodePmf) / (1 - nodePmf), aOneMinusEpsilon);
+				nodeIndex = node.m_childOrLightIndex;
+			}
+		}
+	}
+
+	Float ALightBVHDistribution::pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const
+	{
+		const int nInfinite = (int)m_infiniteLights.size();
+		Float pInfinite = Float(nInfinite) / (nInfinite + (m_nodes.empty() ? 0 : 1));
+		if (std::find(m_infiniteLights.begin(), m_infiniteLights.end(), lightIndex) != m_infiniteLights.end())
+			return pInfinite / nInfinite;
+
+		// Lights that emit nothing aren't part of the tree
+		auto it = m_lightToBitTrail.find(lightIndex);
+		if (it == m_lightToBitTrail.end())
+			return 0;
+
+		// Follow the path to the light's leaf and multiply the probabilities of its nodes
+		uint64_t bitTrail = it->second;
+		int nodeIndex = 0;
+		Float pmf = 1 - pInfinite;
+		while (true)
+		{
+			const ALightBVHNode &node = m_nodes[nodeIndex];
+			if (node.m_isLeaf)
+			{
+				DCHECK_EQ(node.m_childOrLightIndex, lightIndex);
+				return (nodeIndex > 0 || node.m_lightBounds.importance(p, n) > 0) ? pmf : 0;
+			}
+
+			int child[2] = { nodeIndex + 1, node.m_childOrLightIndex };
+			Float ci[2] = {
+				m_nodes[child[0]].m_lightBounds.importance(p, n),
+				m_nodes[child[1]].m_lightBounds.importance(p, n) };
+			if (ci[bitTrail & 1] == 0)
+				return 0;
+
+			pmf *= ci[bitTrail & 1] / (ci[0] + ci[1]);
+			nodeIndex = child[bitTrail & 1];
+			bitTrail >>= 1;
+		}
 	}
 }
\ No newline at end of file
@@ -3,8 +3,11 @@
 
 #include "ArAurora.h"
 #include "ArMathUtils.h"
+#include "ArLight.h"
 
 #include <vector>
+#include <unordered_map>
+#include <atomic>
 
 namespace Aurora
 {
@@ -93,17 +96,76 @@ namespace Aurora
 		Float funcInt;
 	};
 
+	//Note: piecewise constant distribution over [0,1]^2 of the nu x nv values of |func|, stored
+	//      row by row. v is sampled from the marginal of the rows and u from the row of v.
+	class ADistribution2D
+	{
+	public:
+
+		ADistribution2D(const Float *func, int nu, int nv)
+		{
+			pConditionalV.reserve(nv);
+			for (int v = 0; v < nv; ++v)
+			{
+				// Compute conditional sampling distribution for $\tilde{v}$
+				pConditionalV.emplace_back(new ADistribution1D(&func[v * nu], nu));
+			}
+
+			// Compute marginal sampling distribution $p[\tilde{v}]$
+			std::vector<Float> marginalFunc;
+			marginalFunc.reserve(nv);
+			for (int v = 0; v < nv; ++v)
+				marginalFunc.push_back(pConditionalV[v]->funcInt);
+			pMarginal.reset(new ADistribution1D(&marginalFunc[0], nv));
+		}
+
+		AVector2f sampleContinuous(const AVector2f &u, Float *pdf) const
+		{
+			Float pdfs[2];
+			int v;
+			Float d1 = pMarginal->sampleContinuous(u[1], &pdfs[1], &v);
+			Float d0 = pConditionalV[v]->sampleContinuous(u[0], &pdfs[0]);
+			*pdf = pdfs[0] * pdfs[1];
+			return AVector2f(d0, d1);
+		}
+
+		Float pdf(const AVector2f &p) const
+		{
+			int iu = glm::clamp(int(p[0] * pConditionalV[0]->count()), 0, pConditionalV[0]->count() - 1);
+			int iv = glm::clamp(int(p[1] * pMarginal->count()), 0, pMarginal->count() - 1);
+			return pConditionalV[iv]->func[iu] / pMarginal->funcInt;
+		}
+
+		// Integral of the function over [0,1]^2
+		Float integral() const { return pMarginal->funcInt; }
+
+	private:
+		std::vector<std::unique_ptr<ADistribution1D>> pConditionalV;
+		std::unique_ptr<ADistribution1D> pMarginal;
+	};
+
 	// LightDistribution defines a general interface for classes that provide
 	// probability distributions for sampling light sources at a given point in
 	// space.
+	//Note: lights are identified by their index into scene.m_lights, the normal |n| of
+	//      the receiving point may be zero if it is unknown
 	class ALightDistribution 
 	{
 	public:
+		ALightDistribution(const AScene &scene);
 		virtual ~ALightDistribution() = default;
 
-		// Given a point |p| in space, this method returns a (hopefully
-		// effective) sampling distribution for light sources at that point.
-		virtual const ADistribution1D *lookup(const AVector3f &p) const = 0;
+		// Choose a light for the point |p| with normal |n|, returns -1 with pmf = 0 if no light can contribute
+		virtual int sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const = 0;
+
+		// Probability that sample() chooses the light |lightIndex| for the point |p| with normal |n|
+		virtual Float pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const = 0;
+
+		// Index of |light| into scene.m_lights, -1 for anything that isn't a light of the scene
+		int lightIndex(const ALight *light) const;
+
+	private:
+		std::unordered_map<const ALight*, int> m_lightToIndex;
 	};
 
 	// The simplest possible implementation of LightDistribution: this returns
@@ -119,12 +181,109 @@ namespace Aurora
 		
 		AUniformLightDistribution(const AScene &scene);
 
-		virtual const ADistribution1D *lookup(const AVector3f &p) const override;
+		virtual int sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const override;
+		virtual Float pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const override;
 
 	private:
 		std::unique_ptr<ADistribution1D> distrib;
 	};
 
+	// PowerLightDistribution returns a distribution with sampling probability
+	// proportional to the total emitted power for each light. (It also ignores
+	// the provided point |p|.)  This approach works well for scenes where
+	// there the most powerful lights are also the most important contributors
+	// to lighting in the scene, but doesn't do well if there are many lights
+	// and if different lights are relatively important in some areas of the
+	// scene and unimportant in others. (This was the default sampling method
+	// used for the BDPT integrator and MLT integrator in the printed book,
+	// though also without the PowerLightDistribution class.)
+	class APowerLightDistribution : public ALightDistribution 
+	{
+	public:
+
+		APowerLightDistribution(const AScene &scene);
+
+		virtual int sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const override;
+		virtual Float pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const override;
+
+	private:
+		std::unique_ptr<ADistribution1D> distrib;
+	};
+
+	// A spatially-varying light distribution that adjusts the probability of
+	// sampling a light source based on an estimate of its contribution to a
+	// region of space.  A fixed voxel grid is imposed over the scene bounds
+	// and a sampling distribution is computed as needed for each voxel.
+	//Note: the distributions are kept in a hash table with open addressing that is filled lazily
+	//      and without locks, voxels that no light reaches fall back to the power distribution
+	class ASpatialLightDistribution : public ALightDistribution 
+	{
+	public:
+
+		ASpatialLightDistribution(const AScene &scene, int maxVoxels = 64);
+		~ASpatialLightDistribution();
+
+		virtual int sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const override;
+		virtual Float pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const override;
+
+	private:
+		// Compute the sampling distribution for the voxel with integer
+		// coordiantes given by "pi".
+		const ADistribution1D *computeDistribution(const AVector3i &pi) const;
+
+		// Find the sampling distribution of the voxel containing |p|, computing it on first use
+		const ADistribution1D *lookup(const AVector3f &p) const;
+
+		const AScene &m_scene;
+		int m_nVoxels[3];
+		std::unique_ptr<ADistribution1D> m_powerDistrib;
+
+		// The hash table is a fixed number of HashEntry structs (where we
+		// allocate more than enough entries in the SpatialLightDistribution
+		// constructor). During rendering, the table is allocated without
+		// locks, using atomic operations. (See the Lookup() method
+		// implementation for details.)
+		struct AHashEntry 
+		{
+			std::atomic<uint64_t> m_packedPos;
+			std::atomic<const ADistribution1D *> m_distribution;
+		};
+		mutable std::unique_ptr<AHashEntry[]> m_hashTable;
+		size_t m_hashTableSize;
+	};
+
+	//Note: a bounding volume hierarchy over the lights whose nodes store the spatial bounds, the
+	//      power and the cone of emission directions of their lights. A light is chosen by walking
+	//      down from the root and picking a child by its estimated importance to the receiving
+	//      point, which takes logarithmic time in the number of lights. Lights without bounds
+	//      (infinite lights) are chosen uniformly with the same probability as the whole tree.
+	class ALightBVHDistribution : public ALightDistribution
+	{
+	public:
+
+		ALightBVHDistribution(const AScene &scene);
+
+		virtual int sample(Float u, const AVector3f &p, const AVector3f &n, Float &pmf) const override;
+		virtual Float pmf(const AVector3f &p, const AVector3f &n, int lightIndex) const override;
+
+	private:
+		struct ALightBVHNode
+		{
+			ALightBounds m_lightBounds;
+			int m_childOrLightIndex;	//second child of an interior node, light of a leaf
+			bool m_isLeaf;
+		};
+
+		// Build the subtree over lights[start, end) and return the index of its root node,
+		// |bitTrail| records the path from the root with one bit per level
+		int buildBVH(std::vector<std::pair<int, ALightBounds>> &lights, int start, int end,
+			uint64_t bitTrail, int depth);
+
+		std::vector<ALightBVHNode> m_nodes;
+		std::vector<int> m_infiniteLights;
+		std::unordered_map<int, uint64_t> m_lightToBitTrail;	//path from the root to the leaf of every light
+	};
+
 	std::unique_ptr<ALightDistribution> createLightSampleDistribution(
 		const std::string &name, const AScene &scene);
 
@@ -0,0 +1,240 @@
+#include "ArLiveFramebuffer.h"
+
+#include <chrono>
+#include <cstring>
+
+#ifdef AURORA_WINDOWS_OS
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Aurora
+{
+	static const char aLiveFramebufferMagic[4] = { 'A', 'L', 'F', 'B' };
+	static const uint32_t aLiveFramebufferVersion = 1;
+
+	//Note: map |filename| into memory. A writable mapping creates the file and grows it to |size|,
+	//      a read-only mapping returns the size of the file in |size|. The file never shrinks,
+	//      a viewer that still maps the pages past the new end would crash on its next read.
+	static void *mapFile(const std::string &filename, size_t &size, bool writable, void *&file, void *&mapping)
+	{
+#ifdef AURORA_WINDOWS_OS
+		HANDLE handle = CreateFileA(filename.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+			FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (handle == INVALID_HANDLE_VALUE)
+			return nullptr;
+		if (!writable)
+		{
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(handle, &fileSize))
+			{
+				CloseHandle(handle);
+				return nullptr;
+			}
+			size = (size_t)fileSize.QuadPart;
+		}
+		HANDLE fileMapping = CreateFileMappingA(handle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+			(DWORD)((uint64_t)size >> 32), (DWORD)((uint64_t)size & 0xffffffff), nullptr);
+		void *ptr = fileMapping ? MapViewOfFile(fileMapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size) : nullptr;
+		if (!ptr)
+		{
+			if (fileMapping)
+				CloseHandle(fileMapping);
+			CloseHandle(handle);
+			return nullptr;
+		}
+		file = handle;
+		mapping = fileMapping;
+		return ptr;
+#else
+		int fd = open(filename.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+		if (fd < 0)
+			return nullptr;
+		bool sized = true;
+		if (writable)
+		{
+			struct stat st;
+			sized = fstat(fd, &st) == 0 && ((size_t)st.st_size >= size || ftruncate(fd, (off_t)size) == 0);
+		}
+		else
+		{
+			struct stat st;
+			sized = fstat(fd, &st) == 0;
+			size = sized ? (size_t)st.st_size : 0;
+		}
+		void *ptr = (sized && size > 0) ? mmap(nullptr, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+			MAP_SHARED, fd, 0) : MAP_FAILED;
+		// The mapping stays valid after the file is closed
+		close(fd);
+		return ptr == MAP_FAILED ? nullptr : ptr;
+#endif
+	}
+
+	static void unmapFile(const void *ptr, size_t size, void *file, void *mapping)
+	{
+		if (!ptr)
+			return;
+#ifdef AURORA_WINDOWS_OS
+		UnmapViewOfFile(ptr);
+		CloseHandle(mapping);
+		CloseHandle(file);
+#else
+		munmap(const_cast<void*>(ptr), size);
+#endif
+	}
+
+	//-------------------------------------------ALiveFramebuffer-------------------------------------
+
+	ALiveFramebuffer::ALiveFramebuffer(const std::string &filename, int width, int height, AFillFunction fill, int intervalMS)
+		: m_fill(fill), m_frame(3 * (size_t)width * height), m_intervalMS(intervalMS), m_dirty(false)
+	{
+		m_mappingSize = sizeof(ALiveFramebufferHeader) + m_frame.size() * sizeof(float);
+		void *ptr = mapFile(filename, m_mappingSize, true, m_file, m_mapping);
+		if (!ptr)
+		{
+			LOG(ERROR) << "Failed to map the live framebuffer " << filename;
+			return;
+		}
+
+		m_header = static_cast<ALiveFramebufferHeader*>(ptr);
+		m_pixels = reinterpret_cast<float*>(m_header + 1);
+		if (!m_header->sequence.is_lock_free())
+		{
+			LOG(WARNING) << "The sequence counter of the live framebuffer isn't lock free, other processes may not see its updates";
+		}
+
+		// Note: a viewer may still hold the frame of a previous render of the same file. The counter
+		//      continues from there, a reset would let the viewer take the new frame for its old one.
+		uint64_t sequence = 0;
+		if (memcmp(m_header->magic, aLiveFramebufferMagic, 4) == 0 && m_header->version == aLiveFramebufferVersion)
+		{
+			sequence = m_header->sequence.load(std::memory_order_relaxed);
+		}
+		sequence += (sequence & 1) ? 2 : 1;
+
+		// The odd counter keeps the readers off the header until it's complete
+		m_header->sequence.store(sequence, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(m_header->magic, aLiveFramebufferMagic, 4);
+		m_header->version = aLiveFramebufferVersion;
+		m_header->width = width;
+		m_header->height = height;
+		m_header->frame = 0;
+		memset(m_pixels, 0, m_frame.size() * sizeof(float));
+		m_header->sequence.store(sequence + 1, std::memory_order_release);
+
+		LOG(INFO) << "Publishing the film to the live framebuffer " << filename;
+		m_publisher = std::thread(&ALiveFramebuffer::publisherLoop, this);
+	}
+
+	ALiveFramebuffer::~ALiveFramebuffer()
+	{
+		if (m_publisher.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_shutdown = true;
+			}
+			m_shutdownCondition.notify_all();
+			m_publisher.join();
+			publish();
+		}
+		unmapFile(m_header, m_mappingSize, m_file, m_mapping);
+	}
+
+	void ALiveFramebuffer::publisherLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_shutdown)
+		{
+			m_shutdownCondition.wait_for(lock, std::chrono::milliseconds(m_intervalMS), [this] { return m_shutdown; });
+			if (!m_shutdown && m_dirty.exchange(false, std::memory_order_relaxed))
+			{
+				lock.unlock();
+				publish();
+				lock.lock();
+			}
+		}
+	}
+
+	void ALiveFramebuffer::publish()
+	{
+		// Convert the film first, the readers only have to wait for the copy
+		m_fill(m_frame.data());
+
+		uint64_t sequence = m_header->sequence.load(std::memory_order_relaxed);
+		m_header->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(m_pixels, m_frame.data(), m_frame.size() * sizeof(float));
+		++m_header->frame;
+		m_header->sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	//-------------------------------------------ALiveFramebufferReader-------------------------------------
+
+	ALiveFramebufferReader::ALiveFramebufferReader(const std::string &filename)
+	{
+		const void *ptr = mapFile(filename, m_mappingSize, false, m_file, m_mapping);
+		if (!ptr)
+		{
+			LOG(ERROR) << "Failed to map the live framebuffer " << filename;
+			return;
+		}
+
+		const ALiveFramebufferHeader *header = static_cast<const ALiveFramebufferHeader*>(ptr);
+		if (m_mappingSize < sizeof(ALiveFramebufferHeader) || memcmp(header->magic, aLiveFramebufferMagic, 4) != 0 ||
+			header->version != aLiveFramebufferVersion)
+		{
+			LOG(ERROR) << filename << " is not a live framebuffer";
+			unmapFile(ptr, m_mappingSize, m_file, m_mapping);
+			return;
+		}
+		m_header = header;
+	}
+
+	ALiveFramebufferReader::~ALiveFramebufferReader()
+	{
+		unmapFile(m_header, m_mappingSize, m_file, m_mapping);
+	}
+
+	bool ALiveFramebufferReader::readFrame(std::vector<float> &rgb, uint64_t *frame, int attempts) const
+	{
+		const float *pixels = reinterpret_cast<const float*>(m_header + 1);
+		for (int attempt = 0; attempt < attempts; ++attempt)
+		{
+			uint64_t sequence = m_header->sequence.load(std::memory_order_acquire);
+			if (sequence & 1)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			// The size may change when the next render starts, it's only valid along with the counter
+			const size_t nValues = 3 * (size_t)m_header->width * m_header->height;
+			const uint64_t nFrames = m_header->frame;
+			const bool fits = sizeof(ALiveFramebufferHeader) + nValues * sizeof(float) <= m_mappingSize;
+			if (fits)
+			{
+				rgb.resize(nValues);
+				memcpy(rgb.data(), pixels, nValues * sizeof(float));
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_header->sequence.load(std::memory_order_relaxed) != sequence)
+				continue;
+
+			if (!fits)
+			{
+				LOG(ERROR) << "The live framebuffer was resized, it has to be opened again";
+				return false;
+			}
+			if (frame)
+				*frame = nFrames;
+			return nFrames > 0;
+		}
+		return false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef ARLIVEFRAMEBUFFER_H
+#define ARLIVEFRAMEBUFFER_H
+
+#include "ArAurora.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace Aurora
+{
+	//Note: layout of the memory-mapped file of a live framebuffer, the header is followed by the
+	//      linear rgb values of the cropped film as 32-bit floats, row by row from the top. The
+	//      sequence counter is a seqlock: it is odd while the pixels are being written, a reader
+	//      copies the pixels and only keeps the copy if the counter was even and unchanged.
+	struct ALiveFramebufferHeader
+	{
+		char magic[4];						//"ALFB"
+		uint32_t version;
+		int32_t width, height;
+		std::atomic<uint64_t> sequence;
+		uint64_t frame;						//number of published frames
+		char pad[32];
+	};
+
+	static_assert(sizeof(ALiveFramebufferHeader) == 64, "the header of a live framebuffer is expected to be 64 bytes");
+
+	//Note: a writable mapping of a file that serves as a framebuffer to other processes while
+	//      a render runs, e.g. a file in /dev/shm. The render threads only mark the image dirty,
+	//      a publisher thread converts the film with |fill| at most every |intervalMS| and copies
+	//      it into the mapping. The last frame is published when the framebuffer is destroyed.
+	class ALiveFramebuffer final
+	{
+	public:
+		typedef std::unique_ptr<ALiveFramebuffer> ptr;
+		typedef std::function<void(float *rgb)> AFillFunction;
+
+		ALiveFramebuffer(const std::string &filename, int width, int height, AFillFunction fill, int intervalMS = 250);
+		~ALiveFramebuffer();
+
+		bool isValid() const { return m_header != nullptr; }
+
+		void markDirty() { m_dirty.store(true, std::memory_order_relaxed); }
+
+	private:
+		ALiveFramebuffer(const ALiveFramebuffer &) = delete;
+		ALiveFramebuffer &operator=(const ALiveFramebuffer &) = delete;
+
+		void publisherLoop();
+		void publish();
+
+		ALiveFramebufferHeader *m_header = nullptr;
+		float *m_pixels = nullptr;
+		size_t m_mappingSize = 0;
+		void *m_file = nullptr, *m_mapping = nullptr;	//handles of the mapping on Windows
+
+		AFillFunction m_fill;
+		std::vector<float> m_frame;
+		const int m_intervalMS;
+
+		std::atomic<bool> m_dirty;
+		bool m_shutdown = false;
+		std::mutex m_mutex;
+		std::condition_variable m_shutdownCondition;
+		std::thread m_publisher;
+	};
+
+	//Note: a read-only mapping of a live framebuffer, used by the viewers
+	class ALiveFramebufferReader final
+	{
+	public:
+		ALiveFramebufferReader(const std::string &filename);
+		~ALiveFramebufferReader();
+
+		bool isValid() const { return m_header != nullptr; }
+
+		int getWidth() const { return m_header->width; }
+		int getHeight() const { return m_header->height; }
+
+		// Copy a consistent frame to |rgb|, false if no frame was published yet or the
+		// writer kept on updating it for all of the attempts
+		bool readFrame(std::vector<float> &rgb, uint64_t *frame = nullptr, int attempts = 1000) const;
+
+	private:
+		ALiveFramebufferReader(const ALiveFramebufferReader &) = delete;
+		ALiveFramebufferReader &operator=(const ALiveFramebufferReader &) = delete;
+
+		const ALiveFramebufferHeader *m_header = nullptr;
+		size_t m_mappingSize = 0;
+		void *m_file = nullptr, *m_mapping = nullptr;	//handles of the mapping on Windows
+	};
+}
+
+#endif
\ No newline at end of file
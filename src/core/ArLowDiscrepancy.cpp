@@ -0,0 +1,122 @@
+#include "ArLowDiscrepancy.h"
+
+#include <vector>
+
+namespace Aurora
+{
+	const int aPrimes[aPrimeTableSize] =
+	{
+		2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71,
+		73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131, 137, 139, 149, 151, 157, 163, 167, 173,
+		179, 181, 191, 193, 197, 199, 211, 223, 227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281,
+		283, 293, 307, 311, 313, 317, 331, 337, 347, 349, 353, 359, 367, 373, 379, 383, 389, 397, 401, 409,
+		419, 421, 431, 433, 439, 443, 449, 457, 461, 463, 467, 479, 487, 491, 499, 503, 509, 521, 523, 541,
+		547, 557, 563, 569, 571, 577, 587, 593, 599, 601, 607, 613, 617, 619, 631, 641, 643, 647, 653, 659,
+		661, 673, 677, 683, 691, 701, 709, 719
+	};
+
+	//-------------------------------------------ALowDiscrepancySampler-------------------------------------
+
+	ALowDiscrepancySampler::ALowDiscrepancySampler(const APropertyList &props) : ASampler(props),
+		m_seed((uint32_t)props.getInteger("Seed", 0)), m_baseSeed(m_seed) {}
+
+	ALowDiscrepancySampler::ALowDiscrepancySampler(int64_t samplesPerPixel, int seed)
+		: ASampler(samplesPerPixel), m_seed((uint32_t)seed), m_baseSeed((uint32_t)seed) {}
+
+	void ALowDiscrepancySampler::setCloneSeed(int seed)
+	{
+		m_seed = seed < 0 ? (uint32_t)mixBits(((uint64_t)m_baseSeed << 32) | (uint32_t)seed) : m_baseSeed;
+	}
+
+	uint32_t ALowDiscrepancySampler::physicalDimension(uint32_t dimension) const
+	{
+		if (dimension < 2)
+			return dimension;
+		uint32_t nArrayDimensions = (uint32_t)(numSampleArrays1D() + (numSampleArrays1D() & 1) + 2 * numSampleArrays2D());
+		return dimension + nArrayDimensions;
+	}
+
+	void ALowDiscrepancySampler::startPixel(const AVector2i &p)
+	{
+		ASampler::startPixel(p);
+		m_dimension = 0;
+
+		// The array of n values of sample s holds the samples s * n to (s + 1) * n - 1 of its dimension
+		uint32_t dimension = 2;
+		for (size_t i = 0; i < numSampleArrays1D(); ++i, ++dimension)
+		{
+			Float *array = sampleArray1D(i);
+			for (size_t j = 0; j < sampleArray1DSize(i); ++j)
+				array[j] = sample1D((int64_t)j, dimension);
+		}
+		dimension += dimension & 1;
+		for (size_t i = 0; i < numSampleArrays2D(); ++i, dimension += 2)
+		{
+			AVector2f *array = sampleArray2D(i);
+			for (size_t j = 0; j < sampleArray2DSize(i); ++j)
+				array[j] = sample2D((int64_t)j, dimension);
+		}
+	}
+
+	Float ALowDiscrepancySampler::get1D()
+	{
+		CHECK_LT(m_currentPixelSampleIndex, samplesPerPixel);
+		return sample1D(m_currentPixelSampleIndex, physicalDimension(m_dimension++));
+	}
+
+	AVector2f ALowDiscrepancySampler::get2D()
+	{
+		CHECK_LT(m_currentPixelSampleIndex, samplesPerPixel);
+		// Start at an even dimension, the padded samplers stratify the pairs (2k, 2k + 1) jointly
+		m_dimension += m_dimension & 1;
+		AVector2f u = sample2D(m_currentPixelSampleIndex, physicalDimension(m_dimension));
+		m_dimension += 2;
+		return u;
+	}
+
+	bool ALowDiscrepancySampler::startNextSample()
+	{
+		m_dimension = 0;
+		return ASampler::startNextSample();
+	}
+
+	bool ALowDiscrepancySampler::setSampleNumber(int64_t sampleNum)
+	{
+		m_dimension = 0;
+		return ASampler::setSampleNumber(sampleNum);
+	}
+
+	//-------------------------------------------PMJ02-------------------------------------
+
+	// Owen scrambling with an independent random flip for every prefix of the digits
+	static uint32_t owenScramble(uint32_t v, uint64_t seed)
+	{
+		uint32_t result = 0;
+		for (int d = 31; d >= 0; --d)
+		{
+			uint64_t prefix = d == 31 ? 0 : (v >> (d + 1));
+			uint32_t flip = (uint32_t)(mixBits(seed ^ (prefix << 6) ^ (uint64_t)d) & 1);
+			result |= (((v >> d) & 1) ^ flip) << d;
+		}
+		return result;
+	}
+
+	void generatePMJ02(AVector2f *samples, int nSamples, ARng &rng)
+	{
+		//Note: the elementary intervals of the points of a (0,2) sequence don't leave a free
+		//      choice for the next point in general, placing the points one by one at random runs
+		//      into dead ends for long sequences. Stochastic (0,2) sequences are equivalent to
+		//      Owen-scrambled (0,2) sequences though (Helmer et al. 2021), they are generated by
+		//      scrambling the first two Sobol dimensions with a fully random flip tree.
+		CHECK_EQ(nSamples & (nSamples - 1), 0);
+		uint64_t seedX = ((uint64_t)rng.uniformUInt32() << 32) | rng.uniformUInt32();
+		uint64_t seedY = ((uint64_t)rng.uniformUInt32() << 32) | rng.uniformUInt32();
+		for (int i = 0; i < nSamples; ++i)
+		{
+			uint32_t x, y;
+			sobol2D((uint32_t)i, x, y);
+			samples[i] = AVector2f(toUnitFloat(owenScramble(x, seedX)), toUnitFloat(owenScramble(y, seedY)));
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,245 @@
+#ifndef ARLOWDISCREPANCY_H
+#define ARLOWDISCREPANCY_H
+
+#include "ArAurora.h"
+#include "ArMathUtils.h"
+#include "ArSampler.h"
+#include "ArRng.h"
+
+namespace Aurora
+{
+	// Low discrepancy sequences and their randomizations shared by the Sobol, Halton and PMJ02 samplers
+
+	inline uint64_t mixBits(uint64_t v)
+	{
+		v ^= (v >> 31);
+		v *= 0x7fb5d329728ea185ULL;
+		v ^= (v >> 27);
+		v *= 0x81dadef4bc2dd44dULL;
+		v ^= (v >> 33);
+		return v;
+	}
+
+	// Hash of a pixel, a sample dimension and a seed that decorrelates the randomizations of them
+	inline uint64_t hashSample(const AVector2i &pixel, uint32_t dimension, uint32_t seed)
+	{
+		uint64_t h = mixBits(((uint64_t)(uint32_t)pixel.x << 32) | (uint32_t)pixel.y);
+		return mixBits(h ^ (((uint64_t)dimension << 32) | seed));
+	}
+
+	inline bool isPowerOf2(int64_t v) { return v > 0 && (v & (v - 1)) == 0; }
+
+	inline int64_t roundUpPow2(int64_t v)
+	{
+		int64_t p = 1;
+		while (p < v)
+			p <<= 1;
+		return p;
+	}
+
+	inline int log2Int(uint64_t v)
+	{
+		int n = 0;
+		while (v >>= 1)
+			++n;
+		return n;
+	}
+
+	inline uint32_t reverseBits32(uint32_t n)
+	{
+		n = (n << 16) | (n >> 16);
+		n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+		n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+		n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+		n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+		return n;
+	}
+
+	// Map 32 bits of a sample to [0, 1). The bits that don't fit into a float are dropped rather than
+	// rounded, rounding would move values across the strata boundaries
+	inline Float toUnitFloat(uint32_t v)
+	{
+		return Float(v >> 8) * 5.9604644775390625e-8f;
+	}
+
+	//Note: Owen scrambling of the bits of |v| as in Burley 2020, "Practical Hash-based Owen
+	//      Scrambling". Every bit is flipped depending on the bits above it, so the aligned
+	//      blocks of 2^k values are mapped onto aligned blocks.
+	inline uint32_t laineKarrasPermutation(uint32_t v, uint32_t seed)
+	{
+		v += seed;
+		v ^= v * 0x6c50b47cu;
+		v ^= v * 0xb82f1e52u;
+		v ^= v * 0xc7afe638u;
+		v ^= v * 0x8d22f6e6u;
+		return v;
+	}
+
+	inline uint32_t nestedUniformScramble(uint32_t v, uint32_t seed)
+	{
+		return reverseBits32(laineKarrasPermutation(reverseBits32(v), seed));
+	}
+
+	// The first two dimensions of the Sobol sequence, (van der Corput, Sobol's second dimension)
+	inline void sobol2D(uint32_t index, uint32_t &x, uint32_t &y)
+	{
+		x = reverseBits32(index);
+		y = 0;
+		for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		{
+			if (index & 1)
+				y ^= v;
+		}
+	}
+
+	// Element |i| of a random permutation of [0, n) selected by |seed| (Kensler 2013)
+	inline int permutationElement(uint32_t i, uint32_t n, uint32_t seed)
+	{
+		uint32_t w = n - 1;
+		w |= w >> 1;
+		w |= w >> 2;
+		w |= w >> 4;
+		w |= w >> 8;
+		w |= w >> 16;
+		do
+		{
+			i ^= seed;
+			i *= 0xe170893d;
+			i ^= seed >> 16;
+			i ^= (i & w) >> 4;
+			i ^= seed >> 8;
+			i *= 0x0929eb3f;
+			i ^= seed >> 23;
+			i ^= (i & w) >> 1;
+			i *= 1 | seed >> 27;
+			i *= 0x6935fa69;
+			i ^= (i & w) >> 11;
+			i *= 0x74dcb303;
+			i ^= (i & w) >> 2;
+			i *= 0x9e501cc3;
+			i ^= (i & w) >> 2;
+			i *= 0xc860a3df;
+			i &= w;
+			i ^= i >> 5;
+		} while (i >= n);
+		return (int)((i + seed) % n);
+	}
+
+	static constexpr int aPrimeTableSize = 128;
+	extern const int aPrimes[aPrimeTableSize];
+
+	//Note: the radical inverse of |a| in base |base| with the digits permuted by a hash of the
+	//      digits below them, which is Owen scrambling in an arbitrary base
+	inline Float owenScrambledRadicalInverse(int base, uint64_t a, uint32_t hash)
+	{
+		const Float invBase = (Float)1 / (Float)base;
+		uint64_t reversedDigits = 0;
+		Float invBaseM = 1;
+		int digitIndex = 0;
+		while (1 - (base - 1) * invBaseM < 1)
+		{
+			uint64_t next = a / base;
+			int digitValue = (int)(a - next * base);
+			uint32_t digitHash = (uint32_t)mixBits(hash ^ reversedDigits ^ ((uint64_t)digitIndex << 48));
+			digitValue = permutationElement(digitValue, base, digitHash);
+			reversedDigits = reversedDigits * base + digitValue;
+			invBaseM *= invBase;
+			a = next;
+			++digitIndex;
+		}
+		return glm::min(invBaseM * reversedDigits, aOneMinusEpsilon);
+	}
+
+	inline Float radicalInverse(int base, uint64_t a)
+	{
+		const Float invBase = (Float)1 / (Float)base;
+		uint64_t reversedDigits = 0;
+		Float invBaseN = 1;
+		while (a)
+		{
+			uint64_t next = a / base;
+			uint64_t digit = a - next * base;
+			reversedDigits = reversedDigits * base + digit;
+			invBaseN *= invBase;
+			a = next;
+		}
+		return glm::min(reversedDigits * invBaseN, aOneMinusEpsilon);
+	}
+
+	// The integer whose |nDigits| digit radical inverse in base |base| has the reversed digits |inverse|
+	inline uint64_t inverseRadicalInverse(uint64_t inverse, int base, int nDigits)
+	{
+		uint64_t index = 0;
+		for (int i = 0; i < nDigits; ++i)
+		{
+			uint64_t digit = inverse % base;
+			inverse /= base;
+			index = index * base + digit;
+		}
+		return index;
+	}
+
+	// The inverse of |a| modulo |n|, a and n are coprime
+	inline uint64_t multiplicativeInverse(int64_t a, int64_t n)
+	{
+		// Extended Euclid's algorithm
+		int64_t r0 = a, r1 = n, s0 = 1, s1 = 0;
+		while (r1 != 0)
+		{
+			int64_t q = r0 / r1;
+			int64_t r = r0 - q * r1;
+			r0 = r1;
+			r1 = r;
+			int64_t s = s0 - q * s1;
+			s0 = s1;
+			s1 = s;
+		}
+		return (uint64_t)(s0 < 0 ? s0 + n : s0 % n);
+	}
+
+	//Note: a progressive multi-jittered (0,2) sequence (Christensen, Kensler and Kilpatrick 2018)
+	//      of |nSamples| points, a power of two. Every prefix of a power of two length is stratified
+	//      in all the elementary intervals of that many points, and the points are jittered
+	//      uniformly within them.
+	void generatePMJ02(AVector2f *samples, int nSamples, ARng &rng);
+
+	//Note: base of the samplers that compute any dimension of any sample of a pixel directly
+	//      from the sample index. The camera sample takes the dimensions 0 and 1, the sample
+	//      arrays the dimensions after them and get1D()/get2D() continue from there on, so that
+	//      the same dimension always serves the same purpose along the samples of a pixel. The
+	//      randomization only depends on the "Seed" property, not on the seed of clone(), so
+	//      that the passes of a progressive render continue the same sequences. Negative clone
+	//      seeds select other sequences, which keeps prepasses apart from the image.
+	class ALowDiscrepancySampler : public ASampler
+	{
+	public:
+		ALowDiscrepancySampler(const APropertyList &props);
+		ALowDiscrepancySampler(int64_t samplesPerPixel, int seed);
+
+		virtual void startPixel(const AVector2i &p) override;
+		virtual Float get1D() override;
+		virtual AVector2f get2D() override;
+
+		virtual bool startNextSample() override;
+		virtual bool setSampleNumber(int64_t sampleNum) override;
+
+	protected:
+		// Dimension |dimension| of sample |index| of the current pixel
+		virtual Float sample1D(int64_t index, uint32_t dimension) const = 0;
+
+		// Dimensions |dimension| and |dimension| + 1 of sample |index| of the current pixel
+		virtual AVector2f sample2D(int64_t index, uint32_t dimension) const = 0;
+
+		void setCloneSeed(int seed);
+
+		uint32_t m_seed;
+
+	private:
+		uint32_t physicalDimension(uint32_t dimension) const;
+
+		uint32_t m_baseSeed;
+		uint32_t m_dimension = 0;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -224,8 +224,8 @@ namespace Aurora
 
 		void boundingSphere(AVector3<T> *center, Float *radius) const
 		{
-			*center = (m_pMin + m_pMax) / 2;
-			*radius = Inside(*center, *this) ? Distance(*center, m_pMax) : 0;
+			*center = (m_pMin + m_pMax) / (T)2;
+			*radius = inside(*center, *this) ? distance(*center, m_pMax) : 0;
 		}
 
 		template <typename U>
@@ -673,6 +673,61 @@ namespace Aurora
 		wt = eta * -wi + (eta * cosThetaI - cosThetaT) * AVector3f(n);
 		return true;
 	}
+
+	//Note: the set of directions within an angle of acos(m_cosTheta) around m_w
+	class ADirectionCone
+	{
+	public:
+		ADirectionCone() = default;
+		ADirectionCone(const AVector3f &w, Float cosTheta) : m_w(normalize(w)), m_cosTheta(cosTheta) {}
+		explicit ADirectionCone(const AVector3f &w) : ADirectionCone(w, 1) {}
+
+		static ADirectionCone entireSphere() { return ADirectionCone(AVector3f(0, 0, 1), -1); }
+
+		AVector3f m_w = AVector3f(0, 0, 1);
+		Float m_cosTheta = -1;
+	};
+
+	// Smallest cone that contains both cones
+	inline ADirectionCone unionCone(const ADirectionCone &a, const ADirectionCone &b)
+	{
+		// Handle the cases where one cone is inside the other
+		Float theta_a = safeAcos(a.m_cosTheta), theta_b = safeAcos(b.m_cosTheta);
+		Float theta_d = safeAcos(dot(a.m_w, b.m_w));
+		if (glm::min(theta_d + theta_b, aPi) <= theta_a)
+			return a;
+		if (glm::min(theta_d + theta_a, aPi) <= theta_b)
+			return b;
+
+		// Compute the spread angle of the merged cone
+		Float theta_o = (theta_a + theta_d + theta_b) / 2;
+		if (theta_o >= aPi)
+			return ADirectionCone::entireSphere();
+
+		// Rotate a's axis towards b's axis to get the merged cone's axis (Rodrigues' formula)
+		Float theta_r = theta_o - theta_a;
+		AVector3f wr = cross(a.m_w, b.m_w);
+		if (lengthSquared(wr) == 0)
+			return ADirectionCone::entireSphere();
+		wr = normalize(wr);
+		AVector3f w = a.m_w * glm::cos(theta_r) + cross(wr, a.m_w) * glm::sin(theta_r)
+			+ wr * dot(wr, a.m_w) * (1 - glm::cos(theta_r));
+		return ADirectionCone(w, glm::cos(theta_o));
+	}
+
+	// Cone of the directions from p towards the bounding sphere of b
+	inline ADirectionCone boundSubtendedDirections(const ABounds3f &b, const AVector3f &p)
+	{
+		AVector3f center = (b.m_pMin + b.m_pMax) / (Float)2;
+		Float radius2 = distanceSquared(center, b.m_pMax);
+		Float distance2 = distanceSquared(p, center);
+		if (distance2 < radius2)
+			return ADirectionCone::entireSphere();
+
+		Float sin2ThetaMax = radius2 / distance2;
+		Float cosThetaMax = safeSqrt(1 - sin2ThetaMax);
+		return ADirectionCone(center - p, cosThetaMax);
+	}
 }
 
 #endif
\ No newline at end of file
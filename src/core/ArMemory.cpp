@@ -1,29 +1,128 @@
 #include "ArMemory.h"
 
+#include "ArAurora.h"
+
+#ifdef AURORA_WINDOWS_OS
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#endif
+
 namespace Aurora
 {
-#define PBRT_L1_CACHE_LINE_SIZE 64
-#define PBRT_HAVE__ALIGNED_MALLOC
-
 	// Memory Allocation Functions
-	void *AllocAligned(size_t size) {
-#if defined(PBRT_HAVE__ALIGNED_MALLOC)
-		return _aligned_malloc(size, PBRT_L1_CACHE_LINE_SIZE);
-#elif defined(PBRT_HAVE_POSIX_MEMALIGN)
+	void *AllocAligned(size_t size)
+	{
+#ifdef AURORA_WINDOWS_OS
+		return _aligned_malloc(size, AURORA_L1_CACHE_LINE_SIZE);
+#else
 		void *ptr;
-		if (posix_memalign(&ptr, PBRT_L1_CACHE_LINE_SIZE, size) != 0) ptr = nullptr;
+		if (posix_memalign(&ptr, AURORA_L1_CACHE_LINE_SIZE, size) != 0)
+			ptr = nullptr;
 		return ptr;
-#else
-		return memalign(PBRT_L1_CACHE_LINE_SIZE, size);
 #endif
 	}
 
-	void FreeAligned(void *ptr) {
-		if (!ptr) return;
-#if defined(PBRT_HAVE__ALIGNED_MALLOC)
+	void FreeAligned(void *ptr)
+	{
+		if (!ptr)
+			return;
+#ifdef AURORA_WINDOWS_OS
 		_aligned_free(ptr);
 #else
 		free(ptr);
 #endif
 	}
-}
\ No newline at end of file
+
+	//Note: the common size of a huge page on x64 (2MB)
+	static constexpr size_t aHugePageSize = 2 * 1024 * 1024;
+
+	size_t pageGranularity(AHugePages mode) { return (mode == AHugePages::ANone) ? 1 : aHugePageSize; }
+
+	void *AllocPages(size_t size, AHugePages mode)
+	{
+#ifdef AURORA_WINDOWS_OS
+		void *ptr = nullptr;
+		if (mode == AHugePages::AExplicit)
+		{
+			// Note: large pages require the SeLockMemoryPrivilege of the user account
+			size_t largePage = GetLargePageMinimum();
+			if (largePage > 0 && size % largePage == 0)
+			{
+				ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			}
+			if (!ptr)
+			{
+				static bool warned = false;
+				if (!warned)
+				{
+					warned = true;
+					LOG(WARNING) << "Large pages are unavailable, falling back to regular pages";
+				}
+			}
+		}
+		if (!ptr)
+		{
+			ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		}
+		return ptr;
+#else
+		void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if (mode == AHugePages::AExplicit)
+		{
+			// Note: this only succeeds if huge pages were reserved (/proc/sys/vm/nr_hugepages)
+			ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (ptr == MAP_FAILED)
+			{
+				static bool warned = false;
+				if (!warned)
+				{
+					warned = true;
+					LOG(WARNING) << "Explicit huge pages are unavailable, falling back to transparent huge pages";
+				}
+			}
+			else
+			{
+				return ptr;
+			}
+		}
+#endif
+		// Over-allocate and trim so that the block starts at a huge page boundary,
+		// otherwise the kernel could never back it with transparent huge pages
+		size_t granularity = (mode == AHugePages::ANone) ? 0 : aHugePageSize;
+		ptr = mmap(nullptr, size + granularity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			return nullptr;
+
+		uint8_t *base = (uint8_t *)ptr;
+		if (granularity > 0)
+		{
+			uint8_t *aligned = (uint8_t *)(((uintptr_t)base + granularity - 1) & ~(uintptr_t)(granularity - 1));
+			size_t head = aligned - base, tail = granularity - head;
+			if (head > 0)
+				munmap(base, head);
+			if (tail > 0)
+				munmap(aligned + size, tail);
+			base = aligned;
+#ifdef MADV_HUGEPAGE
+			madvise(base, size, MADV_HUGEPAGE);
+#endif
+		}
+		return base;
+#endif
+	}
+
+	void FreePages(void *ptr, size_t size)
+	{
+		if (!ptr)
+			return;
+#ifdef AURORA_WINDOWS_OS
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, size);
+#endif
+	}
+}
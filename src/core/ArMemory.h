@@ -1,15 +1,21 @@
 #ifndef ARMEMORY_H
 #define ARMEMORY_H
 
-#include <list>
+#include <new>
+#include <vector>
+#include <memory>
+#include <utility>
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 
 namespace Aurora
 {
 	// Memory Declarations
 #define ARENA_ALLOC(arena, Type) new ((arena).Alloc(sizeof(Type))) Type
 
+#define AURORA_L1_CACHE_LINE_SIZE 64
+
 	void *AllocAligned(size_t size);
 
 	template <typename T>
@@ -20,35 +26,58 @@ namespace Aurora
 
 	void FreeAligned(void *);
 
-	class
-#ifdef PBRT_HAVE_ALIGNAS
-		alignas(PBRT_L1_CACHE_LINE_SIZE)
-#endif // PBRT_HAVE_ALIGNAS
+	//Note: backing pages used for the memory blocks of a MemoryArena
+	enum class AHugePages { ANone, ATransparent, AExplicit };
+
+	// Allocate page-aligned memory directly from the OS, optionally backed by
+	// huge pages (AExplicit falls back to transparent huge pages if unavailable)
+	void *AllocPages(size_t size, AHugePages mode);
+	void FreePages(void *ptr, size_t size);
+
+	// Size that the blocks allocated with the given page mode are rounded to
+	size_t pageGranularity(AHugePages mode);
 
-		MemoryArena
+	class alignas(AURORA_L1_CACHE_LINE_SIZE) MemoryArena
 	{
 	public:
+		//Note: plain new ignores the cache line alignment of the class before C++17, the arenas
+		//      kept on the heap (one per thread) are placed into memory from AllocAligned instead
+		struct AlignedDeleter
+		{
+			void operator()(MemoryArena *arena) const
+			{
+				arena->~MemoryArena();
+				FreeAligned(arena);
+			}
+		};
+		typedef std::unique_ptr<MemoryArena, AlignedDeleter> ptr;
+
+		static ptr CreateAligned(size_t blockSize = 262144, AHugePages pages = AHugePages::ANone)
+		{
+			void *memory = AllocAligned(sizeof(MemoryArena));
+			if (!memory)
+				throw std::bad_alloc();
+			return ptr(new (memory) MemoryArena(blockSize, pages));
+		}
+
 		// MemoryArena Public Methods
-		MemoryArena(size_t blockSize = 262144) : blockSize(blockSize) {}
+		MemoryArena(size_t blockSize = 262144, AHugePages pages = AHugePages::ANone)
+			: blockSize(roundToPages(blockSize, pages)), pages(pages) {}
+
 		~MemoryArena()
 		{
-			FreeAligned(currentBlock);
-			for (auto &block : usedBlocks) FreeAligned(block.second);
-			for (auto &block : availableBlocks) FreeAligned(block.second);
+			freeBlock(currentBlock, currentAllocSize);
+			for (auto &block : usedBlocks) freeBlock(block.second, block.first);
+			for (auto &block : availableBlocks) freeBlock(block.second, block.first);
 		}
-		void *Alloc(size_t nBytes) {
-			// Round up _nBytes_ to minimum machine alignment
-#if __GNUC__ == 4 && __GNUC_MINOR__ < 9
-		// gcc bug: max_align_t wasn't in std:: until 4.9.0
-			const int align = alignof(::max_align_t);
-#elif !defined(PBRT_HAVE_ALIGNOF)
-			const int align = 16;
-#else
-			const int align = alignof(std::max_align_t);
-#endif
-#ifdef PBRT_HAVE_CONSTEXPR
-			static_assert(IsPowerOf2(align), "Minimum alignment not a power of two");
-#endif
+
+		void *Alloc(size_t nBytes)
+		{
+			// Round up _nBytes_ to minimum machine alignment, blocks themselves
+			// are at least cache line aligned
+			const size_t align = alignof(std::max_align_t);
+			static_assert((alignof(std::max_align_t) & (alignof(std::max_align_t) - 1)) == 0,
+				"Minimum alignment not a power of two");
 			nBytes = (nBytes + align - 1) & ~(align - 1);
 			if (currentBlockPos + nBytes > currentAllocSize)
 			{
@@ -63,8 +92,7 @@ namespace Aurora
 				// Get new block of memory for _MemoryArena_
 
 				// Try to get memory block from _availableBlocks_
-				for (auto iter = availableBlocks.begin();
-					iter != availableBlocks.end(); ++iter)
+				for (auto iter = availableBlocks.begin(); iter != availableBlocks.end(); ++iter)
 				{
 					if (iter->first >= nBytes)
 					{
@@ -76,8 +104,8 @@ namespace Aurora
 				}
 				if (!currentBlock)
 				{
-					currentAllocSize = std::max(nBytes, blockSize);
-					currentBlock = AllocAligned<uint8_t>(currentAllocSize);
+					currentAllocSize = roundToPages(std::max(nBytes, blockSize), pages);
+					currentBlock = allocBlock(currentAllocSize);
 				}
 				currentBlockPos = 0;
 			}
@@ -97,8 +125,10 @@ namespace Aurora
 
 		void Reset()
 		{
+			highWaterMark = std::max(highWaterMark, BytesInUse());
 			currentBlockPos = 0;
-			availableBlocks.splice(availableBlocks.begin(), usedBlocks);
+			availableBlocks.insert(availableBlocks.end(), usedBlocks.begin(), usedBlocks.end());
+			usedBlocks.clear();
 		}
 
 		size_t TotalAllocated() const
@@ -109,15 +139,54 @@ namespace Aurora
 			return total;
 		}
 
+		//Note: bytes handed out since the last Reset(), including the unused tails of full blocks
+		size_t BytesInUse() const
+		{
+			size_t total = currentBlockPos;
+			for (const auto &alloc : usedBlocks) total += alloc.first;
+			return total;
+		}
+
+		// Maximum number of bytes in use between two resets over the arena's lifetime
+		size_t HighWaterMark() const { return std::max(highWaterMark, BytesInUse()); }
+
+		// Number of blocks requested from the system allocator so far
+		size_t NumBlockAllocations() const { return numBlockAllocations; }
+
 	private:
 		MemoryArena(const MemoryArena &) = delete;
 		MemoryArena &operator=(const MemoryArena &) = delete;
+
+		static size_t roundToPages(size_t size, AHugePages mode)
+		{
+			size_t granularity = pageGranularity(mode);
+			return (size + granularity - 1) / granularity * granularity;
+		}
+
+		uint8_t *allocBlock(size_t size)
+		{
+			++numBlockAllocations;
+			if (pages == AHugePages::ANone)
+				return AllocAligned<uint8_t>(size);
+			return (uint8_t *)AllocPages(size, pages);
+		}
+
+		void freeBlock(uint8_t *block, size_t size)
+		{
+			if (pages == AHugePages::ANone)
+				FreeAligned(block);
+			else
+				FreePages(block, size);
+		}
+
 		// MemoryArena Private Data
 		const size_t blockSize;
+		const AHugePages pages;
 		size_t currentBlockPos = 0, currentAllocSize = 0;
+		size_t highWaterMark = 0, numBlockAllocations = 0;
 		uint8_t *currentBlock = nullptr;
-		std::list<std::pair<size_t, uint8_t *>> usedBlocks, availableBlocks;
+		std::vector<std::pair<size_t, uint8_t *>> usedBlocks, availableBlocks;
 	};
 }
 
-#endif
\ No newline at end of file
+#endif
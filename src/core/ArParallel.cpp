@@ -2,6 +2,8 @@
 
 namespace Aurora
 {
+	thread_local int AParallelUtils::m_threadIndex = 0;
+
 	void ABarrier::wait() 
 	{
 		std::unique_lock<std::mutex> lock(m_mutex);
@@ -18,4 +20,75 @@ namespace Aurora
 			m_cv.wait(lock, [this] { return m_count == 0; });
 		}
 	}
-}
\ No newline at end of file
+
+	//-------------------------------------------AThreadPool-------------------------------------
+
+	AThreadPool &AThreadPool::instance()
+	{
+		static AThreadPool pool(numSystemCores());
+		return pool;
+	}
+
+	AThreadPool::AThreadPool(int nThreads)
+	{
+		for (int i = 1; i < nThreads; ++i)
+		{
+			m_workers.push_back(std::thread(&AThreadPool::workerLoop, this, i));
+		}
+	}
+
+	AThreadPool::~AThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_shutdown = true;
+		}
+		m_workCondition.notify_all();
+		for (auto &worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void AThreadPool::run(const std::function<void(int)> &body)
+	{
+		std::lock_guard<std::mutex> runLock(m_runMutex);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_body = &body;
+			m_activeWorkers = static_cast<int>(m_workers.size());
+			++m_generation;
+		}
+		m_workCondition.notify_all();
+
+		// The calling thread takes part in the loop as worker 0
+		body(0);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneCondition.wait(lock, [this] { return m_activeWorkers == 0; });
+		m_body = nullptr;
+	}
+
+	void AThreadPool::workerLoop(int threadIndex)
+	{
+		uint64_t generation = 0;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_workCondition.wait(lock, [&] { return m_shutdown || m_generation != generation; });
+			if (m_shutdown)
+				return;
+
+			generation = m_generation;
+			const std::function<void(int)> &body = *m_body;
+			lock.unlock();
+			body(threadIndex);
+			lock.lock();
+
+			if (--m_activeWorkers == 0)
+			{
+				m_doneCondition.notify_one();
+			}
+		}
+	}
+}
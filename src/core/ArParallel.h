@@ -72,6 +72,40 @@ namespace Aurora
 
 	inline int numSystemCores() { return glm::max(1u, std::thread::hardware_concurrency()); }
 
+	//Note: worker threads are created once and live until exit, so that the
+	//      parallel loops of consecutive renders don't pay for thread creation.
+	//      The calling thread joins the loop as worker 0.
+	class AThreadPool
+	{
+	public:
+		static AThreadPool &instance();
+
+		~AThreadPool();
+
+		//Run body(threadIndex) once on each of the numThreads() threads and wait for all of them,
+		//concurrent calls from different threads are executed one after another
+		void run(const std::function<void(int)> &body);
+
+		int numThreads() const { return static_cast<int>(m_workers.size()) + 1; }
+
+	private:
+		AThreadPool(int nThreads);
+		AThreadPool(const AThreadPool &) = delete;
+		AThreadPool &operator=(const AThreadPool &) = delete;
+
+		void workerLoop(int threadIndex);
+
+		std::vector<std::thread> m_workers;
+		std::mutex m_runMutex;
+
+		std::mutex m_mutex;
+		std::condition_variable m_workCondition, m_doneCondition;
+		const std::function<void(int)> *m_body = nullptr;
+		uint64_t m_generation = 0;
+		int m_activeWorkers = 0;
+		bool m_shutdown = false;
+	};
+
 	class AParallelUtils
 	{
 	public:
@@ -93,15 +127,21 @@ namespace Aurora
 			}
 		}
 
+		//Note: index of the calling worker thread in [0, numSystemCores()),
+		//      the thread calling a serial parallelFor has index 0
+		static int getThreadIndex() { return m_threadIndex; }
+
 	private:
 
+		static thread_local int m_threadIndex;
+
 		template<typename Callable>
 		static void parallel_for(size_t start, size_t end, Callable function)
 		{
 			DCHECK(start < end);
 			//Note: this parallel_for split the task in a simple averaging manner
 			//      which is inefficient for inbalance task among threads
-			const int n_threads = numSystemCores();
+			const int n_threads = AThreadPool::instance().numThreads();
 			const size_t n_task = end - start;
 
 			const int n_max_tasks_per_thread = (n_task / n_threads) + (n_task % n_threads == 0 ? 0 : 1);
@@ -113,21 +153,14 @@ namespace Aurora
 				const int inclusive_start_index = thread_index * n_max_tasks_per_thread - n_lacking_tasks_so_far;
 				const int exclusive_end_index = inclusive_start_index + n_max_tasks_per_thread
 					- (thread_index - n_threads + n_lacking_tasks >= 0 ? 1 : 0);
+				m_threadIndex = thread_index;
 
 				for (int k = inclusive_start_index; k < exclusive_end_index; ++k)
 				{
 					function(k);
 				}
 			};
-			std::vector<std::thread> threads;
-			for (int j = 0; j < n_threads; ++j)
-			{
-				threads.push_back(std::thread(inner_loop, j)); 
-			}
-			for (auto& t : threads) 
-			{ 
-				t.join(); 
-			}
+			AThreadPool::instance().run(inner_loop);
 		}
 
 		template<typename Callable>
@@ -137,27 +170,17 @@ namespace Aurora
 			//Note: this parallel_for assign the task to thread by atomic 
 			//      opertion over task index which is more efficient in general case
 
-			const int n_threads = numSystemCores();
-			const size_t n_task = end - start;
-
 			std::atomic<size_t> task_index(start);
 			auto inner_loop = [&](const int thread_index)
 			{
+				m_threadIndex = thread_index;
 				size_t index;
 				while ((index = task_index.fetch_add(1)) < end)
 				{
 					func(index);
 				}
 			};
-			std::vector<std::thread> threads;
-			for (int j = 0; j < n_threads; ++j)
-			{
-				threads.push_back(std::thread(inner_loop, j));
-			}
-			for (auto& t : threads)
-			{
-				t.join();
-			}
+			AThreadPool::instance().run(inner_loop);
 		}
 
 	};
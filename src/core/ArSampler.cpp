@@ -1,28 +1,82 @@
 #include "ArSampler.h"
 
 #include "ArCamera.h"
+#include "ArFilter.h"
+#include "ArMemory.h"
+
+#include <cstring>
 
 namespace Aurora
 {
 	//-------------------------------------------ASampler-------------------------------------
 
-	ASampler::~ASampler() {}
+	ASampler::~ASampler() { FreeAligned(m_sampleArrays); }
 
-	ASampler::ASampler(int64_t samplesPerPixel) : samplesPerPixel(samplesPerPixel) {}
+	ASampler::ASampler(int64_t samplesPerPixel) : samplesPerPixel(samplesPerPixel),
+		m_minSamplesPerPixel(samplesPerPixel), m_targetSamplesPerPixel(samplesPerPixel),
+		m_firstSampleNumber(0), m_endSampleNumber(samplesPerPixel) {}
 
-	ASampler::ASampler(const APropertyList &props) : samplesPerPixel(props.getInteger("SPP", 1)) {}
+	//Note: an adaptive sampler provides up to MaxSPP samples per pixel
+	ASampler::ASampler(const APropertyList &props) : samplesPerPixel(props.getBoolean("Adaptive", false) ?
+		props.getInteger("MaxSPP", 4 * props.getInteger("SPP", 1)) : props.getInteger("SPP", 1)),
+		m_firstSampleNumber(0), m_endSampleNumber(samplesPerPixel)
+	{
+		m_targetSamplesPerPixel = props.getInteger("SPP", 1);
+		m_adaptive = props.getBoolean("Adaptive", false);
+		if (m_adaptive)
+		{
+			m_minSamplesPerPixel = props.getInteger("MinSPP", glm::max(2, glm::min(16, (int)m_targetSamplesPerPixel)));
+			m_adaptiveThreshold = props.getFloat("Threshold", 0.05f);
+			CHECK_GE(m_minSamplesPerPixel, 2);
+			CHECK_LE(m_minSamplesPerPixel, samplesPerPixel);
+		}
+		else
+		{
+			m_minSamplesPerPixel = samplesPerPixel;
+		}
+	}
 
-	ACameraSample ASampler::getCameraSample(const AVector2i &pRaster)
+	//Note: a clone gets a buffer of its own, the layout of the arrays is shared
+	ASampler::ASampler(const ASampler &other) : samplesPerPixel(other.samplesPerPixel),
+		m_adaptive(other.m_adaptive), m_minSamplesPerPixel(other.m_minSamplesPerPixel),
+		m_targetSamplesPerPixel(other.m_targetSamplesPerPixel), m_adaptiveThreshold(other.m_adaptiveThreshold),
+		m_currentPixel(other.m_currentPixel), m_currentPixelSampleIndex(other.m_currentPixelSampleIndex),
+		m_firstSampleNumber(other.m_firstSampleNumber), m_endSampleNumber(other.m_endSampleNumber),
+		m_samples1DArraySizes(other.m_samples1DArraySizes), m_samples2DArraySizes(other.m_samples2DArraySizes),
+		m_array1DOffset(other.m_array1DOffset), m_array2DOffset(other.m_array2DOffset),
+		m_sampleArray1DOffsets(other.m_sampleArray1DOffsets), m_sampleArray2DOffsets(other.m_sampleArray2DOffsets)
+	{
+		allocateSampleArrays(other.m_sampleArraysSize);
+		if (m_sampleArraysSize > 0)
+			std::memcpy(m_sampleArrays, other.m_sampleArrays, m_sampleArraysSize * sizeof(Float));
+	}
+
+	void ASampler::allocateSampleArrays(size_t size)
+	{
+		FreeAligned(m_sampleArrays);
+		m_sampleArrays = size > 0 ? AllocAligned<Float>(size) : nullptr;
+		m_sampleArraysSize = size;
+	}
+
+	ACameraSample ASampler::getCameraSample(const AVector2i &pRaster, const AFilterSampler *filterSampler)
 	{
 		ACameraSample cs;
-		cs.pFilm = (AVector2f)pRaster + get2D();
+		if (filterSampler != nullptr)
+		{
+			AVector2f offset = filterSampler->sample(get2D(), cs.filterWeight);
+			cs.pFilm = (AVector2f)pRaster + AVector2f(0.5f, 0.5f) + offset;
+		}
+		else
+		{
+			cs.pFilm = (AVector2f)pRaster + get2D();
+		}
 		return cs;
 	}
 
 	void ASampler::startPixel(const AVector2i &p)
 	{
 		m_currentPixel = p;
-		m_currentPixelSampleIndex = 0;
+		m_currentPixelSampleIndex = m_firstSampleNumber;
 		// Reset array offsets for next pixel sample
 		m_array1DOffset = m_array2DOffset = 0;
 	}
@@ -31,7 +85,16 @@ namespace Aurora
 	{
 		// Reset array offsets for next pixel sample
 		m_array1DOffset = m_array2DOffset = 0;
-		return ++m_currentPixelSampleIndex < samplesPerPixel;
+		return ++m_currentPixelSampleIndex < m_endSampleNumber;
+	}
+
+	void ASampler::setSampleRange(int64_t first, int64_t end)
+	{
+		CHECK_GE(first, 0);
+		CHECK_LT(first, end);
+		CHECK_LE(end, samplesPerPixel);
+		m_firstSampleNumber = first;
+		m_endSampleNumber = end;
 	}
 
 	bool ASampler::setSampleNumber(int64_t sampleNum)
@@ -42,36 +105,46 @@ namespace Aurora
 		return m_currentPixelSampleIndex < samplesPerPixel;
 	}
 
+	// Number of Floats per cache line, the arrays are padded to whole cache lines
+	static constexpr size_t aFloatsPerCacheLine = AURORA_L1_CACHE_LINE_SIZE / sizeof(Float);
+
+	static size_t roundUpToCacheLine(size_t n)
+	{
+		return (n + aFloatsPerCacheLine - 1) / aFloatsPerCacheLine * aFloatsPerCacheLine;
+	}
+
 	void ASampler::request1DArray(int n)
 	{
 		CHECK_EQ(roundCount(n), n);
 		m_samples1DArraySizes.push_back(n);
-		m_sampleArray1D.push_back(std::vector<Float>(n * samplesPerPixel));
+		m_sampleArray1DOffsets.push_back(m_sampleArraysSize);
+		allocateSampleArrays(m_sampleArraysSize + roundUpToCacheLine(n * samplesPerPixel));
 	}
 
 	void ASampler::request2DArray(int n)
 	{
 		CHECK_EQ(roundCount(n), n);
 		m_samples2DArraySizes.push_back(n);
-		m_sampleArray2D.push_back(std::vector<AVector2f>(n * samplesPerPixel));
+		m_sampleArray2DOffsets.push_back(m_sampleArraysSize);
+		allocateSampleArrays(m_sampleArraysSize + roundUpToCacheLine(2 * n * samplesPerPixel));
 	}
 
 	const Float *ASampler::get1DArray(int n)
 	{
-		if (m_array1DOffset == m_sampleArray1D.size())
+		if (m_array1DOffset == m_samples1DArraySizes.size())
 			return nullptr;
 		CHECK_EQ(m_samples1DArraySizes[m_array1DOffset], n);
 		CHECK_LT(m_currentPixelSampleIndex, samplesPerPixel);
-		return &m_sampleArray1D[m_array1DOffset++][m_currentPixelSampleIndex * n];
+		return sampleArray1D(m_array1DOffset++) + m_currentPixelSampleIndex * n;
 	}
 
 	const AVector2f *ASampler::get2DArray(int n)
 	{
-		if (m_array2DOffset == m_sampleArray2D.size())
+		if (m_array2DOffset == m_samples2DArraySizes.size())
 			return nullptr;
 		CHECK_EQ(m_samples2DArraySizes[m_array2DOffset], n);
 		CHECK_LT(m_currentPixelSampleIndex, samplesPerPixel);
-		return &m_sampleArray2D[m_array2DOffset++][m_currentPixelSampleIndex * n];
+		return sampleArray2D(m_array2DOffset++) + m_currentPixelSampleIndex * n;
 	}
 
 	//-------------------------------------------SamplingAlgorithm-------------------------------------
@@ -145,4 +218,25 @@ namespace Aurora
 		return AVector2f(1 - su0, u[1] * su0);
 	}
 
+	void latinHypercube(AVector2f *samples, int n, ASampler &sampler)
+	{
+		// Jitter the points within the strata of the diagonal, then shuffle both dimensions
+		// so that the sample order doesn't correlate with the strata
+		Float invN = (Float)1 / n;
+		for (int i = 0; i < n; ++i)
+		{
+			AVector2f u = sampler.get2D();
+			samples[i] = AVector2f(glm::min((i + u.x) * invN, aOneMinusEpsilon),
+				glm::min((i + u.y) * invN, aOneMinusEpsilon));
+		}
+		for (int dim = 0; dim < 2; ++dim)
+		{
+			for (int i = n - 1; i > 0; --i)
+			{
+				int other = glm::min((int)(sampler.get1D() * (i + 1)), i);
+				std::swap(samples[i][dim], samples[other][dim]);
+			}
+		}
+	}
+
 }
\ No newline at end of file
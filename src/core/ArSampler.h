@@ -10,6 +10,8 @@
 
 namespace Aurora
 {
+	class AFilterSampler;
+
 	class ASampler : public AObject
 	{
 	public:
@@ -18,11 +20,15 @@ namespace Aurora
 		virtual ~ASampler();
 		ASampler(const APropertyList &props);
 		ASampler(int64_t samplesPerPixel);
+		ASampler(const ASampler &other);
+		ASampler &operator=(const ASampler &) = delete;
 
 		virtual void startPixel(const AVector2i &p);
 		virtual Float get1D() = 0;
 		virtual AVector2f get2D() = 0;
-		ACameraSample getCameraSample(const AVector2i &pRaster);
+		//Note: with a filter sampler the film position is offset from the pixel center by a
+		//      sample of the filter, otherwise it's uniform over the pixel
+		ACameraSample getCameraSample(const AVector2i &pRaster, const AFilterSampler *filterSampler = nullptr);
 
 		void request1DArray(int n);
 		void request2DArray(int n);
@@ -38,22 +44,58 @@ namespace Aurora
 		virtual bool setSampleNumber(int64_t sampleNum);
 
 		int64_t currentSampleNumber() const { return m_currentPixelSampleIndex; }
+		const AVector2i &getCurrentPixel() const { return m_currentPixel; }
 
 		int64_t getSamplingNumber() const { return samplesPerPixel; }
 
+		//Note: restrict every pixel to the sample numbers [first, end), startPixel() begins at first.
+		//      Progressive rendering takes the samples of a pixel in several passes this way
+		void setSampleRange(int64_t first, int64_t end);
+		int64_t getFirstSampleNumber() const { return m_firstSampleNumber; }
+		int64_t getEndSampleNumber() const { return m_endSampleNumber; }
+
+		//Note: in adaptive mode a pixel takes between getMinSamplingNumber() and getSamplingNumber()
+		//      samples, it stops once the relative error of its estimate falls below the threshold,
+		//      and a tile never takes more than getTargetSamplingNumber() samples per pixel in total
+		bool isAdaptive() const { return m_adaptive; }
+		int64_t getMinSamplingNumber() const { return m_minSamplesPerPixel; }
+		int64_t getTargetSamplingNumber() const { return m_targetSamplesPerPixel; }
+		Float getAdaptiveThreshold() const { return m_adaptiveThreshold; }
+
 		virtual AClassType getClassType() const override { return AClassType::AESampler; }
 
 		const int64_t samplesPerPixel; //Number of sampling per pixel
 
 	protected:
+		bool m_adaptive = false;
+		int64_t m_minSamplesPerPixel, m_targetSamplesPerPixel;
+		Float m_adaptiveThreshold = 0;
+
 		AVector2i m_currentPixel;
 		int64_t m_currentPixelSampleIndex;
+		int64_t m_firstSampleNumber, m_endSampleNumber;
 		std::vector<int> m_samples1DArraySizes, m_samples2DArraySizes;
-		std::vector<std::vector<Float>> m_sampleArray1D;
-		std::vector<std::vector<AVector2f>> m_sampleArray2D;
+
+		//Note: the sample arrays of all the samples of a pixel, array i holds
+		//      m_samplesXDArraySizes[i] * samplesPerPixel values
+		size_t numSampleArrays1D() const { return m_samples1DArraySizes.size(); }
+		size_t numSampleArrays2D() const { return m_samples2DArraySizes.size(); }
+		size_t sampleArray1DSize(size_t i) const { return (size_t)m_samples1DArraySizes[i] * samplesPerPixel; }
+		size_t sampleArray2DSize(size_t i) const { return (size_t)m_samples2DArraySizes[i] * samplesPerPixel; }
+		Float *sampleArray1D(size_t i) { return m_sampleArrays + m_sampleArray1DOffsets[i]; }
+		AVector2f *sampleArray2D(size_t i) { return (AVector2f*)(m_sampleArrays + m_sampleArray2DOffsets[i]); }
 
 	private:
-		size_t m_array1DOffset, m_array2DOffset;
+		void allocateSampleArrays(size_t size);
+
+		size_t m_array1DOffset = 0, m_array2DOffset = 0;
+
+		//Note: all the sample arrays live in one cache line aligned buffer that is allocated when
+		//      they are requested and reused for every pixel. Every array starts at a cache line,
+		//      the 2D arrays are stored as packed (x, y) pairs. The offsets are counted in Floats.
+		Float *m_sampleArrays = nullptr;
+		size_t m_sampleArraysSize = 0;
+		std::vector<size_t> m_sampleArray1DOffsets, m_sampleArray2DOffsets;
 	};
 
 	AVector3f uniformSampleHemisphere(const AVector2f &u);
@@ -70,6 +112,9 @@ namespace Aurora
 
 	AVector2f uniformSampleTriangle(const AVector2f &u);
 
+	// Fill |samples| with |n| points that are stratified along both dimensions, drawn from |sampler|
+	void latinHypercube(AVector2f *samples, int n, ASampler &sampler);
+
 	inline AVector3f cosineSampleHemisphere(const AVector2f &u)
 	{
 		AVector2f d = concentricSampleDisk(u);
@@ -14,6 +14,11 @@ namespace Aurora
 		return m_aggreShape->hit(ray);
 	}
 
+	void AScene::occluded(const ARay *rays, int nRays, bool *occluded) const
+	{
+		m_aggreShape->occluded(rays, nRays, occluded);
+	}
+
 	bool AScene::hitTr(ARay ray, ASampler &sampler, ASurfaceInteraction &isect, ASpectrum &Tr) const
 	{
 		Tr = ASpectrum(1.f);
@@ -33,6 +33,7 @@ namespace Aurora
 
 		bool hit(const ARay &ray) const;
 		bool hit(const ARay &ray, ASurfaceInteraction &isect) const;
+		void occluded(const ARay *rays, int nRays, bool *occluded) const;
 		bool hitTr(ARay ray, ASampler &sampler, ASurfaceInteraction &isect, ASpectrum &transmittance) const;
 
 		std::vector<ALight::ptr> m_lights;
@@ -46,6 +46,9 @@ namespace Aurora
 		// used in this case.
 		virtual Float solidAngle(const AVector3f &p, int nSamples = 512) const;
 
+		// Bounds the surface normals of the shape in world space
+		virtual ADirectionCone normalBounds() const { return ADirectionCone::entireSphere(); }
+
 		virtual AClassType getClassType() const override { return AClassType::AEShape; }
 
 		ATransform *m_objectToWorld = nullptr, *m_worldToObject = nullptr;
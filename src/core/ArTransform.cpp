@@ -103,6 +103,7 @@ namespace Aurora
 		// Transform remaining members of _SurfaceInteraction_
 		const ATransform &trans = *this;
 		ret.n = normalize(trans(si.n, 0.0f));
+		ret.ng = normalize(trans(si.ng, 0.0f));
 		ret.wo = normalize(trans(si.wo, 0.0f));
 		ret.uv = si.uv;
 		ret.shape = si.shape;
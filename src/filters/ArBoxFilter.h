@@ -14,6 +14,8 @@ namespace Aurora
 
 		virtual Float evaluate(const AVector2f &p) const override;
 
+		virtual AFilterShape getShape() const override { return AFilterShape::ABox; }
+
 		virtual std::string toString() const override { return "BoxFilter[]"; }
 
 	};
@@ -0,0 +1,22 @@
+#include "ArGaussianFilter.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(AGaussianFilter, "Gaussian")
+
+	AGaussianFilter::AGaussianFilter(const APropertyTreeNode &node) : AFilter(node.getPropertyList())
+	{
+		m_alpha = node.getPropertyList().getFloat("Alpha", 2.f);
+		m_expX = glm::exp(-m_alpha * m_radius.x * m_radius.x);
+		m_expY = glm::exp(-m_alpha * m_radius.y * m_radius.y);
+		activate();
+	}
+
+	AGaussianFilter::AGaussianFilter(const AVector2f &radius, Float alpha) : AFilter(radius), m_alpha(alpha),
+		m_expX(glm::exp(-alpha * radius.x * radius.x)), m_expY(glm::exp(-alpha * radius.y * radius.y)) {}
+
+	Float AGaussianFilter::evaluate(const AVector2f &p) const
+	{
+		return gaussian(p.x, m_expX) * gaussian(p.y, m_expY);
+	}
+}
\ No newline at end of file
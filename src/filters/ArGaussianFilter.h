@@ -0,0 +1,34 @@
+#ifndef ARGAUSSIANFILTER_H
+#define ARGAUSSIANFILTER_H
+
+#include "ArFilter.h"
+
+namespace Aurora
+{
+	//Note: a gaussian exp(-alpha * x^2) per axis, shifted down by its value at the radius so
+	//      that it reaches zero there
+	class AGaussianFilter final : public AFilter
+	{
+	public:
+
+		AGaussianFilter(const APropertyTreeNode &node);
+		AGaussianFilter(const AVector2f &radius, Float alpha);
+
+		virtual Float evaluate(const AVector2f &p) const override;
+
+		virtual AFilterShape getShape() const override { return AFilterShape::ASeparable; }
+
+		virtual std::string toString() const override { return "GaussianFilter[]"; }
+
+	private:
+		Float gaussian(Float d, Float expv) const
+		{
+			return glm::max((Float)0, glm::exp(-m_alpha * d * d) - expv);
+		}
+
+		Float m_alpha;
+		Float m_expX, m_expY;
+	};
+}
+
+#endif
\ No newline at end of file
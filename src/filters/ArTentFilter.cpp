@@ -0,0 +1,16 @@
+#include "ArTentFilter.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(ATentFilter, "Tent")
+
+	ATentFilter::ATentFilter(const APropertyTreeNode &node) : AFilter(node.getPropertyList())
+	{
+		activate();
+	}
+
+	Float ATentFilter::evaluate(const AVector2f &p) const
+	{
+		return glm::max((Float)0, m_radius.x - glm::abs(p.x)) * glm::max((Float)0, m_radius.y - glm::abs(p.y));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef ARTENTFILTER_H
+#define ARTENTFILTER_H
+
+#include "ArFilter.h"
+
+namespace Aurora
+{
+	//Note: the tent (triangle) filter falls off linearly to zero at the radius along each axis
+	class ATentFilter final : public AFilter
+	{
+	public:
+
+		ATentFilter(const APropertyTreeNode &node);
+		ATentFilter(const AVector2f &radius) : AFilter(radius) {}
+
+		virtual Float evaluate(const AVector2f &p) const override;
+
+		virtual AFilterShape getShape() const override { return AFilterShape::ASeparable; }
+
+		virtual std::string toString() const override { return "TentFilter[]"; }
+
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,711 @@
+#include "ArBDPTIntegrator.h"
+
+#include "ArScene.h"
+#include "ArBSDF.h"
+#include "ArHitable.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(ABDPTIntegrator, "BDPT")
+
+	// Interpolated shading normals make the BSDF of light subpaths non-symmetric,
+	// the ratio of the cosines restores the adjoint BSDF (Veach's thesis, 5.3)
+	static Float correctShadingNormal(const ASurfaceInteraction &isect, const AVector3f &wo,
+		const AVector3f &wi, ATransportMode mode)
+	{
+		if (mode != ATransportMode::aImportance)
+			return 1;
+
+		Float num = absDot(wo, isect.n) * absDot(wi, isect.ng);
+		Float denom = absDot(wo, isect.ng) * absDot(wi, isect.n);
+		// wi is tangent to the geometric surface
+		if (denom == 0)
+			return 0;
+		return num / denom;
+	}
+
+	//-------------------------------------------AVertex-------------------------------------
+
+	AVertex AVertex::createCamera(const ACamera *camera, const ARay &ray, const ASpectrum &beta)
+	{
+		AVertex v;
+		v.type = AVertexType::AVertexCamera;
+		v.ei = AInteraction(ray.origin());
+		v.ei.n = AVector3f(0.f);
+		v.camera = camera;
+		v.beta = beta;
+		return v;
+	}
+
+	AVertex AVertex::createCamera(const ACamera *camera, const AInteraction &it, const ASpectrum &beta)
+	{
+		AVertex v;
+		v.type = AVertexType::AVertexCamera;
+		v.ei = it;
+		v.camera = camera;
+		v.beta = beta;
+		return v;
+	}
+
+	AVertex AVertex::createLight(const ALight *light, const ARay &ray, const AVector3f &nLight,
+		const ASpectrum &Le, Float pdf)
+	{
+		AVertex v;
+		v.type = AVertexType::AVertexLight;
+		v.ei = AInteraction(ray.origin());
+		v.ei.n = nLight;
+		v.light = light;
+		v.beta = Le;
+		v.pdfFwd = pdf;
+		return v;
+	}
+
+	AVertex AVertex::createLight(const ALight *light, const AInteraction &it, const ASpectrum &beta, Float pdf)
+	{
+		AVertex v;
+		v.type = AVertexType::AVertexLight;
+		v.ei = it;
+		v.light = light;
+		v.beta = beta;
+		v.pdfFwd = pdf;
+		return v;
+	}
+
+	AVertex AVertex::createEscaped(const ARay &ray, const ASpectrum &beta, Float pdf)
+	{
+		// Stands for the infinite lights in the direction of the ray
+		AVertex v;
+		v.type = AVertexType::AVertexLight;
+		v.ei = AInteraction(ray(1));
+		v.ei.n = -ray.direction();
+		v.beta = beta;
+		v.pdfFwd = pdf;
+		return v;
+	}
+
+	AVertex AVertex::createSurface(const ASurfaceInteraction &si, const ASpectrum &beta,
+		Float pdf, const AVertex &prev)
+	{
+		AVertex v;
+		v.type = AVertexType::AVertexSurface;
+		v.si = si;
+		v.beta = beta;
+		v.pdfFwd = prev.convertDensity(pdf, v);
+		return v;
+	}
+
+	bool AVertex::isConnectible() const
+	{
+		switch (type)
+		{
+		case AVertexType::AVertexLight:
+			return (light == nullptr) || (light->m_flags & (int)ALightFlags::ALightDeltaDirection) == 0;
+		case AVertexType::AVertexCamera:
+			return true;
+		case AVertexType::AVertexSurface:
+			return si.bsdf->numComponents(ABxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0;
+		}
+		LOG(FATAL) << "Unhandled vertex type in isConnectible()";
+		return false;
+	}
+
+	bool AVertex::isLight() const
+	{
+		return type == AVertexType::AVertexLight ||
+			(type == AVertexType::AVertexSurface && si.hitable->getAreaLight() != nullptr);
+	}
+
+	bool AVertex::isDeltaLight() const
+	{
+		return type == AVertexType::AVertexLight && light != nullptr && Aurora::isDeltaLight(light->m_flags);
+	}
+
+	bool AVertex::isInfiniteLight() const
+	{
+		return type == AVertexType::AVertexLight && (light == nullptr ||
+			(light->m_flags & (int)ALightFlags::ALightInfinite) ||
+			(light->m_flags & (int)ALightFlags::ALightDeltaDirection));
+	}
+
+	ASpectrum AVertex::f(const AVertex &next, ATransportMode mode) const
+	{
+		AVector3f wi = next.p() - p();
+		if (lengthSquared(wi) == 0)
+			return 0.f;
+		wi = normalize(wi);
+
+		if (type == AVertexType::AVertexSurface)
+			return si.bsdf->f(si.wo, wi) * correctShadingNormal(si, si.wo, wi, mode);
+
+		LOG(FATAL) << "Vertex::f(): Unimplemented";
+		return 0.f;
+	}
+
+	ASpectrum AVertex::Le(const AScene &scene, const AVertex &v) const
+	{
+		if (!isLight())
+			return 0.f;
+
+		AVector3f w = v.p() - p();
+		if (lengthSquared(w) == 0)
+			return 0.f;
+		w = normalize(w);
+
+		if (isInfiniteLight())
+		{
+			// Return emitted radiance for infinite light sources
+			ASpectrum Le(0.f);
+			for (const auto &light : scene.m_infiniteLights)
+				Le += light->Le(ARay(p(), -w));
+			return Le;
+		}
+
+		return si.Le(w);
+	}
+
+	Float AVertex::convertDensity(Float pdf, const AVertex &next) const
+	{
+		// Return solid angle density if _next_ is an infinite area light
+		if (next.isInfiniteLight())
+			return pdf;
+
+		AVector3f w = next.p() - p();
+		if (lengthSquared(w) == 0)
+			return 0;
+
+		Float invDist2 = 1 / lengthSquared(w);
+		if (next.isOnSurface())
+			pdf *= absDot(next.n(), w * glm::sqrt(invDist2));
+		return pdf * invDist2;
+	}
+
+	Float AVertex::pdf(const AScene &scene, const AVertex *prev, const AVertex &next) const
+	{
+		if (type == AVertexType::AVertexLight)
+			return pdfLight(scene, next);
+
+		// Compute directions to preceding and next vertex
+		AVector3f wn = next.p() - p();
+		if (lengthSquared(wn) == 0)
+			return 0;
+		wn = normalize(wn);
+
+		AVector3f wp;
+		if (prev != nullptr)
+		{
+			wp = prev->p() - p();
+			if (lengthSquared(wp) == 0)
+				return 0;
+			wp = normalize(wp);
+		}
+		else
+		{
+			CHECK(type == AVertexType::AVertexCamera);
+		}
+
+		// Compute directional density depending on the vertex types
+		Float pdf = 0, unused;
+		if (type == AVertexType::AVertexCamera)
+		{
+			camera->pdf_We(ei.spawnRay(wn), unused, pdf);
+		}
+		else
+		{
+			pdf = si.bsdf->pdf(wp, wn);
+		}
+
+		// Return probability per unit area at vertex _next_
+		return convertDensity(pdf, next);
+	}
+
+	Float AVertex::pdfLight(const AScene &scene, const AVertex &v) const
+	{
+		AVector3f w = v.p() - p();
+		Float invDist2 = 1 / lengthSquared(w);
+		w *= glm::sqrt(invDist2);
+
+		Float pdf;
+		if (isInfiniteLight())
+		{
+			// Compute planar sampling density for infinite light sources
+			AVector3f worldCenter;
+			Float worldRadius;
+			scene.worldBound().boundingSphere(&worldCenter, &worldRadius);
+			pdf = 1 / (aPi * worldRadius * worldRadius);
+		}
+		else
+		{
+			// Get pointer _light_ to the light source at the vertex
+			CHECK(isLight());
+			const ALight *vertexLight = (type == AVertexType::AVertexLight) ? light : si.hitable->getAreaLight();
+			CHECK(vertexLight != nullptr);
+
+			// Compute sampling density for non-infinite light sources
+			Float pdfPos, pdfDir;
+			vertexLight->pdf_Le(ARay(p(), w), n(), pdfPos, pdfDir);
+			pdf = pdfDir * invDist2;
+		}
+
+		if (v.isOnSurface())
+			pdf *= absDot(v.n(), w);
+		return pdf;
+	}
+
+	Float AVertex::pdfLightOrigin(const AScene &scene, const AVertex &v, const ALightDistribution &lightDistrib) const
+	{
+		AVector3f w = v.p() - p();
+		if (lengthSquared(w) == 0)
+			return 0.;
+		w = normalize(w);
+
+		if (isInfiniteLight())
+		{
+			// Return solid angle density for infinite light sources
+			Float pdf = 0;
+			for (const auto &light : scene.m_infiniteLights)
+			{
+				pdf += light->pdf_Li(AInteraction(p(), -w), -w) *
+					lightDistrib.pmf(p(), n(), lightDistrib.lightIndex(light.get()));
+			}
+			return pdf;
+		}
+
+		// Get pointer _light_ to the light source at the vertex
+		CHECK(isLight());
+		const ALight *vertexLight = (type == AVertexType::AVertexLight) ? light : si.hitable->getAreaLight();
+		CHECK(vertexLight != nullptr);
+
+		// Compute the discrete probability of sampling _light_, _pdfChoice_
+		Float pdfChoice = lightDistrib.pmf(p(), n(), lightDistrib.lightIndex(vertexLight));
+
+		// Compute the origin density for non-infinite light sources
+		Float pdfPos, pdfDir;
+		vertexLight->pdf_Le(ARay(p(), w), n(), pdfPos, pdfDir);
+		return pdfPos * pdfChoice;
+	}
+
+	//-------------------------------------------Subpaths-------------------------------------
+
+	// Extend |path| by sampling the BSDF at the surfaces hit by |ray|, returns the number of vertices
+	static int randomWalk(const AScene &scene, ARay ray, ASampler &sampler, MemoryArena &arena,
+		ASpectrum beta, Float pdf, int maxDepth, ATransportMode mode, AVertex *path)
+	{
+		if (maxDepth == 0)
+			return 0;
+
+		int bounces = 0;
+		// Declare variables for forward and reverse probability densities
+		Float pdfFwd = pdf, pdfRev = 0;
+		while (true)
+		{
+			// Trace a ray and sample the next vertex
+			ASurfaceInteraction isect;
+			bool hit = scene.hit(ray, isect);
+
+			AVertex &vertex = path[bounces], &prev = path[bounces - 1];
+			if (!hit)
+			{
+				// Capture escaped rays when tracing from the camera
+				if (mode == ATransportMode::aRadiance)
+				{
+					vertex = AVertex::createEscaped(ray, beta, pdfFwd);
+					++bounces;
+				}
+				break;
+			}
+
+			// Skip over surfaces without a bsdf, they only bound participating media
+			isect.computeScatteringFunctions(ray, arena, true, mode);
+			if (!isect.bsdf)
+			{
+				ray = isect.spawnRay(ray.direction());
+				continue;
+			}
+
+			// Initialize _vertex_ with surface intersection information
+			vertex = AVertex::createSurface(isect, beta, pdfFwd, prev);
+			if (++bounces >= maxDepth)
+				break;
+
+			// Sample BSDF at current vertex and compute reverse probability
+			AVector3f wi, wo = isect.wo;
+			ABxDFType type;
+			ASpectrum f = isect.bsdf->sample_f(wo, wi, sampler.get2D(), pdfFwd, type, BSDF_ALL);
+			if (f.isBlack() || pdfFwd == 0.f)
+				break;
+
+			beta *= f * absDot(wi, isect.n) / pdfFwd;
+			beta *= correctShadingNormal(isect, wo, wi, mode);
+			pdfRev = isect.bsdf->pdf(wi, wo, BSDF_ALL);
+			if (type & BSDF_SPECULAR)
+			{
+				vertex.delta = true;
+				pdfRev = pdfFwd = 0;
+			}
+
+			ray = isect.spawnRay(wi);
+
+			// Compute reverse area density at preceding vertex
+			prev.pdfRev = vertex.convertDensity(pdfRev, prev);
+		}
+		return bounces;
+	}
+
+	int generateCameraSubpath(const AScene &scene, ASampler &sampler, MemoryArena &arena,
+		int maxDepth, const ACamera &camera, const ARay &ray, AVertex *path)
+	{
+		if (maxDepth == 0)
+			return 0;
+
+		// Generate first vertex on camera subpath and start random walk
+		ASpectrum beta(1.f);
+		path[0] = AVertex::createCamera(&camera, ray, beta);
+
+		Float pdfPos, pdfDir;
+		camera.pdf_We(ray, pdfPos, pdfDir);
+		return randomWalk(scene, ray, sampler, arena, beta, pdfDir, maxDepth - 1,
+			ATransportMode::aRadiance, path + 1) + 1;
+	}
+
+	int generateLightSubpath(const AScene &scene, ASampler &sampler, MemoryArena &arena,
+		int maxDepth, const ALightDistribution &lightDistrib, AVertex *path)
+	{
+		if (maxDepth == 0)
+			return 0;
+
+		// Sample initial ray for light subpath
+		Float lightPdf;
+		int lightNum = lightDistrib.sample(sampler.get1D(), AVector3f(0.f), AVector3f(0.f), lightPdf);
+		if (lightNum < 0 || lightPdf == 0)
+			return 0;
+
+		const ALight *light = scene.m_lights[lightNum].get();
+		AVector2f u1 = sampler.get2D();
+		AVector2f u2 = sampler.get2D();
+
+		ARay ray;
+		AVector3f nLight;
+		Float pdfPos, pdfDir;
+		ASpectrum Le = light->sample_Le(u1, u2, ray, nLight, pdfPos, pdfDir);
+		if (pdfPos == 0 || pdfDir == 0 || Le.isBlack())
+			return 0;
+
+		// Generate first vertex on light subpath and start random walk
+		path[0] = AVertex::createLight(light, ray, nLight, Le, pdfPos * lightPdf);
+		ASpectrum beta = Le * absDot(nLight, ray.direction()) / (lightPdf * pdfPos * pdfDir);
+		int nVertices = randomWalk(scene, ray, sampler, arena, beta, pdfDir, maxDepth - 1,
+			ATransportMode::aImportance, path + 1);
+
+		// Correct subpath sampling densities for infinite area lights
+		if (path[0].isInfiniteLight())
+		{
+			// Set spatial density of _path[1]_ for infinite area light
+			if (nVertices > 0)
+			{
+				path[1].pdfFwd = pdfPos;
+				if (path[1].isOnSurface())
+					path[1].pdfFwd *= absDot(ray.direction(), path[1].n());
+			}
+
+			// Set spatial density of _path[0]_ for infinite area light
+			path[0].pdfFwd = path[0].pdfLightOrigin(scene, path[1], lightDistrib);
+		}
+		return nVertices + 1;
+	}
+
+	//-------------------------------------------Connection-------------------------------------
+
+	// Assign a value to a variable for the lifetime of the object
+	template <typename Type>
+	class AScopedAssignment
+	{
+	public:
+		AScopedAssignment(Type *target = nullptr, Type value = Type()) : m_target(target)
+		{
+			if (m_target)
+			{
+				m_backup = *m_target;
+				*m_target = value;
+			}
+		}
+
+		~AScopedAssignment()
+		{
+			if (m_target)
+				*m_target = m_backup;
+		}
+
+		AScopedAssignment(const AScopedAssignment &) = delete;
+		AScopedAssignment &operator=(const AScopedAssignment &) = delete;
+
+		AScopedAssignment &operator=(AScopedAssignment &&other)
+		{
+			if (m_target)
+				*m_target = m_backup;
+			m_target = other.m_target;
+			m_backup = other.m_backup;
+			other.m_target = nullptr;
+			return *this;
+		}
+
+	private:
+		Type *m_target;
+		Type m_backup;
+	};
+
+	static Float G(const AScene &scene, const AVertex &v0, const AVertex &v1)
+	{
+		AVector3f d = v0.p() - v1.p();
+		Float g = 1 / lengthSquared(d);
+		d *= glm::sqrt(g);
+		if (v0.isOnSurface())
+			g *= absDot(v0.n(), d);
+		if (v1.isOnSurface())
+			g *= absDot(v1.n(), d);
+
+		AVisibilityTester vis(v0.getInteraction(), v1.getInteraction());
+		return vis.unoccluded(scene) ? g : 0;
+	}
+
+	// Balance heuristic weight of the strategy with |s| light and |t| camera vertices, computed
+	// from the ratios of the densities of the other strategies that create the same path
+	static Float MISWeight(const AScene &scene, AVertex *lightVertices, AVertex *cameraVertices,
+		AVertex &sampled, int s, int t, const ALightDistribution &lightDistrib)
+	{
+		if (s + t == 2)
+			return 1;
+
+		Float sumRi = 0;
+		// Define helper function _remap0_ that deals with Dirac delta functions
+		auto remap0 = [](Float f) -> Float { return f != 0 ? f : 1; };
+
+		// Temporarily update vertex properties for current strategy
+
+		// Look up connection vertices and their predecessors
+		AVertex *qs = s > 0 ? &lightVertices[s - 1] : nullptr;
+		AVertex *pt = t > 0 ? &cameraVertices[t - 1] : nullptr;
+		AVertex *qsMinus = s > 1 ? &lightVertices[s - 2] : nullptr;
+		AVertex *ptMinus = t > 1 ? &cameraVertices[t - 2] : nullptr;
+
+		// Update sampled vertex for $s=1$ or $t=1$ strategy
+		AScopedAssignment<AVertex> a1;
+		if (s == 1)
+			a1 = AScopedAssignment<AVertex>(qs, sampled);
+		else if (t == 1)
+			a1 = AScopedAssignment<AVertex>(pt, sampled);
+
+		// Mark connection vertices as non-degenerate
+		AScopedAssignment<bool> a2, a3;
+		if (pt)
+			a2 = AScopedAssignment<bool>(&pt->delta, false);
+		if (qs)
+			a3 = AScopedAssignment<bool>(&qs->delta, false);
+
+		// Update reverse density of vertex $\pt{}_{t-1}$
+		AScopedAssignment<Float> a4;
+		if (pt)
+		{
+			a4 = AScopedAssignment<Float>(&pt->pdfRev, s > 0 ? qs->pdf(scene, qsMinus, *pt)
+				: pt->pdfLightOrigin(scene, *ptMinus, lightDistrib));
+		}
+
+		// Update reverse density of vertex $\pt{}_{t-2}$
+		AScopedAssignment<Float> a5;
+		if (ptMinus)
+		{
+			a5 = AScopedAssignment<Float>(&ptMinus->pdfRev, s > 0 ? pt->pdf(scene, qs, *ptMinus)
+				: pt->pdfLight(scene, *ptMinus));
+		}
+
+		// Update reverse density of vertices $\pq{}_{s-1}$ and $\pq{}_{s-2}$
+		AScopedAssignment<Float> a6;
+		if (qs)
+			a6 = AScopedAssignment<Float>(&qs->pdfRev, pt->pdf(scene, ptMinus, *qs));
+		AScopedAssignment<Float> a7;
+		if (qsMinus)
+			a7 = AScopedAssignment<Float>(&qsMinus->pdfRev, qs->pdf(scene, pt, *qsMinus));
+
+		// Consider hypothetical connection strategies along the camera subpath
+		Float ri = 1;
+		for (int i = t - 1; i > 0; --i)
+		{
+			ri *= remap0(cameraVertices[i].pdfRev) / remap0(cameraVertices[i].pdfFwd);
+			if (!cameraVertices[i].delta && !cameraVertices[i - 1].delta)
+				sumRi += ri;
+		}
+
+		// Consider hypothetical connection strategies along the light subpath
+		ri = 1;
+		for (int i = s - 1; i >= 0; --i)
+		{
+			ri *= remap0(lightVertices[i].pdfRev) / remap0(lightVertices[i].pdfFwd);
+			bool deltaLightvertex = i > 0 ? lightVertices[i - 1].delta : lightVertices[0].isDeltaLight();
+			if (!lightVertices[i].delta && !deltaLightvertex)
+				sumRi += ri;
+		}
+		return 1 / (1 + sumRi);
+	}
+
+	ASpectrum connectBDPT(const AScene &scene, AVertex *lightVertices, AVertex *cameraVertices,
+		int s, int t, const ALightDistribution &lightDistrib, const ACamera &camera, ASampler &sampler,
+		AVector2f &pRaster, Float *misWeightPtr)
+	{
+		ASpectrum L(0.f);
+		// Ignore invalid connections related to infinite area lights
+		if (t > 1 && s != 0 && cameraVertices[t - 1].type == AVertexType::AVertexLight)
+			return 0.f;
+
+		// Perform connection and write contribution to _L_
+		AVertex sampled;
+		if (s == 0)
+		{
+			// Interpret the camera subpath as a complete path
+			const AVertex &pt = cameraVertices[t - 1];
+			if (pt.isLight())
+				L = pt.Le(scene, cameraVertices[t - 2]) * pt.beta;
+			DCHECK(!L.hasNaNs());
+		}
+		else if (t == 1)
+		{
+			// Sample a point on the camera and connect it to the light subpath
+			const AVertex &qs = lightVertices[s - 1];
+			if (qs.isConnectible())
+			{
+				AVisibilityTester vis;
+				AVector3f wi;
+				Float pdf;
+				ASpectrum Wi = camera.sample_Wi(qs.getInteraction(), sampler.get2D(), wi, pdf, pRaster, vis);
+				if (pdf > 0 && !Wi.isBlack())
+				{
+					// Initialize dynamically sampled vertex and _L_ for $t=1$ case
+					sampled = AVertex::createCamera(&camera, vis.P1(), Wi / pdf);
+					L = qs.beta * qs.f(sampled, ATransportMode::aImportance) * sampled.beta;
+					if (qs.isOnSurface())
+						L *= absDot(wi, qs.n());
+					DCHECK(!L.hasNaNs());
+					// Only check visibility after we know that the path would
+					// make a non-zero contribution.
+					if (!L.isBlack() && !vis.unoccluded(scene))
+						L = 0.f;
+				}
+			}
+		}
+		else if (s == 1)
+		{
+			// Sample a point on a light and connect it to the camera subpath
+			const AVertex &pt = cameraVertices[t - 1];
+			if (pt.isConnectible())
+			{
+				Float lightPdf;
+				int lightNum = lightDistrib.sample(sampler.get1D(), pt.p(), pt.n(), lightPdf);
+				AVector2f uLight = sampler.get2D();
+				if (lightNum >= 0 && lightPdf > 0)
+				{
+					const ALight *light = scene.m_lights[lightNum].get();
+					AVisibilityTester vis;
+					AVector3f wi;
+					Float pdf;
+					ASpectrum lightWeight = light->sample_Li(pt.getInteraction(), uLight, wi, pdf, vis);
+					if (pdf > 0 && !lightWeight.isBlack())
+					{
+						sampled = AVertex::createLight(light, vis.P1(), lightWeight / (pdf * lightPdf), 0);
+						sampled.pdfFwd = sampled.pdfLightOrigin(scene, pt, lightDistrib);
+						L = pt.beta * pt.f(sampled, ATransportMode::aRadiance) * sampled.beta;
+						if (pt.isOnSurface())
+							L *= absDot(wi, pt.n());
+						// Only check visibility if the path would carry radiance.
+						if (!L.isBlack() && !vis.unoccluded(scene))
+							L = 0.f;
+					}
+				}
+			}
+		}
+		else
+		{
+			// Handle all other bidirectional connection cases
+			const AVertex &qs = lightVertices[s - 1], &pt = cameraVertices[t - 1];
+			if (qs.isConnectible() && pt.isConnectible())
+			{
+				L = qs.beta * qs.f(pt, ATransportMode::aImportance) * pt.f(qs, ATransportMode::aRadiance) * pt.beta;
+				if (!L.isBlack())
+					L *= G(scene, qs, pt);
+			}
+		}
+
+		// Compute MIS weight for connection strategy
+		Float misWeight = L.isBlack() ? 0.f : MISWeight(scene, lightVertices, cameraVertices,
+			sampled, s, t, lightDistrib);
+		DCHECK(!glm::isnan(misWeight));
+		L *= misWeight;
+		if (misWeightPtr != nullptr)
+			*misWeightPtr = misWeight;
+		return L;
+	}
+
+	//-------------------------------------------ABDPTIntegrator-------------------------------------
+
+	ABDPTIntegrator::ABDPTIntegrator(const APropertyTreeNode &node)
+		: ASamplerIntegrator(nullptr, nullptr), m_maxDepth(node.getPropertyList().getInteger("Depth", 5))
+	{
+		//Sampler
+		const auto &samplerNode = node.getPropertyChild("Sampler");
+		m_sampler = ASampler::ptr(static_cast<ASampler*>(AObjectFactory::createInstance(
+			samplerNode.getTypeName(), samplerNode)));
+
+		//Camera
+		const auto &cameraNode = node.getPropertyChild("Camera");
+		m_camera = ACamera::ptr(static_cast<ACamera*>(AObjectFactory::createInstance(
+			cameraNode.getTypeName(), cameraNode)));
+
+		activate();
+	}
+
+	ABDPTIntegrator::ABDPTIntegrator(int maxDepth, ACamera::ptr camera, ASampler::ptr sampler)
+		: ASamplerIntegrator(camera, sampler), m_maxDepth(maxDepth) {}
+
+	void ABDPTIntegrator::preprocess(const AScene &scene)
+	{
+		//Note: the origins of light subpaths don't depend on a shading point, the vertices
+		//      that connect to a light sample use the same distribution for consistent MIS
+		m_lightDistribution = createLightSampleDistribution("power", scene);
+	}
+
+	ASpectrum ABDPTIntegrator::Li(const ARay &ray, const AScene &scene, ASampler &sampler,
+		MemoryArena &arena, int depth) const
+	{
+		// Trace the camera and light subpaths
+		AVertex *cameraVertices = arena.Alloc<AVertex>(m_maxDepth + 2);
+		AVertex *lightVertices = arena.Alloc<AVertex>(m_maxDepth + 1);
+		int nCamera = generateCameraSubpath(scene, sampler, arena, m_maxDepth + 2,
+			*m_camera, ray, cameraVertices);
+		int nLight = generateLightSubpath(scene, sampler, arena, m_maxDepth + 1,
+			*m_lightDistribution, lightVertices);
+
+		// Execute all BDPT connection strategies
+		ASpectrum L(0.f);
+		for (int t = 1; t <= nCamera; ++t)
+		{
+			for (int s = 0; s <= nLight; ++s)
+			{
+				int pathDepth = t + s - 2;
+				if ((s == 1 && t == 1) || pathDepth < 0 || pathDepth > m_maxDepth)
+					continue;
+
+				// Execute the $(s, t)$ connection strategy and update _L_
+				AVector2f pFilmNew;
+				ASpectrum Lpath = connectBDPT(scene, lightVertices, cameraVertices, s, t,
+					*m_lightDistribution, *m_camera, sampler, pFilmNew);
+				if (t != 1)
+				{
+					L += Lpath;
+				}
+				else if (!Lpath.isBlack())
+				{
+					m_camera->m_film->addSplat(pFilmNew, Lpath);
+				}
+			}
+		}
+		return L;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef ARBDPT_INTEGRATOR_H
+#define ARBDPT_INTEGRATOR_H
+
+#include "ArAurora.h"
+#include "ArMathUtils.h"
+#include "ArIntegrator.h"
+#include "ArInteraction.h"
+#include "ArLightDistrib.h"
+#include "ArLight.h"
+
+namespace Aurora
+{
+	enum class AVertexType : int { AVertexCamera, AVertexLight, AVertexSurface };
+
+	//Note: a vertex of a camera or light subpath. The endpoints keep the camera or light that
+	//      created them, a light vertex without a light was created by a ray escaping the scene.
+	//      The densities of sampling the vertex from either end of the path are stored per unit
+	//      area so that the MIS weights of all the connection strategies can be computed.
+	struct AVertex
+	{
+		AVertexType type = AVertexType::AVertexSurface;
+		ASpectrum beta;					//throughput from the start of the subpath
+		AInteraction ei;				//endpoint interaction of camera and light vertices
+		ASurfaceInteraction si;			//surface vertices
+		const ACamera *camera = nullptr;
+		const ALight *light = nullptr;
+		bool delta = false;				//sampled by a specular lobe
+		Float pdfFwd = 0, pdfRev = 0;	//area densities of sampling the vertex forwards and backwards
+
+		AVertex() = default;
+
+		static AVertex createCamera(const ACamera *camera, const ARay &ray, const ASpectrum &beta);
+		static AVertex createCamera(const ACamera *camera, const AInteraction &it, const ASpectrum &beta);
+		static AVertex createLight(const ALight *light, const ARay &ray, const AVector3f &nLight,
+			const ASpectrum &Le, Float pdf);
+		static AVertex createLight(const ALight *light, const AInteraction &it, const ASpectrum &beta, Float pdf);
+		static AVertex createEscaped(const ARay &ray, const ASpectrum &beta, Float pdf);
+		static AVertex createSurface(const ASurfaceInteraction &si, const ASpectrum &beta,
+			Float pdf, const AVertex &prev);
+
+		const AInteraction &getInteraction() const { return type == AVertexType::AVertexSurface ? si : ei; }
+		const AVector3f &p() const { return getInteraction().p; }
+		const AVector3f &n() const { return getInteraction().n; }
+		bool isOnSurface() const { return n() != AVector3f(0.f); }
+
+		bool isConnectible() const;
+		bool isLight() const;
+		bool isDeltaLight() const;
+		bool isInfiniteLight() const;
+
+		ASpectrum f(const AVertex &next, ATransportMode mode) const;
+
+		// Emitted radiance towards |v|
+		ASpectrum Le(const AScene &scene, const AVertex &v) const;
+
+		// Turn the solid angle density of sampling |next| from this vertex into an area density
+		Float convertDensity(Float pdf, const AVertex &next) const;
+
+		// Area density of sampling |next| from this vertex, coming from |prev|
+		Float pdf(const AScene &scene, const AVertex *prev, const AVertex &next) const;
+
+		// Area density of sampling |v| by emitting from this light vertex
+		Float pdfLight(const AScene &scene, const AVertex &v) const;
+
+		// Area density of sampling this light vertex as the origin of a light subpath
+		Float pdfLightOrigin(const AScene &scene, const AVertex &v, const ALightDistribution &lightDistrib) const;
+	};
+
+	//Note: bidirectional path tracing (Veach 1997), every camera sample traces a camera subpath
+	//      and a light subpath and connects all their prefixes, the estimates of the strategies
+	//      are combined with the balance heuristic. Paths with a single camera vertex are found
+	//      by light tracing, they can end up anywhere in the image and are splatted to the film.
+	//      The light subpaths start at lights chosen proportionally to their power.
+	class ABDPTIntegrator : public ASamplerIntegrator
+	{
+	public:
+
+		ABDPTIntegrator(const APropertyTreeNode &props);
+
+		ABDPTIntegrator(int maxDepth, ACamera::ptr camera, ASampler::ptr sampler);
+
+		virtual void preprocess(const AScene &scene) override;
+
+		virtual ASpectrum Li(const ARay &ray, const AScene &scene, ASampler &sampler,
+			MemoryArena &arena, int depth) const override;
+
+		virtual std::string toString() const override { return "BDPTIntegrator[]"; }
+
+	private:
+		int m_maxDepth;
+		std::unique_ptr<ALightDistribution> m_lightDistribution;
+	};
+
+	int generateCameraSubpath(const AScene &scene, ASampler &sampler, MemoryArena &arena,
+		int maxDepth, const ACamera &camera, const ARay &ray, AVertex *path);
+
+	int generateLightSubpath(const AScene &scene, ASampler &sampler, MemoryArena &arena,
+		int maxDepth, const ALightDistribution &lightDistrib, AVertex *path);
+
+	// Connect the first |s| light vertices with the first |t| camera vertices, returns the
+	// MIS weighted contribution and the raster position of it for the light tracing strategy t = 1
+	ASpectrum connectBDPT(const AScene &scene, AVertex *lightVertices, AVertex *cameraVertices,
+		int s, int t, const ALightDistribution &lightDistrib, const ACamera &camera, ASampler &sampler,
+		AVector2f &pRaster, Float *misWeight = nullptr);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,614 @@
+#include "ArGuidedPathIntegrator.h"
+
+#include "ArScene.h"
+#include "ArBSDF.h"
+#include "ArRng.h"
+#include "ArReporter.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(AGuidedPathIntegrator, "GuidedPath")
+
+	//-------------------------------------------ADTree-------------------------------------
+
+	// Cylindrical coordinates of a direction, both in [0,1)
+	static AVector2f dirToCanonical(const AVector3f &d)
+	{
+		Float cosTheta = glm::clamp(d.z, (Float)-1, (Float)1);
+		Float phi = std::atan2(d.y, d.x);
+		if (phi < 0)
+			phi += 2 * aPi;
+		return AVector2f(
+			glm::clamp((cosTheta + 1) / 2, (Float)0, aOneMinusEpsilon),
+			glm::clamp(phi * aInv2Pi, (Float)0, aOneMinusEpsilon));
+	}
+
+	static AVector3f canonicalToDir(const AVector2f &p)
+	{
+		Float cosTheta = 2 * p.x - 1;
+		Float phi = 2 * aPi * p.y;
+		Float sinTheta = safeSqrt(1 - cosTheta * cosTheta);
+		return AVector3f(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+	}
+
+	// Quadrant of |p| in a node, |p| is remapped to the coordinates of the quadrant
+	static int childIndex(AVector2f &p)
+	{
+		int index = 0;
+		for (int dim = 0; dim < 2; ++dim)
+		{
+			if (p[dim] < 0.5f)
+			{
+				p[dim] *= 2;
+			}
+			else
+			{
+				p[dim] = (p[dim] - 0.5f) * 2;
+				index |= 1 << dim;
+			}
+		}
+		return index;
+	}
+
+	ADTree::ANode::ANode()
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			m_sum[i] = 0;
+			m_children[i] = 0;
+		}
+	}
+
+	ADTree::ANode::ANode(const ANode &other)
+	{
+		*this = other;
+	}
+
+	ADTree::ANode &ADTree::ANode::operator=(const ANode &other)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			m_sum[i] = (Float)other.m_sum[i];
+			m_children[i] = other.m_children[i];
+		}
+		return *this;
+	}
+
+	ADTree::ADTree() : m_nodes(1), m_statisticalWeight(0) {}
+
+	ADTree::ADTree(const ADTree &other) : m_nodes(other.m_nodes), m_statisticalWeight((Float)other.m_statisticalWeight) {}
+
+	ADTree &ADTree::operator=(const ADTree &other)
+	{
+		m_nodes = other.m_nodes;
+		m_statisticalWeight = (Float)other.m_statisticalWeight;
+		return *this;
+	}
+
+	void ADTree::record(const AVector3f &dir, Float radiance)
+	{
+		m_statisticalWeight.add(1);
+		if (!(radiance > 0) || std::isinf(radiance))
+			return;
+
+		AVector2f p = dirToCanonical(dir);
+		int nodeIndex = 0;
+		while (true)
+		{
+			ANode &node = m_nodes[nodeIndex];
+			int i = childIndex(p);
+			if (node.isLeaf(i))
+			{
+				node.m_sum[i].add(radiance);
+				return;
+			}
+			nodeIndex = node.m_children[i];
+		}
+	}
+
+	AVector3f ADTree::sample(const AVector2f &u) const
+	{
+		AVector2f p = u, origin(0.f);
+		Float scale = 1;
+		int nodeIndex = 0;
+		while (true)
+		{
+			// Choose the column of quadrants first and then the quadrant within it
+			const ANode &node = m_nodes[nodeIndex];
+			Float topLeft = node.m_sum[0], topRight = node.m_sum[1];
+			Float partial = topLeft + node.m_sum[2];
+			Float total = node.sum();
+
+			// Note: only happens for nodes that can't be reached by sampling
+			if (!(total > 0))
+				return canonicalToDir(origin + scale * p);
+
+			int index = 0;
+			AVector2f offset(0.f);
+			Float boundary = partial / total;
+			if (p.x < boundary)
+			{
+				p.x /= boundary;
+				boundary = topLeft / partial;
+			}
+			else
+			{
+				partial = total - partial;
+				offset.x = 0.5f;
+				p.x = (p.x - boundary) / (1 - boundary);
+				boundary = topRight / partial;
+				index |= 1;
+			}
+
+			if (p.y < boundary)
+			{
+				p.y /= boundary;
+			}
+			else
+			{
+				offset.y = 0.5f;
+				p.y = (p.y - boundary) / (1 - boundary);
+				index |= 2;
+			}
+
+			p = AVector2f(glm::min(p.x, aOneMinusEpsilon), glm::min(p.y, aOneMinusEpsilon));
+			origin += scale * offset;
+			scale *= 0.5f;
+			if (node.isLeaf(index))
+				return canonicalToDir(origin + scale * p);
+			nodeIndex = node.m_children[index];
+		}
+	}
+
+	Float ADTree::pdf(const AVector3f &dir) const
+	{
+		AVector2f p = dirToCanonical(dir);
+		Float pdf = 1;
+		int nodeIndex = 0;
+		while (true)
+		{
+			const ANode &node = m_nodes[nodeIndex];
+			Float total = node.sum();
+			int i = childIndex(p);
+			if (!(total > 0) || !(node.m_sum[i] > 0))
+				return 0;
+
+			// A quadrant covers a quarter of its parent
+			pdf *= 4 * node.m_sum[i] / total;
+			if (node.isLeaf(i))
+				return pdf * aInv4Pi;
+			nodeIndex = node.m_children[i];
+		}
+	}
+
+	void ADTree::build()
+	{
+		// Note: children are always stored after their parent
+		for (int n = (int)m_nodes.size() - 1; n >= 0; --n)
+		{
+			ANode &node = m_nodes[n];
+			for (int i = 0; i < 4; ++i)
+			{
+				if (!node.isLeaf(i))
+					node.m_sum[i] = m_nodes[node.m_children[i]].sum();
+			}
+		}
+	}
+
+	void ADTree::reset(const ADTree &previous, int maxDepth, Float subdivisionThreshold)
+	{
+		CHECK_NE(&previous, this);
+		m_nodes.clear();
+		m_nodes.emplace_back();
+		m_statisticalWeight = 0;
+
+		// Quadrants that are leaves of the previous tree are split into new nodes of this tree,
+		// which continue to be visited with a quarter of the radiance until they are fine enough
+		struct AStackNode
+		{
+			int nodeIndex;
+			const ADTree *other;
+			int otherNodeIndex;
+			int depth;
+		};
+		std::vector<AStackNode> stack;
+		stack.push_back({ 0, &previous, 0, 1 });
+
+		const Float total = previous.m_nodes[0].sum();
+		while (!stack.empty())
+		{
+			AStackNode sNode = stack.back();
+			stack.pop_back();
+			for (int i = 0; i < 4; ++i)
+			{
+				// Note: the other node may live in this tree, which grows below
+				const ANode &otherNode = sNode.other->m_nodes[sNode.otherNodeIndex];
+				Float otherSum = otherNode.m_sum[i];
+				Float fraction = (total > 0) ? (otherSum / total) : std::pow((Float)0.25f, (Float)sNode.depth);
+				if (sNode.depth < maxDepth && fraction > subdivisionThreshold)
+				{
+					int newIndex = (int)m_nodes.size();
+					if (!otherNode.isLeaf(i))
+						stack.push_back({ newIndex, sNode.other, otherNode.m_children[i], sNode.depth + 1 });
+					else
+						stack.push_back({ newIndex, this, newIndex, sNode.depth + 1 });
+
+					m_nodes[sNode.nodeIndex].m_children[i] = newIndex;
+					m_nodes.emplace_back();
+					for (int j = 0; j < 4; ++j)
+						m_nodes.back().m_sum[j] = otherSum / 4;
+				}
+			}
+		}
+
+		for (auto &node : m_nodes)
+		{
+			for (int i = 0; i < 4; ++i)
+				node.m_sum[i] = 0;
+		}
+	}
+
+	Float ADTree::mean() const
+	{
+		if (!(m_statisticalWeight > 0))
+			return 0;
+		return m_nodes[0].sum() * aInv4Pi / m_statisticalWeight;
+	}
+
+	//-------------------------------------------ASDTree-------------------------------------
+
+	ASDTree::ASDTree(const ABounds3f &bounds) : m_bounds(bounds), m_nodes(1)
+	{
+		// Cubify the bounds so that splitting along alternating axes keeps the regions cube shaped
+		Float size = maxComponent(m_bounds.diagonal());
+		m_bounds.m_pMax = m_bounds.m_pMin + AVector3f(size);
+	}
+
+	ADTreeWrapper *ASDTree::lookup(const AVector3f &p)
+	{
+		AVector3f offset = m_bounds.offset(p);
+		int nodeIndex = 0;
+		while (!m_nodes[nodeIndex].m_isLeaf)
+		{
+			const ANode &node = m_nodes[nodeIndex];
+			Float &x = offset[node.m_axis];
+			if (x < 0.5f)
+			{
+				x *= 2;
+				nodeIndex = node.m_children[0];
+			}
+			else
+			{
+				x = (x - 0.5f) * 2;
+				nodeIndex = node.m_children[1];
+			}
+		}
+		return &m_nodes[nodeIndex].m_dTree;
+	}
+
+	void ASDTree::refine(Float threshold)
+	{
+		// Note: the children appended by subdivide() are visited by the same loop
+		for (size_t i = 0; i < m_nodes.size(); ++i)
+		{
+			if (m_nodes[i].m_isLeaf && m_nodes[i].m_dTree.m_sampling.statisticalWeight() > threshold)
+				subdivide((int)i);
+		}
+	}
+
+	void ASDTree::subdivide(int nodeIndex)
+	{
+		// The children start from the distributions of their parent with half of its samples each
+		int firstChild = (int)m_nodes.size();
+		m_nodes.resize(m_nodes.size() + 2);
+		ANode &parent = m_nodes[nodeIndex];
+		for (int c = 0; c < 2; ++c)
+		{
+			ANode &child = m_nodes[firstChild + c];
+			child.m_axis = (parent.m_axis + 1) % 3;
+			child.m_dTree = parent.m_dTree;
+			child.m_dTree.m_building.setStatisticalWeight(parent.m_dTree.m_building.statisticalWeight() / 2);
+			child.m_dTree.m_sampling.setStatisticalWeight(parent.m_dTree.m_sampling.statisticalWeight() / 2);
+			parent.m_children[c] = firstChild + c;
+		}
+		parent.m_isLeaf = false;
+		parent.m_dTree = ADTreeWrapper();
+	}
+
+	size_t ASDTree::numLeaves() const
+	{
+		size_t count = 0;
+		for (const auto &node : m_nodes)
+		{
+			if (node.m_isLeaf)
+				++count;
+		}
+		return count;
+	}
+
+	//-------------------------------------------AGuidedPathIntegrator-------------------------------------
+
+	AGuidedPathIntegrator::AGuidedPathIntegrator(const APropertyTreeNode &node)
+		: ASamplerIntegrator(nullptr, nullptr), m_maxDepth(node.getPropertyList().getInteger("Depth", 2))
+		, m_rrThreshold(1.f)
+		, m_lightSampleStrategy(node.getPropertyList().getString("LightSampleStrategy", "bvh"))
+		, m_bsdfSamplingFraction(node.getPropertyList().getFloat("BSDFSamplingFraction", 0.5f))
+		, m_spatialThreshold(node.getPropertyList().getFloat("SpatialThreshold", 12000.f))
+		, m_directionalThreshold(node.getPropertyList().getFloat("DirectionalThreshold", 0.01f))
+	{
+		//Sampler
+		const auto &samplerNode = node.getPropertyChild("Sampler");
+		m_sampler = ASampler::ptr(static_cast<ASampler*>(AObjectFactory::createInstance(
+			samplerNode.getTypeName(), samplerNode)));
+
+		//Camera
+		const auto &cameraNode = node.getPropertyChild("Camera");
+		m_camera = ACamera::ptr(static_cast<ACamera*>(AObjectFactory::createInstance(
+			cameraNode.getTypeName(), cameraNode)));
+
+		// By default as many samples are spent on training as on the image
+		m_trainingSpp = node.getPropertyList().getInteger("TrainingSPP", (int)m_sampler->getSamplingNumber());
+
+		activate();
+	}
+
+	AGuidedPathIntegrator::AGuidedPathIntegrator(int maxDepth, ACamera::ptr camera, ASampler::ptr sampler,
+		int64_t trainingSpp, Float bsdfSamplingFraction, Float rrThreshold, const std::string &lightSampleStrategy)
+		: ASamplerIntegrator(camera, sampler), m_maxDepth(maxDepth), m_rrThreshold(rrThreshold),
+		m_lightSampleStrategy(lightSampleStrategy), m_trainingSpp(trainingSpp),
+		m_bsdfSamplingFraction(bsdfSamplingFraction), m_spatialThreshold(12000.f), m_directionalThreshold(0.01f) {}
+
+	void AGuidedPathIntegrator::preprocess(const AScene &scene)
+	{
+		m_lightDistribution = createLightSampleDistribution(m_lightSampleStrategy, scene);
+		m_sdTree.reset(new ASDTree(scene.worldBound()));
+
+		// The first iteration records into a uniformly subdivided directional tree
+		const Float directionalThreshold = m_directionalThreshold;
+		m_sdTree->forEachDTree([directionalThreshold](ADTreeWrapper &dTree)
+		{
+			dTree.m_building.reset(ADTree(), 20, directionalThreshold);
+		});
+	}
+
+	void AGuidedPathIntegrator::render(const AScene &scene)
+	{
+		// Every training iteration takes twice the samples of the previous one and
+		// samples the distributions learned by it, the first one only samples the BSDFs
+		const int64_t spp = m_sampler->getSamplingNumber();
+		int64_t trainedSpp = 0;
+		m_training = true;
+		for (int iteration = 0; trainedSpp < m_trainingSpp; ++iteration)
+		{
+			int64_t iterationSpp = (int64_t)1 << glm::min(iteration, 62);
+			iterationSpp = glm::min(glm::min(iterationSpp, m_trainingSpp - trainedSpp), spp);
+
+			trainingIteration(scene, iteration, iterationSpp);
+			updateSDTree(iterationSpp);
+			trainedSpp += iterationSpp;
+
+			LOG(INFO) << "Training iteration " << iteration << " with " << iterationSpp
+				<< " samples per pixel, SD-tree has " << m_sdTree->numLeaves() << " spatial leaves";
+		}
+		m_training = false;
+
+		ASamplerIntegrator::render(scene);
+	}
+
+	void AGuidedPathIntegrator::trainingIteration(const AScene &scene, int iteration, int64_t spp)
+	{
+		ABounds2i sampleBounds = m_camera->m_film->getSampleBounds();
+		AVector2i sampleExtent = sampleBounds.diagonal();
+		constexpr int tileSize = 16;
+		AVector2i nTiles((sampleExtent.x + tileSize - 1) / tileSize, (sampleExtent.y + tileSize - 1) / tileSize);
+		const int nImageTiles = nTiles.x * nTiles.y;
+
+		allocateArenas();
+
+		// Note: all the tiles are trained by every shard so that the shards learn the same distributions
+		AReporter reporter(nImageTiles, "Training");
+		AParallelUtils::parallelFor((size_t)0, (size_t)nImageTiles, [&](const size_t &t)
+		{
+			AVector2i tile(t % nTiles.x, t / nTiles.x);
+			MemoryArena &arena = *m_arenas[AParallelUtils::getThreadIndex()];
+
+			// Negative seeds keep the random number streams apart from the ones of the image
+			std::unique_ptr<ASampler> tileSampler = m_sampler->clone(-(int)(t + iteration * nImageTiles) - 1);
+			if (spp < m_sampler->getSamplingNumber())
+			{
+				tileSampler->setSampleRange(0, spp);
+			}
+
+			int x0 = sampleBounds.m_pMin.x + tile.x * tileSize;
+			int x1 = glm::min(x0 + tileSize, sampleBounds.m_pMax.x);
+			int y0 = sampleBounds.m_pMin.y + tile.y * tileSize;
+			int y1 = glm::min(y0 + tileSize, sampleBounds.m_pMax.y);
+			ABounds2i tileBounds(AVector2i(x0, y0), AVector2i(x1, y1));
+
+			for (AVector2i pixel : tileBounds)
+			{
+				tileSampler->startPixel(pixel);
+				do
+				{
+					ACameraSample cameraSample = tileSampler->getCameraSample(pixel);
+					ARay ray;
+					if (m_camera->castingRay(cameraSample, ray) > 0)
+					{
+						Li(ray, scene, *tileSampler, arena, 0);
+					}
+					arena.Reset();
+				} while (tileSampler->startNextSample());
+			}
+
+			reporter.update();
+		}, AExecutionPolicy::APARALLEL);
+		reporter.done();
+	}
+
+	void AGuidedPathIntegrator::updateSDTree(int64_t iterationSpp)
+	{
+		m_sdTree->forEachDTree([](ADTreeWrapper &dTree)
+		{
+			dTree.m_building.build();
+			dTree.m_sampling = dTree.m_building;
+		});
+
+		// The number of samples a region may take before it's split grows slower than the
+		// number of samples, so that the spatial resolution increases with every iteration
+		m_sdTree->refine(m_spatialThreshold * glm::sqrt((Float)iterationSpp));
+
+		const Float directionalThreshold = m_directionalThreshold;
+		m_sdTree->forEachDTree([directionalThreshold](ADTreeWrapper &dTree)
+		{
+			dTree.m_building.reset(dTree.m_sampling, 20, directionalThreshold);
+		});
+	}
+
+	ASpectrum AGuidedPathIntegrator::Li(const ARay &r, const AScene &scene, ASampler &sampler,
+		MemoryArena &arena, int depth) const
+	{
+		ASpectrum L(0.f), beta(1.f);
+		ARay ray(r);
+
+		bool specularBounce = false;
+		int bounces;
+		Float etaScale = 1;
+
+		// Vertices whose incident radiance is recorded into the SD-tree after the path is done,
+		// it's the radiance gathered after the vertex divided by the throughput up to it
+		struct AGuidedVertex
+		{
+			ADTreeWrapper *dTree;
+			AVector3f wi;
+			ASpectrum throughput;
+			ASpectrum L;
+			Float woPdf;
+		};
+		constexpr int maxVertices = 32;
+		AGuidedVertex vertices[maxVertices];
+		int nVertices = 0;
+
+		const ABxDFType nonSpecular = ABxDFType(BSDF_ALL & ~BSDF_SPECULAR);
+		for (bounces = 0;; ++bounces)
+		{
+			// Intersect _ray_ with scene and store intersection in _isect_
+			ASurfaceInteraction isect;
+			bool hit = scene.hit(ray, isect);
+
+			// Possibly add emitted light at intersection
+			if (bounces == 0 || specularBounce)
+			{
+				if (hit)
+				{
+					L += beta * isect.Le(-ray.direction());
+				}
+				else
+				{
+					for (const auto &light : scene.m_infiniteLights)
+						L += beta * light->Le(ray);
+				}
+			}
+
+			// Terminate path if ray escaped or _maxDepth_ was reached
+			if (!hit || bounces >= m_maxDepth)
+				break;
+
+			// Compute scattering functions and skip over medium boundaries
+			isect.computeScatteringFunctions(ray, arena, true);
+			if (!isect.bsdf)
+			{
+				ray = isect.spawnRay(ray.direction());
+				bounces--;
+				continue;
+			}
+
+			// Sample illumination from lights to find path contribution.
+			if (isect.bsdf->numComponents(nonSpecular) > 0)
+			{
+				ASpectrum Ld = beta * uniformSampleOneLight(isect, scene, arena, sampler, m_lightDistribution.get());
+				CHECK_GE(Ld.y(), 0.f);
+				L += Ld;
+			}
+
+			// Guide the non-specular vertices once the region has learned some radiance
+			ADTreeWrapper *dTree = m_sdTree->lookup(isect.p);
+			const bool guided = isect.bsdf->numComponents(nonSpecular) > 0 && dTree->m_sampling.mean() > 0;
+			const Float bsdfFraction = guided ? m_bsdfSamplingFraction : 1;
+
+			// Sample the BSDF or the learned distribution, the pdf is the one of the mixture
+			AVector3f wo = -ray.direction(), wi;
+			Float pdf;
+			ABxDFType flags;
+			ASpectrum f;
+			Float uStrategy = sampler.get1D();
+			AVector2f u = sampler.get2D();
+			if (uStrategy < bsdfFraction)
+			{
+				Float bsdfPdf;
+				f = isect.bsdf->sample_f(wo, wi, u, bsdfPdf, flags, BSDF_ALL);
+				if (f.isBlack() || bsdfPdf == 0.f)
+					break;
+
+				// The learned distribution can't sample specular lobes
+				if (flags & BSDF_SPECULAR)
+					pdf = bsdfFraction * bsdfPdf;
+				else
+					pdf = bsdfFraction * bsdfPdf + (1 - bsdfFraction) * dTree->m_sampling.pdf(wi);
+			}
+			else
+			{
+				wi = dTree->m_sampling.sample(u);
+				f = isect.bsdf->f(wo, wi);
+				flags = ABxDFType(dot(wi, isect.n) * dot(wo, isect.n) > 0 ? BSDF_REFLECTION : BSDF_TRANSMISSION);
+				pdf = bsdfFraction * isect.bsdf->pdf(wo, wi) + (1 - bsdfFraction) * dTree->m_sampling.pdf(wi);
+				if (f.isBlack() || pdf == 0.f)
+					break;
+			}
+
+			beta *= f * absDot(wi, isect.n) / pdf;
+
+			CHECK_GE(beta.y(), 0.f);
+			DCHECK(!glm::isinf(beta.y()));
+
+			specularBounce = (flags & BSDF_SPECULAR) != 0;
+			if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION))
+			{
+				Float eta = isect.bsdf->m_eta;
+				etaScale *= (dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+			}
+
+			if (m_training && !specularBounce && nVertices < maxVertices)
+			{
+				vertices[nVertices++] = { dTree, wi, beta, L, pdf };
+			}
+
+			ray = isect.spawnRay(wi);
+
+			// Possibly terminate the path with Russian roulette.
+			ASpectrum rrBeta = beta * etaScale;
+			if (rrBeta.maxComponentValue() < m_rrThreshold && bounces > 3)
+			{
+				Float q = glm::max((Float).05f, 1 - rrBeta.maxComponentValue());
+				if (sampler.get1D() < q)
+					break;
+				beta /= 1 - q;
+				DCHECK(!glm::isinf(beta.y()));
+			}
+		}
+
+		// Record the radiance that arrived at every guided vertex along its sampled direction
+		for (int i = 0; i < nVertices; ++i)
+		{
+			const AGuidedVertex &vertex = vertices[i];
+			ASpectrum incident = L - vertex.L;
+			for (int c = 0; c < ASpectrum::nSamples; ++c)
+			{
+				incident[c] = (vertex.throughput[c] > 0) ? incident[c] / vertex.throughput[c] : 0;
+			}
+			vertex.dTree->m_building.record(vertex.wi, incident.y() / vertex.woPdf);
+		}
+
+		return L;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#ifndef ARGUIDED_PATH_INTEGRATOR_H
+#define ARGUIDED_PATH_INTEGRATOR_H
+
+#include "ArAurora.h"
+#include "ArMathUtils.h"
+#include "ArIntegrator.h"
+#include "ArLightDistrib.h"
+#include "ArParallel.h"
+
+namespace Aurora
+{
+	//Note: a quadtree over the square of cylindrical coordinates (cos(theta), phi) in [0,1]^2,
+	//      which maps area to solid angle uniformly. Every node stores the radiance recorded
+	//      in its four quadrants, a quadrant without a child node is a leaf.
+	class ADTree
+	{
+	public:
+		ADTree();
+		ADTree(const ADTree &other);
+		ADTree &operator=(const ADTree &other);
+
+		// Add an estimate of the incident radiance along the world-space direction |dir|, thread safe
+		void record(const AVector3f &dir, Float radiance);
+
+		// Sample a direction proportionally to the learned radiance, only valid if mean() > 0
+		AVector3f sample(const AVector2f &u) const;
+		Float pdf(const AVector3f &dir) const;
+
+		// Sum the radiance recorded in the leaves up into the interior nodes
+		void build();
+
+		// Take the structure of |previous| and subdivide the quadrants that hold more than
+		// |subdivisionThreshold| of its radiance, up to |maxDepth| levels. The recorded radiance
+		// of the new tree is zero.
+		void reset(const ADTree &previous, int maxDepth, Float subdivisionThreshold);
+
+		Float mean() const;
+
+		Float statisticalWeight() const { return m_statisticalWeight; }
+		void setStatisticalWeight(Float weight) { m_statisticalWeight = weight; }
+
+	private:
+		struct ANode
+		{
+			ANode();
+			ANode(const ANode &other);
+			ANode &operator=(const ANode &other);
+
+			bool isLeaf(int i) const { return m_children[i] == 0; }
+			Float sum() const { return m_sum[0] + m_sum[1] + m_sum[2] + m_sum[3]; }
+
+			AAtomicFloat m_sum[4];
+			int m_children[4];	//0 marks a leaf quadrant, the root is never a child
+		};
+
+		std::vector<ANode> m_nodes;
+		AAtomicFloat m_statisticalWeight;	//number of recorded samples
+	};
+
+	//Note: the radiance of the current training iteration is recorded into the building tree
+	//      while directions are sampled from the tree learned by the previous iteration
+	struct ADTreeWrapper
+	{
+		ADTree m_building;
+		ADTree m_sampling;
+	};
+
+	//Note: a binary tree that splits the cubified scene bounds in the middle along alternating
+	//      axes, every leaf holds the directional distributions of its region of space
+	class ASDTree
+	{
+	public:
+		ASDTree(const ABounds3f &bounds);
+
+		ADTreeWrapper *lookup(const AVector3f &p);
+
+		// Split the leaves that recorded more than |threshold| samples until all of them are below it
+		void refine(Float threshold);
+
+		// Run func(dTree) on the directional distributions of all leaves in parallel
+		template <typename Function>
+		void forEachDTree(const Function &func)
+		{
+			AParallelUtils::parallelFor((size_t)0, m_nodes.size(), [&](const size_t &i)
+			{
+				if (m_nodes[i].m_isLeaf)
+					func(m_nodes[i].m_dTree);
+			}, AExecutionPolicy::APARALLEL);
+		}
+
+		size_t numLeaves() const;
+
+	private:
+		struct ANode
+		{
+			ADTreeWrapper m_dTree;
+			bool m_isLeaf = true;
+			int m_axis = 0;
+			int m_children[2] = { 0, 0 };
+		};
+
+		void subdivide(int nodeIndex);
+
+		ABounds3f m_bounds;
+		std::vector<ANode> m_nodes;
+	};
+
+	//Note: path tracing that samples directions from a learned distribution of incident
+	//      radiance (Mueller et al. 2017, "Practical Path Guiding for Efficient Light-Transport
+	//      Simulation"). Before the image is rendered, training iterations with doubling sample
+	//      counts record the radiance arriving at the path vertices into an SD-tree, whose spatial
+	//      and directional resolution is refined after each iteration. The directions are then
+	//      sampled from a one-sample MIS mixture of the BSDF and the learned distribution.
+	class AGuidedPathIntegrator : public ASamplerIntegrator
+	{
+	public:
+
+		AGuidedPathIntegrator(const APropertyTreeNode &props);
+
+		AGuidedPathIntegrator(int maxDepth, ACamera::ptr camera, ASampler::ptr sampler,
+			int64_t trainingSpp, Float bsdfSamplingFraction = 0.5f, Float rrThreshold = 1,
+			const std::string &lightSampleStrategy = "bvh");
+
+		virtual void preprocess(const AScene &scene) override;
+
+		virtual void render(const AScene &scene) override;
+
+		virtual ASpectrum Li(const ARay &ray, const AScene &scene, ASampler &sampler,
+			MemoryArena &arena, int depth) const override;
+
+		virtual std::string toString() const override { return "GuidedPathIntegrator[]"; }
+
+	private:
+		// Render |spp| samples per pixel that only train the SD-tree, the image is discarded
+		void trainingIteration(const AScene &scene, int iteration, int64_t spp);
+
+		// Turn the recorded radiance into the sampling distributions and refine the SD-tree
+		void updateSDTree(int64_t iterationSpp);
+
+		int m_maxDepth;
+		Float m_rrThreshold;
+		std::string m_lightSampleStrategy;
+		std::unique_ptr<ALightDistribution> m_lightDistribution;
+
+		int64_t m_trainingSpp;			//samples per pixel spent on training
+		Float m_bsdfSamplingFraction;	//probability of sampling the BSDF at guided vertices
+		Float m_spatialThreshold;		//samples of a spatial leaf at one sample per pixel before it's split
+		Float m_directionalThreshold;	//radiance fraction of a directional quadrant before it's split
+
+		bool m_training = false;
+		std::unique_ptr<ASDTree> m_sdTree;
+	};
+
+}
+
+#endif
\ No newline at end of file
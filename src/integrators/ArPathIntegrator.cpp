@@ -2,15 +2,165 @@
 
 #include "ArScene.h"
 #include "ArBSDF.h"
+#include "ArReporter.h"
 
 namespace Aurora
 {
+	//-------------------------------------------AIrradianceCache-------------------------------------
+
+	AIrradianceCache::AIrradianceCache(Float maxError, Float minSpacing, Float maxSpacing)
+		: m_maxError(maxError), m_minSpacing(minSpacing), m_maxSpacing(maxSpacing)
+	{
+		CHECK_GT(m_maxError, 0);
+		CHECK_GT(m_minSpacing, 0);
+		CHECK_LE(m_minSpacing, m_maxSpacing);
+
+		//Note: a record is valid up to maxError * radius from its position, so that the
+		//      largest ones overlap at most two cells along every axis
+		m_cellSize = m_maxError * m_maxSpacing;
+		m_cells.reset(new std::atomic<ANode*>[aNumCells]);
+		for (size_t i = 0; i < aNumCells; ++i)
+			m_cells[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	size_t AIrradianceCache::hashCell(const AVector3i &cell) const
+	{
+		uint64_t hash = ((uint64_t)(uint32_t)cell.x * 73856093u) ^
+			((uint64_t)(uint32_t)cell.y * 19349663u) ^ ((uint64_t)(uint32_t)cell.z * 83492791u);
+		return (size_t)(hash % aNumCells);
+	}
+
+	bool AIrradianceCache::lookup(const AVector3f &p, const AVector3f &n, ASpectrum &E) const
+	{
+		AVector3i cell(glm::floor(p / m_cellSize));
+		const ANode *node = m_cells[hashCell(cell)].load(std::memory_order_acquire);
+
+		ASpectrum sumE(0.f);
+		Float sumWeight = 0;
+		for (; node != nullptr; node = node->next)
+		{
+			const ARecord &record = *node->record;
+
+			// Skip records in front of |p|, they don't see the same surroundings
+			AVector3f d = p - record.p;
+			if (dot(d, record.n + n) < -0.1f * record.radius)
+				continue;
+
+			Float cosTheta = glm::min((Float)1, dot(n, record.n));
+			Float error = length(d) / record.radius + std::sqrt(glm::max((Float)0, 1 - cosTheta));
+			if (error >= m_maxError)
+				continue;
+
+			//Note: the weight falls off to zero at the boundary of validity, which keeps the
+			//      interpolated irradiance continuous when records are added nearby
+			Float weight = 1 / glm::max(error, (Float)1e-4f) - 1 / m_maxError;
+			sumE += weight * record.E;
+			sumWeight += weight;
+		}
+
+		if (sumWeight <= 0)
+			return false;
+		E = sumE / sumWeight;
+		return true;
+	}
+
+	void AIrradianceCache::add(const AVector3f &p, const AVector3f &n, const ASpectrum &E, Float harmonicDist)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_records.push_back({ p, n, E, glm::clamp(harmonicDist, m_minSpacing, m_maxSpacing) });
+		const ARecord *record = &m_records.back();
+
+		// Link the record into all the cells its region of validity overlaps
+		Float extent = m_maxError * record->radius;
+		AVector3i cellMin(glm::floor((p - extent) / m_cellSize));
+		AVector3i cellMax(glm::floor((p + extent) / m_cellSize));
+		for (int z = cellMin.z; z <= cellMax.z; ++z)
+		{
+			for (int y = cellMin.y; y <= cellMax.y; ++y)
+			{
+				for (int x = cellMin.x; x <= cellMax.x; ++x)
+				{
+					std::atomic<ANode*> &head = m_cells[hashCell(AVector3i(x, y, z))];
+					m_nodes.push_back({ record, head.load(std::memory_order_relaxed) });
+					head.store(&m_nodes.back(), std::memory_order_release);
+				}
+			}
+		}
+	}
+
+	size_t AIrradianceCache::numRecords() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_records.size();
+	}
+
+	//-------------------------------------------AAdjointCache-------------------------------------
+
+	AAdjointCache::AAdjointCache(const ABounds3f &bounds, int maxResolution) : m_bounds(bounds)
+	{
+		// Cubic cells, |maxResolution| of them along the longest axis
+		AVector3f diag = m_bounds.diagonal();
+		Float cellSize = glm::max(diag.x, glm::max(diag.y, diag.z)) / maxResolution;
+		for (int i = 0; i < 3; ++i)
+			m_resolution[i] = glm::clamp((int)std::ceil(diag[i] / cellSize), 1, maxResolution);
+
+		const int nCells = m_resolution.x * m_resolution.y * m_resolution.z;
+		m_sums.reset(new AAtomicFloat[nCells]);
+		m_counts.reset(new std::atomic<int>[nCells]);
+		for (int i = 0; i < nCells; ++i)
+			m_counts[i].store(0, std::memory_order_relaxed);
+	}
+
+	int AAdjointCache::cellIndex(const AVector3f &p) const
+	{
+		AVector3f offset = m_bounds.offset(p);
+		AVector3i cell;
+		for (int i = 0; i < 3; ++i)
+			cell[i] = glm::clamp((int)(offset[i] * m_resolution[i]), 0, m_resolution[i] - 1);
+		return (cell.z * m_resolution.y + cell.y) * m_resolution.x + cell.x;
+	}
+
+	void AAdjointCache::record(const AVector3f &p, Float radiance)
+	{
+		int index = cellIndex(p);
+		m_sums[index].add(radiance);
+		m_counts[index].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Float AAdjointCache::lookup(const AVector3f &p) const
+	{
+		int index = cellIndex(p);
+		int count = m_counts[index].load(std::memory_order_relaxed);
+		return count > 0 ? m_sums[index] / count : -1.f;
+	}
+
+	//-------------------------------------------APathIntegrator-------------------------------------
+
 	AURORA_REGISTER_CLASS(APathIntegrator, "Path")
 
 	APathIntegrator::APathIntegrator(const APropertyTreeNode &node)
 		: ASamplerIntegrator(nullptr, nullptr), m_maxDepth(node.getPropertyList().getInteger("Depth", 2))
-		, m_rrThreshold(1.f), m_lightSampleStrategy("spatial")
+		, m_rrThreshold(1.f)
+		, m_lightSampleStrategy(node.getPropertyList().getString("LightSampleStrategy", "bvh"))
 	{
+		//Irradiance cache
+		const auto &props = node.getPropertyList();
+		m_useIrradianceCache = props.getBoolean("IrradianceCache", false);
+		m_cacheError = props.getFloat("CacheError", 0.2f);
+		m_cacheMinSpacing = props.getFloat("CacheMinSpacing", 0.01f);
+		m_cacheMaxSpacing = props.getFloat("CacheMaxSpacing", 0.5f);
+		m_cacheSamples = props.getInteger("CacheSamples", 64);
+
+		//Russian roulette, "Classic" or "ADRRS" (adjoint-driven Russian roulette and splitting)
+		const std::string russianRoulette = props.getString("RussianRoulette", "Classic");
+		if (russianRoulette == "ADRRS")
+			m_adjointRoulette = true;
+		else if (russianRoulette != "Classic")
+			LOG(ERROR) << "Russian roulette \"" << russianRoulette << "\" unknown. Using \"Classic\".";
+		m_prepassSpp = props.getInteger("PrepassSPP", 4);
+		m_maxSplits = props.getInteger("MaxSplits", 8);
+
 		//Sampler
 		const auto &samplerNode = node.getPropertyChild("Sampler");
 		m_sampler = ASampler::ptr(static_cast<ASampler*>(AObjectFactory::createInstance(
@@ -32,15 +182,162 @@ namespace Aurora
 	void APathIntegrator::preprocess(const AScene &scene) 
 	{
 		m_lightDistribution = createLightSampleDistribution(m_lightSampleStrategy, scene);
+
+		if (m_useIrradianceCache)
+		{
+			AVector3f worldCenter;
+			Float worldRadius;
+			scene.worldBound().boundingSphere(&worldCenter, &worldRadius);
+			m_irradianceCache.reset(new AIrradianceCache(m_cacheError,
+				m_cacheMinSpacing * worldRadius, m_cacheMaxSpacing * worldRadius));
+		}
+
+		if (m_adjointRoulette)
+		{
+			m_adjointCache.reset(new AAdjointCache(scene.worldBound(), 32));
+		}
+	}
+
+	void APathIntegrator::render(const AScene &scene)
+	{
+		if (m_adjointRoulette)
+		{
+			adjointPrepass(scene);
+		}
+
+		ASamplerIntegrator::render(scene);
+	}
+
+	void APathIntegrator::adjointPrepass(const AScene &scene)
+	{
+		m_estimateBounds = m_camera->m_film->getSampleBounds();
+		AVector2i sampleExtent = m_estimateBounds.diagonal();
+		constexpr int tileSize = 16;
+		AVector2i nTiles((sampleExtent.x + tileSize - 1) / tileSize, (sampleExtent.y + tileSize - 1) / tileSize);
+		const int nImageTiles = nTiles.x * nTiles.y;
+		const int64_t spp = glm::clamp(m_prepassSpp, (int64_t)1, m_sampler->getSamplingNumber());
+
+		allocateArenas();
+
+		std::vector<Float> estimates(m_estimateBounds.area(), 0.f);
+		m_training = true;
+		AReporter reporter(nImageTiles, "Prepass");
+		AParallelUtils::parallelFor((size_t)0, (size_t)nImageTiles, [&](const size_t &t)
+		{
+			AVector2i tile(t % nTiles.x, t / nTiles.x);
+			MemoryArena &arena = *m_arenas[AParallelUtils::getThreadIndex()];
+
+			// Negative seeds keep the random number streams apart from the ones of the image
+			std::unique_ptr<ASampler> tileSampler = m_sampler->clone(-(int)t - 1);
+			if (spp < m_sampler->getSamplingNumber())
+			{
+				tileSampler->setSampleRange(0, spp);
+			}
+
+			int x0 = m_estimateBounds.m_pMin.x + tile.x * tileSize;
+			int x1 = glm::min(x0 + tileSize, m_estimateBounds.m_pMax.x);
+			int y0 = m_estimateBounds.m_pMin.y + tile.y * tileSize;
+			int y1 = glm::min(y0 + tileSize, m_estimateBounds.m_pMax.y);
+			ABounds2i tileBounds(AVector2i(x0, y0), AVector2i(x1, y1));
+
+			for (AVector2i pixel : tileBounds)
+			{
+				Float sum = 0;
+				tileSampler->startPixel(pixel);
+				do
+				{
+					ACameraSample cameraSample = tileSampler->getCameraSample(pixel);
+					ARay ray;
+					Float rayWeight = m_camera->castingRay(cameraSample, ray);
+					if (rayWeight > 0)
+					{
+						sum += rayWeight * Li(ray, scene, *tileSampler, arena, 0).y();
+					}
+					arena.Reset();
+				} while (tileSampler->startNextSample());
+
+				AVector2i p = pixel - m_estimateBounds.m_pMin;
+				estimates[p.y * sampleExtent.x + p.x] = sum / spp;
+			}
+
+			reporter.update();
+		}, AExecutionPolicy::APARALLEL);
+		reporter.done();
+		m_training = false;
+
+		// A few samples per pixel are noisy, the estimates are averaged over 3x3 pixels
+		m_pixelEstimates.assign(estimates.size(), 0.f);
+		for (int y = 0; y < sampleExtent.y; ++y)
+		{
+			for (int x = 0; x < sampleExtent.x; ++x)
+			{
+				Float sum = 0;
+				int count = 0;
+				for (int dy = glm::max(0, y - 1); dy <= glm::min(sampleExtent.y - 1, y + 1); ++dy)
+				{
+					for (int dx = glm::max(0, x - 1); dx <= glm::min(sampleExtent.x - 1, x + 1); ++dx)
+					{
+						sum += estimates[dy * sampleExtent.x + dx];
+						++count;
+					}
+				}
+				m_pixelEstimates[y * sampleExtent.x + x] = sum / count;
+			}
+		}
 	}
 
 	ASpectrum APathIntegrator::Li(const ARay &r, const AScene &scene, ASampler &sampler,
 		MemoryArena &arena, int depth) const 
 	{
-		ASpectrum L(0.f), beta(1.f);
+		return tracePath(r, APathState(), scene, sampler, arena, m_irradianceCache != nullptr);
+	}
+
+	ASpectrum APathIntegrator::indirectIrradiance(const ASurfaceInteraction &isect, const AVector3f &wo,
+		const AScene &scene, ASampler &sampler, MemoryArena &arena, int bounces) const
+	{
+		// Irradiance is cached for the side of the surface the path arrived at
+		AVector3f n = dot(isect.n, wo) < 0 ? -isect.n : isect.n;
+
+		ASpectrum E(0.f);
+		if (m_irradianceCache->lookup(isect.p, n, E))
+			return E;
+
+		// Gather the indirect irradiance with stratified cosine-weighted directions
+		AVector3f s, t;
+		coordinateSystem(n, s, t);
+		int nStrata = glm::max(1, (int)std::sqrt((Float)m_cacheSamples));
+		Float invDistSum = 0;
+		for (int j = 0; j < nStrata; ++j)
+		{
+			for (int i = 0; i < nStrata; ++i)
+			{
+				AVector2f u = sampler.get2D();
+				AVector3f w = cosineSampleHemisphere(AVector2f((i + u.x) / nStrata, (j + u.y) / nStrata));
+				AVector3f wi = w.x * s + w.y * t + w.z * n;
+
+				APathState state;
+				state.bounces = bounces + 1;
+				state.adjointDriven = false;
+				Float hitDistance = aInfinity;
+				E += tracePath(isect.spawnRay(wi), state, scene, sampler, arena, false, &hitDistance);
+				invDistSum += 1 / hitDistance;
+			}
+		}
+
+		int nSamples = nStrata * nStrata;
+		E *= aPi / nSamples;
+		Float harmonicDist = invDistSum > 0 ? nSamples / invDistSum : aInfinity;
+		m_irradianceCache->add(isect.p, n, E, harmonicDist);
+		return E;
+	}
+
+	ASpectrum APathIntegrator::tracePath(const ARay &r, const APathState &state, const AScene &scene,
+		ASampler &sampler, MemoryArena &arena, bool useCache, Float *hitDistance) const
+	{
+		ASpectrum L(0.f), beta(state.beta);
 		ARay ray(r);
 
-		bool specularBounce = false;
+		bool specularBounce = state.specularBounce;
 		int bounces;
 		// Added after book publication: etaScale tracks the accumulated effect
 		// of radiance scaling due to rays passing through refractive
@@ -49,15 +346,62 @@ namespace Aurora
 		// Russian roulette; this is worthwhile, since it lets us sometimes
 		// avoid terminating refracted rays that are about to be refracted back
 		// out of a medium and thus have their beta value increased.
-		Float etaScale = 1;
+		Float etaScale = state.etaScale;
+
+		// The prepass of the adjoint-driven Russian roulette records the radiance reflected at every vertex
+		struct AVertexRecord { AVector3f p; Float betaY; Float LY; };
+		AVertexRecord *vertices = m_training ? arena.Alloc<AVertexRecord>(m_maxDepth + 1) : nullptr;
+		int nVertices = 0;
 
-		for (bounces = 0;; ++bounces) 
+		// The pixel estimate doesn't change along the path
+		Float pixelEstimate = -1.f;
+		if (m_adjointCache != nullptr && !m_training && state.adjointDriven)
+		{
+			AVector2i p = sampler.getCurrentPixel() - m_estimateBounds.m_pMin;
+			AVector2i extent = m_estimateBounds.diagonal();
+			if (p.x >= 0 && p.y >= 0 && p.x < extent.x && p.y < extent.y)
+				pixelEstimate = m_pixelEstimates[p.y * extent.x + p.x];
+		}
+
+		// Sample the BSDF to get a new path direction, returns false if the path is absorbed
+		auto scatter = [&](const ASurfaceInteraction &isect, ASpectrum &pathBeta, Float &pathEtaScale,
+			bool &pathSpecularBounce, ARay &pathRay) -> bool
+		{
+			AVector3f wo = -pathRay.direction(), wi;
+			Float pdf;
+			ABxDFType flags;
+			ASpectrum f = isect.bsdf->sample_f(wo, wi, sampler.get2D(), pdf, flags, BSDF_ALL);
+
+			if (f.isBlack() || pdf == 0.f)
+				return false;
+			pathBeta *= f * absDot(wi, isect.n) / pdf;
+
+			CHECK_GE(pathBeta.y(), 0.f);
+			DCHECK(!glm::isinf(pathBeta.y()));
+
+			pathSpecularBounce = (flags & BSDF_SPECULAR) != 0;
+			if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION))
+			{
+				Float eta = isect.bsdf->m_eta;
+				// Update the term that tracks radiance scaling for refraction
+				// depending on whether the ray is entering or leaving the
+				// medium.
+				pathEtaScale *= (dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+			}
+
+			pathRay = isect.spawnRay(wi);
+			return true;
+		};
+
+		for (bounces = state.bounces;; ++bounces) 
 		{
 			// Find next path vertex and accumulate contribution
 
 			// Intersect _ray_ with scene and store intersection in _isect_
 			ASurfaceInteraction isect;
 			bool hit = scene.hit(ray, isect);
+			if (hitDistance != nullptr && bounces == state.bounces && hit)
+				*hitDistance = distance(ray.origin(), isect.p);
 
 			// Possibly add emitted light at intersection
 			if (bounces == 0 || specularBounce) 
@@ -91,49 +435,86 @@ namespace Aurora
 				continue;
 			}
 
-			const ADistribution1D *distrib = m_lightDistribution->lookup(isect.p);
+			// Everything the path gathers from here on is reflected at this vertex
+			if (vertices != nullptr && nVertices <= m_maxDepth)
+			{
+				vertices[nVertices++] = { isect.p, beta.y(), L.y() };
+			}
 
 			// Sample illumination from lights to find path contribution.
 			// (But skip this for perfectly specular BSDFs.)
 			if (isect.bsdf->numComponents(ABxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0) 
 			{
 				//++totalPaths;
-				ASpectrum Ld = beta * uniformSampleOneLight(isect, scene, arena, sampler, distrib);
+				ASpectrum Ld = beta * uniformSampleOneLight(isect, scene, arena, sampler, m_lightDistribution.get());
 				//if (Ld.isBlack()) 
 				//	++zeroRadiancePaths;
 				CHECK_GE(Ld.y(), 0.f);
 				L += Ld;
 			}
 
-			// Sample BSDF to get new path direction
-			AVector3f wo = -ray.direction(), wi;
-			Float pdf;
-			ABxDFType flags;
-			ASpectrum f = isect.bsdf->sample_f(wo, wi, sampler.get2D(), pdf, flags, BSDF_ALL);
-			
-			if (f.isBlack() || pdf == 0.f) 
+			// Interpolate the indirect illumination of the first diffuse vertex from the irradiance cache.
+			// Vertices with glossy or specular lobes keep on path tracing.
+			int nComponents = isect.bsdf->numComponents();
+			if (useCache && (bounces == 0 || specularBounce) && nComponents > 0 &&
+				isect.bsdf->numComponents(ABxDFType(BSDF_DIFFUSE | BSDF_REFLECTION)) == nComponents)
+			{
+				AVector3f wo = -ray.direction();
+				AVector3f n = dot(isect.n, wo) < 0 ? -isect.n : isect.n;
+				L += beta * isect.bsdf->f(wo, n) * indirectIrradiance(isect, wo, scene, sampler, arena, bounces);
 				break;
-			beta *= f * absDot(wi, isect.n) / pdf;
+			}
 
-			CHECK_GE(beta.y(), 0.f);
-			DCHECK(!glm::isinf(beta.y()));
+			// Adjoint-driven Russian roulette and splitting (Vorba and Krivanek 2016): the expected
+			// contribution of the path, its throughput times the radiance reflected at the vertex,
+			// is kept within a window around the pixel estimate. Paths above the window are split,
+			// paths below it are played Russian roulette with.
+			int nSplits = 1;
+			bool classicRoulette = true;
+			Float adjoint = pixelEstimate > 0 ? m_adjointCache->lookup(isect.p) : -1.f;
+			if (adjoint > 0)
+			{
+				classicRoulette = false;
+				constexpr Float windowSize = 5;
+				const Float center = pixelEstimate / adjoint;
+				const Float lower = 2 * center / (1 + windowSize);
+				const Float upper = windowSize * lower;
+				const Float weight = beta.y();
+				if (weight > upper)
+				{
+					nSplits = glm::min((int)(weight / center), m_maxSplits);
+				}
+				else if (weight < lower)
+				{
+					Float q = weight / center;
+					if (sampler.get1D() >= q)
+						break;
+					beta /= q;
+				}
+			}
 
-			specularBounce = (flags & BSDF_SPECULAR) != 0;
-			if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) 
+			if (nSplits > 1)
 			{
-				Float eta = isect.bsdf->m_eta;
-				// Update the term that tracks radiance scaling for refraction
-				// depending on whether the ray is entering or leaving the
-				// medium.
-				etaScale *= (dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+				beta /= nSplits;
+				for (int split = 1; split < nSplits; ++split)
+				{
+					APathState branch;
+					branch.beta = beta;
+					branch.etaScale = etaScale;
+					branch.bounces = bounces + 1;
+					ARay branchRay(ray);
+					if (scatter(isect, branch.beta, branch.etaScale, branch.specularBounce, branchRay))
+						L += tracePath(branchRay, branch, scene, sampler, arena, useCache);
+				}
 			}
 
-			ray = isect.spawnRay(wi);
+			if (!scatter(isect, beta, etaScale, specularBounce, ray))
+				break;
 
 			// Possibly terminate the path with Russian roulette.
 			// Factor out radiance scaling due to refraction in rrBeta.
 			ASpectrum rrBeta = beta * etaScale;
-			if (rrBeta.maxComponentValue() < m_rrThreshold && bounces > 3) 
+			if (classicRoulette && rrBeta.maxComponentValue() < m_rrThreshold && bounces > 3) 
 			{
 				Float q = glm::max((Float).05f, 1 - rrBeta.maxComponentValue());
 				if (sampler.get1D() < q) 
@@ -143,6 +524,12 @@ namespace Aurora
 			}
 		}
 
+		for (int i = 0; i < nVertices; ++i)
+		{
+			if (vertices[i].betaY > 0)
+				m_adjointCache->record(vertices[i].p, (L.y() - vertices[i].LY) / vertices[i].betaY);
+		}
+
 		//ReportValue(pathLength, bounces);
 		return L;
 	}
@@ -5,9 +5,85 @@
 #include "ArMathUtils.h"
 #include "ArIntegrator.h"
 #include "ArLightDistrib.h"
+#include "ArParallel.h"
+
+#include <deque>
+#include <mutex>
+#include <atomic>
 
 namespace Aurora
 {
+	//Note: irradiance caching (Ward et al. 1988, "A Ray Tracing Solution for Diffuse Interreflection").
+	//      The indirect irradiance is gathered at sparse surface points on demand and interpolated
+	//      at the points nearby. A record is valid where its error estimate, the distance in units
+	//      of the harmonic mean distance of the surfaces around it plus the change of the normal,
+	//      stays below |maxError|. Records are linked into the cells of a hashed grid they overlap,
+	//      insertions are serialized while lookups don't take any lock.
+	class AIrradianceCache
+	{
+	public:
+		AIrradianceCache(Float maxError, Float minSpacing, Float maxSpacing);
+
+		// Interpolate the irradiance at |p| with normal |n|, false if no record is valid there
+		bool lookup(const AVector3f &p, const AVector3f &n, ASpectrum &E) const;
+
+		// Add the irradiance gathered at |p|, |harmonicDist| is the harmonic mean of the distances
+		// the gather rays travelled, it is clamped to the spacing of the records
+		void add(const AVector3f &p, const AVector3f &n, const ASpectrum &E, Float harmonicDist);
+
+		size_t numRecords() const;
+
+	private:
+		struct ARecord
+		{
+			AVector3f p, n;
+			ASpectrum E;
+			Float radius;
+		};
+
+		struct ANode
+		{
+			const ARecord *record;
+			ANode *next;
+		};
+
+		size_t hashCell(const AVector3i &cell) const;
+
+		Float m_maxError;
+		Float m_minSpacing, m_maxSpacing;
+		Float m_cellSize;
+
+		static constexpr size_t aNumCells = 1 << 18;
+		std::unique_ptr<std::atomic<ANode*>[]> m_cells;
+
+		mutable std::mutex m_mutex;
+		std::deque<ARecord> m_records;	//deques don't move their elements when growing
+		std::deque<ANode> m_nodes;
+	};
+
+	//Note: a coarse estimate of the radiance reflected at the surfaces of the scene, the mean over
+	//      the path vertices recorded in the cells of a uniform grid. Adjoint-driven Russian roulette
+	//      and splitting compare the expected contribution of a path against it.
+	class AAdjointCache
+	{
+	public:
+		AAdjointCache(const ABounds3f &bounds, int maxResolution);
+
+		// Add the radiance reflected at |p| along a path, thread safe
+		void record(const AVector3f &p, Float radiance);
+
+		// Mean radiance recorded in the cell of |p|, negative if nothing was recorded there
+		Float lookup(const AVector3f &p) const;
+
+	private:
+		int cellIndex(const AVector3f &p) const;
+
+		ABounds3f m_bounds;
+		AVector3i m_resolution;
+		std::unique_ptr<AAtomicFloat[]> m_sums;
+		std::unique_ptr<std::atomic<int>[]> m_counts;
+	};
+
 	class APathIntegrator : public ASamplerIntegrator
 	{
 	public:
@@ -15,9 +91,11 @@ namespace Aurora
 		APathIntegrator(const APropertyTreeNode &props);
 
 		APathIntegrator(int maxDepth, ACamera::ptr camera, ASampler::ptr sampler,
-			Float rrThreshold = 1, const std::string &lightSampleStrategy = "spatial");
+			Float rrThreshold = 1, const std::string &lightSampleStrategy = "bvh");
 
 		virtual void preprocess(const AScene &scene) override;
+
+		virtual void render(const AScene &scene) override;
 		
 		virtual ASpectrum Li(const ARay &ray, const AScene &scene, ASampler &sampler, 
 			MemoryArena &arena, int depth) const override;
@@ -25,11 +103,50 @@ namespace Aurora
 		virtual std::string toString() const override { return "PathIntegrator[]"; }
 
 	private:
+		//Note: the state a path leaves a vertex with, split paths continue from copies of it
+		struct APathState
+		{
+			ASpectrum beta = 1.f;
+			Float etaScale = 1;
+			int bounces = 0;
+			bool specularBounce = false;
+			bool adjointDriven = true;	//the gathers of the irradiance cache don't start at the camera
+		};
+
+		// Trace a path whose next vertex is reached with |state|, the emission found there is only
+		// added for camera rays and after specular bounces. The distance to it goes to |hitDistance|.
+		ASpectrum tracePath(const ARay &ray, const APathState &state, const AScene &scene, ASampler &sampler,
+			MemoryArena &arena, bool useCache, Float *hitDistance = nullptr) const;
+
+		// Render a few samples per pixel to estimate the pixel values and the reflected radiance
+		// that drive the adjoint Russian roulette, the image is discarded
+		void adjointPrepass(const AScene &scene);
+
+		// Indirect irradiance at a diffuse vertex, interpolated from the cache or gathered by
+		// tracing paths over the hemisphere and added to the cache
+		ASpectrum indirectIrradiance(const ASurfaceInteraction &isect, const AVector3f &wo,
+			const AScene &scene, ASampler &sampler, MemoryArena &arena, int bounces) const;
+
 		// PathIntegrator Private Data
 		int m_maxDepth;
 		Float m_rrThreshold;
 		std::string m_lightSampleStrategy;
 		std::unique_ptr<ALightDistribution> m_lightDistribution;
+
+		bool m_useIrradianceCache = false;
+		Float m_cacheError;			//maximum error estimate of an interpolated record
+		Float m_cacheMinSpacing;	//bounds of the record radii in units of the scene radius
+		Float m_cacheMaxSpacing;
+		int m_cacheSamples;			//gather rays per record
+		std::unique_ptr<AIrradianceCache> m_irradianceCache;
+
+		bool m_adjointRoulette = false;
+		int64_t m_prepassSpp = 4;	//samples per pixel of the prepass
+		int m_maxSplits = 8;		//paths a vertex may be split into
+		bool m_training = false;
+		std::unique_ptr<AAdjointCache> m_adjointCache;
+		ABounds2i m_estimateBounds;
+		std::vector<Float> m_pixelEstimates;	//luminance of the pixels of the sample bounds
 	};
 
 }
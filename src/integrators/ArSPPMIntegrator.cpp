@@ -0,0 +1,469 @@
+#include "ArSPPMIntegrator.h"
+
+#include "ArScene.h"
+#include "ArBSDF.h"
+#include "ArLight.h"
+#include "ArRng.h"
+#include "ArReporter.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(ASPPMIntegrator, "SPPM")
+
+	static bool toGrid(const AVector3f &p, const ABounds3f &bounds, const int gridRes[3], AVector3i &pi)
+	{
+		bool inBounds = true;
+		AVector3f pg = bounds.offset(p);
+		for (int i = 0; i < 3; ++i)
+		{
+			pi[i] = (int)(gridRes[i] * pg[i]);
+			inBounds &= (pi[i] >= 0 && pi[i] < gridRes[i]);
+			pi[i] = glm::clamp(pi[i], 0, gridRes[i] - 1);
+		}
+		return inBounds;
+	}
+
+	static inline unsigned int hashCell(const AVector3i &p, int hashSize)
+	{
+		uint64_t hash = ((uint64_t)(uint32_t)p.x * 73856093u) ^
+			((uint64_t)(uint32_t)p.y * 19349663u) ^ ((uint64_t)(uint32_t)p.z * 83492791u);
+		return (unsigned int)(hash % (uint64_t)hashSize);
+	}
+
+	ASPPMIntegrator::ASPPMIntegrator(const APropertyTreeNode &node)
+		: m_maxDepth(node.getPropertyList().getInteger("Depth", 5))
+		, m_photonsPerIteration(node.getPropertyList().getInteger("PhotonsPerIteration", -1))
+		, m_initialSearchRadius(node.getPropertyList().getFloat("Radius", 1.f))
+		, m_lightSampleStrategy(node.getPropertyList().getString("LightSampleStrategy", "bvh"))
+	{
+		//Sampler
+		const auto &samplerNode = node.getPropertyChild("Sampler");
+		m_sampler = ASampler::ptr(static_cast<ASampler*>(AObjectFactory::createInstance(
+			samplerNode.getTypeName(), samplerNode)));
+
+		//Camera
+		const auto &cameraNode = node.getPropertyChild("Camera");
+		m_camera = ACamera::ptr(static_cast<ACamera*>(AObjectFactory::createInstance(
+			cameraNode.getTypeName(), cameraNode)));
+
+		activate();
+	}
+
+	ASPPMIntegrator::ASPPMIntegrator(ACamera::ptr camera, ASampler::ptr sampler, int maxDepth,
+		int photonsPerIteration, Float initialSearchRadius, const std::string &lightSampleStrategy)
+		: m_camera(camera), m_sampler(sampler), m_maxDepth(maxDepth), m_photonsPerIteration(photonsPerIteration),
+		m_initialSearchRadius(initialSearchRadius), m_lightSampleStrategy(lightSampleStrategy) {}
+
+	void ASPPMIntegrator::preprocess(const AScene &scene)
+	{
+		m_lightDistribution = createLightSampleDistribution(m_lightSampleStrategy, scene);
+		m_photonDistribution = createLightSampleDistribution("power", scene);
+	}
+
+	void ASPPMIntegrator::render(const AScene &scene)
+	{
+		CHECK_GT(m_initialSearchRadius, 0.f);
+
+		AFilm &film = *m_camera->m_film;
+		m_pixelBounds = film.getCroppedPixelBounds();
+		const int nPixels = m_pixelBounds.area();
+		m_pixels.reset(new ASPPMPixel[nPixels]);
+		for (int i = 0; i < nPixels; ++i)
+			m_pixels[i].radius = m_initialSearchRadius;
+
+		if (m_photonsPerIteration <= 0)
+			m_photonsPerIteration = nPixels;
+
+		if (m_arenas.size() != (size_t)numSystemCores())
+		{
+			m_arenas.clear();
+			m_photonArenas.clear();
+			for (int i = 0; i < numSystemCores(); ++i)
+			{
+				m_arenas.push_back(MemoryArena::CreateAligned(262144, aOptions.hugePages));
+				m_photonArenas.push_back(MemoryArena::CreateAligned(262144, aOptions.hugePages));
+			}
+		}
+
+		// The grid is rebuilt every iteration with as many cells as there are pixels
+		std::vector<std::atomic<ASPPMPixelListNode*>> grid(nPixels);
+
+		const int nIterations = (int)m_sampler->getSamplingNumber();
+		AReporter reporter(2 * nIterations, "Rendering");
+		Float lastWriteMS = 0;
+		int iteration = 0;
+		for (; iteration < nIterations; ++iteration)
+		{
+			generateVisiblePoints(scene, iteration);
+
+			ABounds3f gridBounds;
+			int gridRes[3];
+			buildGrid(grid, gridBounds, gridRes);
+			reporter.update();
+
+			tracePhotons(scene, iteration, grid, gridBounds, gridRes);
+			updatePixels();
+			reporter.update();
+
+			for (auto &arena : m_arenas)
+				arena->Reset();
+
+			if (iteration + 1 == nIterations)
+				continue;
+
+			// Don't start an iteration that is not expected to finish within the time limit
+			Float elapsedMS = reporter.elapsedMS();
+			if (aOptions.timeLimit > 0 && elapsedMS * (iteration + 2) / (iteration + 1) > aOptions.timeLimit * 1000)
+			{
+				LOG(INFO) << "Time limit reached after " << iteration + 1 << " iterations";
+				++iteration;
+				break;
+			}
+
+			if (aOptions.writeInterval > 0 && elapsedMS - lastWriteMS >= aOptions.writeInterval * 1000)
+			{
+				AFilm::waitForPendingWrites();
+				writeImage(iteration + 1);
+				lastWriteMS = elapsedMS;
+			}
+		}
+
+		reporter.done();
+
+		LOG(INFO) << "Rendering finished after " << iteration << " of " << nIterations << " iterations";
+
+		AFilm::waitForPendingWrites();
+		writeImage(iteration);
+	}
+
+	void ASPPMIntegrator::generateVisiblePoints(const AScene &scene, int iteration)
+	{
+		constexpr int tileSize = 16;
+		AVector2i pixelExtent = m_pixelBounds.diagonal();
+		AVector2i nTiles((pixelExtent.x + tileSize - 1) / tileSize, (pixelExtent.y + tileSize - 1) / tileSize);
+
+		AParallelUtils::parallelFor((size_t)0, (size_t)(nTiles.x * nTiles.y), [&](const size_t &t)
+		{
+			MemoryArena &arena = *m_arenas[AParallelUtils::getThreadIndex()];
+
+			// Every iteration takes the next sample of the pixels with another random number stream
+			std::unique_ptr<ASampler> tileSampler = m_sampler->clone((int)(t + iteration * nTiles.x * nTiles.y));
+
+			AVector2i tile((int)t % nTiles.x, (int)t / nTiles.x);
+			int x0 = m_pixelBounds.m_pMin.x + tile.x * tileSize;
+			int x1 = glm::min(x0 + tileSize, m_pixelBounds.m_pMax.x);
+			int y0 = m_pixelBounds.m_pMin.y + tile.y * tileSize;
+			int y1 = glm::min(y0 + tileSize, m_pixelBounds.m_pMax.y);
+			ABounds2i tileBounds(AVector2i(x0, y0), AVector2i(x1, y1));
+
+			for (AVector2i pPixel : tileBounds)
+			{
+				tileSampler->startPixel(pPixel);
+				tileSampler->setSampleNumber(iteration);
+
+				// Generate camera ray for pixel for SPPM
+				ACameraSample cameraSample = tileSampler->getCameraSample(pPixel);
+				ARay ray;
+				ASpectrum beta = m_camera->castingRay(cameraSample, ray);
+				if (beta.isBlack())
+					continue;
+
+				AVector2i pPixelO = pPixel - m_pixelBounds.m_pMin;
+				ASPPMPixel &pixel = m_pixels[pPixelO.x + pPixelO.y * pixelExtent.x];
+
+				// Follow camera ray path until a visible point is created
+				bool specularBounce = false;
+				for (int depth = 0; depth < m_maxDepth; ++depth)
+				{
+					ASurfaceInteraction isect;
+					if (!scene.hit(ray, isect))
+					{
+						// Accumulate light contributions for ray with no intersection
+						for (const auto &light : scene.m_infiniteLights)
+							pixel.Ld += beta * light->Le(ray);
+						break;
+					}
+
+					// Process SPPM camera ray intersection, skip over medium boundaries
+					isect.computeScatteringFunctions(ray, arena, true);
+					if (!isect.bsdf)
+					{
+						ray = isect.spawnRay(ray.direction());
+						--depth;
+						continue;
+					}
+					const ABSDF &bsdf = *isect.bsdf;
+
+					// Accumulate direct illumination at SPPM camera ray intersection
+					AVector3f wo = -ray.direction();
+					if (depth == 0 || specularBounce)
+						pixel.Ld += beta * isect.Le(wo);
+					pixel.Ld += beta * uniformSampleOneLight(isect, scene, arena, *tileSampler, m_lightDistribution.get());
+
+					// Possibly create visible point and end camera path
+					bool isDiffuse = bsdf.numComponents(ABxDFType(BSDF_DIFFUSE | BSDF_REFLECTION | BSDF_TRANSMISSION)) > 0;
+					bool isGlossy = bsdf.numComponents(ABxDFType(BSDF_GLOSSY | BSDF_REFLECTION | BSDF_TRANSMISSION)) > 0;
+					if (isDiffuse || (isGlossy && depth == m_maxDepth - 1))
+					{
+						pixel.vp.p = isect.p;
+						pixel.vp.wo = wo;
+						pixel.vp.bsdf = &bsdf;
+						pixel.vp.beta = beta;
+						break;
+					}
+
+					// Spawn ray from SPPM camera path vertex
+					if (depth < m_maxDepth - 1)
+					{
+						Float pdf;
+						AVector3f wi;
+						ABxDFType type;
+						ASpectrum f = bsdf.sample_f(wo, wi, tileSampler->get2D(), pdf, type);
+						if (pdf == 0. || f.isBlack())
+							break;
+						specularBounce = (type & BSDF_SPECULAR) != 0;
+						beta *= f * absDot(wi, isect.n) / pdf;
+						if (beta.y() < 0.25)
+						{
+							Float continueProb = glm::min((Float)1, beta.y());
+							if (tileSampler->get1D() > continueProb)
+								break;
+							beta /= continueProb;
+						}
+						ray = isect.spawnRay(wi);
+					}
+				}
+			}
+		}, AExecutionPolicy::APARALLEL);
+	}
+
+	void ASPPMIntegrator::buildGrid(std::vector<std::atomic<ASPPMPixelListNode*>> &grid,
+		ABounds3f &gridBounds, int gridRes[3])
+	{
+		const int nPixels = m_pixelBounds.area();
+		for (auto &cell : grid)
+			cell.store(nullptr, std::memory_order_relaxed);
+
+		// Compute grid bounds for SPPM visible points
+		Float maxRadius = 0.;
+		for (int i = 0; i < nPixels; ++i)
+		{
+			const ASPPMPixel &pixel = m_pixels[i];
+			if (pixel.vp.beta.isBlack())
+				continue;
+			ABounds3f vpBound(pixel.vp.p - AVector3f(pixel.radius), pixel.vp.p + AVector3f(pixel.radius));
+			gridBounds = unionBounds(gridBounds, vpBound);
+			maxRadius = glm::max(maxRadius, pixel.radius);
+		}
+
+		// Compute resolution of SPPM grid in each dimension
+		if (maxRadius == 0)
+		{
+			gridRes[0] = gridRes[1] = gridRes[2] = 0;
+			return;
+		}
+		AVector3f diag = gridBounds.diagonal();
+		Float maxDiag = glm::max(diag.x, glm::max(diag.y, diag.z));
+		int baseGridRes = (int)(maxDiag / maxRadius);
+		DCHECK_GT(baseGridRes, 0);
+		for (int i = 0; i < 3; ++i)
+			gridRes[i] = glm::max((int)(baseGridRes * diag[i] / maxDiag), 1);
+
+		// Add visible points to SPPM grid
+		constexpr int chunkSize = 4096;
+		AParallelUtils::parallelFor((size_t)0, (size_t)((nPixels + chunkSize - 1) / chunkSize), [&](const size_t &c)
+		{
+			MemoryArena &arena = *m_arenas[AParallelUtils::getThreadIndex()];
+			const int end = glm::min(nPixels, (int)(c + 1) * chunkSize);
+			for (int i = (int)c * chunkSize; i < end; ++i)
+			{
+				ASPPMPixel &pixel = m_pixels[i];
+				if (pixel.vp.beta.isBlack())
+					continue;
+
+				// Add pixel's visible point to applicable grid cells
+				Float radius = pixel.radius;
+				AVector3i pMin, pMax;
+				toGrid(pixel.vp.p - AVector3f(radius), gridBounds, gridRes, pMin);
+				toGrid(pixel.vp.p + AVector3f(radius), gridBounds, gridRes, pMax);
+				for (int z = pMin.z; z <= pMax.z; ++z)
+				{
+					for (int y = pMin.y; y <= pMax.y; ++y)
+					{
+						for (int x = pMin.x; x <= pMax.x; ++x)
+						{
+							// Add visible point to grid cell $(x, y, z)$
+							int h = hashCell(AVector3i(x, y, z), nPixels);
+							ASPPMPixelListNode *node = arena.Alloc<ASPPMPixelListNode>();
+							node->pixel = &pixel;
+
+							// Atomically add _node_ to the start of _grid[h]_'s linked list
+							node->next = grid[h];
+							while (!grid[h].compare_exchange_weak(node->next, node));
+						}
+					}
+				}
+			}
+		}, AExecutionPolicy::APARALLEL);
+	}
+
+	void ASPPMIntegrator::tracePhotons(const AScene &scene, int iteration,
+		const std::vector<std::atomic<ASPPMPixelListNode*>> &grid, const ABounds3f &gridBounds, const int gridRes[3])
+	{
+		if (gridRes[0] == 0)
+			return;
+
+		const int hashSize = (int)grid.size();
+		constexpr int chunkSize = 8192;
+		AParallelUtils::parallelFor((size_t)0, (size_t)((m_photonsPerIteration + chunkSize - 1) / chunkSize), [&](const size_t &c)
+		{
+			MemoryArena &arena = *m_photonArenas[AParallelUtils::getThreadIndex()];
+			const int end = glm::min(m_photonsPerIteration, (int)(c + 1) * chunkSize);
+			for (int photonIndex = (int)c * chunkSize; photonIndex < end; ++photonIndex)
+			{
+				// Every photon draws its random numbers from its own stream
+				ARng rng((uint64_t)iteration * (uint64_t)m_photonsPerIteration + (uint64_t)photonIndex);
+
+				// Choose light to shoot photon from
+				Float lightPdf;
+				int lightNum = m_photonDistribution->sample(rng.uniformFloat(), AVector3f(0.f), AVector3f(0.f), lightPdf);
+				if (lightNum < 0 || lightPdf == 0)
+					continue;
+				const ALight &light = *scene.m_lights[lightNum];
+
+				// Generate _photonRay_ from light source and initialize _beta_
+				AVector2f uLight0(rng.uniformFloat(), rng.uniformFloat());
+				AVector2f uLight1(rng.uniformFloat(), rng.uniformFloat());
+				ARay photonRay;
+				AVector3f nLight;
+				Float pdfPos, pdfDir;
+				ASpectrum Le = light.sample_Le(uLight0, uLight1, photonRay, nLight, pdfPos, pdfDir);
+				if (pdfPos == 0 || pdfDir == 0 || Le.isBlack())
+					continue;
+				ASpectrum beta = (absDot(nLight, photonRay.direction()) * Le) / (lightPdf * pdfPos * pdfDir);
+				if (beta.isBlack())
+					continue;
+
+				// Follow photon path through scene and record intersections
+				for (int depth = 0; depth < m_maxDepth; ++depth)
+				{
+					ASurfaceInteraction isect;
+					if (!scene.hit(photonRay, isect))
+						break;
+
+					// Direct illumination is estimated at the visible points already
+					if (depth > 0)
+					{
+						// Add photon contribution to nearby visible points
+						AVector3i photonGridIndex;
+						if (toGrid(isect.p, gridBounds, gridRes, photonGridIndex))
+						{
+							int h = hashCell(photonGridIndex, hashSize);
+							for (const ASPPMPixelListNode *node = grid[h].load(std::memory_order_relaxed);
+								node != nullptr; node = node->next)
+							{
+								ASPPMPixel &pixel = *node->pixel;
+								Float radius = pixel.radius;
+								if (distanceSquared(pixel.vp.p, isect.p) > radius * radius)
+									continue;
+
+								// Update _pixel_ $\Phi$ and $M$ for nearby photon
+								AVector3f wi = -photonRay.direction();
+								ASpectrum Phi = beta * pixel.vp.bsdf->f(pixel.vp.wo, wi);
+								for (int i = 0; i < ASpectrum::nSamples; ++i)
+									pixel.phi[i].add(Phi[i]);
+								++pixel.M;
+							}
+						}
+					}
+
+					// Sample new photon ray direction, skip over medium boundaries
+					isect.computeScatteringFunctions(photonRay, arena, true, ATransportMode::aImportance);
+					if (!isect.bsdf)
+					{
+						--depth;
+						photonRay = isect.spawnRay(photonRay.direction());
+						continue;
+					}
+					const ABSDF &photonBSDF = *isect.bsdf;
+
+					// Sample BSDF _fr_ and direction _wi_ for reflected photon
+					AVector3f wi, wo = -photonRay.direction();
+					Float pdf;
+					ABxDFType flags;
+					AVector2f bsdfSample(rng.uniformFloat(), rng.uniformFloat());
+					ASpectrum fr = photonBSDF.sample_f(wo, wi, bsdfSample, pdf, flags);
+					if (fr.isBlack() || pdf == 0.f)
+						break;
+					ASpectrum bnew = beta * fr * absDot(wi, isect.n) / pdf;
+
+					// Possibly terminate photon path with Russian roulette
+					Float q = glm::max((Float)0, 1 - bnew.y() / beta.y());
+					if (rng.uniformFloat() < q)
+						break;
+					beta = bnew / (1 - q);
+					photonRay = isect.spawnRay(wi);
+				}
+				arena.Reset();
+			}
+		}, AExecutionPolicy::APARALLEL);
+	}
+
+	void ASPPMIntegrator::updatePixels()
+	{
+		const int nPixels = m_pixelBounds.area();
+		constexpr int chunkSize = 4096;
+		AParallelUtils::parallelFor((size_t)0, (size_t)((nPixels + chunkSize - 1) / chunkSize), [&](const size_t &c)
+		{
+			const int end = glm::min(nPixels, (int)(c + 1) * chunkSize);
+			for (int i = (int)c * chunkSize; i < end; ++i)
+			{
+				ASPPMPixel &p = m_pixels[i];
+				int M = p.M.load();
+				if (M > 0)
+				{
+					// Update pixel photon count, search radius, and $\tau$ from photons
+					constexpr Float gamma = (Float)2 / (Float)3;
+					Float Nnew = p.N + gamma * M;
+					Float Rnew = p.radius * std::sqrt(Nnew / (p.N + M));
+					ASpectrum Phi;
+					for (int j = 0; j < ASpectrum::nSamples; ++j)
+					{
+						Phi[j] = p.phi[j];
+						p.phi[j] = (Float)0;
+					}
+					p.tau = (p.tau + p.vp.beta * Phi) * (Rnew * Rnew) / (p.radius * p.radius);
+					p.N = Nnew;
+					p.radius = Rnew;
+					p.M = 0;
+				}
+
+				// Reset _VisiblePoint_ in pixel
+				p.vp.beta = 0.;
+				p.vp.bsdf = nullptr;
+			}
+		}, AExecutionPolicy::APARALLEL);
+	}
+
+	void ASPPMIntegrator::writeImage(int nIterations)
+	{
+		if (nIterations == 0)
+			return;
+
+		// Combine the direct lighting with the density estimate of the indirect lighting
+		const int nPixels = m_pixelBounds.area();
+		const uint64_t Np = (uint64_t)nIterations * (uint64_t)m_photonsPerIteration;
+		std::unique_ptr<ASpectrum[]> image(new ASpectrum[nPixels]);
+		for (int i = 0; i < nPixels; ++i)
+		{
+			const ASPPMPixel &pixel = m_pixels[i];
+			image[i] = pixel.Ld / nIterations;
+			image[i] += pixel.tau / (Np * aPi * pixel.radius * pixel.radius);
+		}
+
+		AFilm &film = *m_camera->m_film;
+		film.setImage(image.get());
+		film.writeImageToFile();
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef ARSPPM_INTEGRATOR_H
+#define ARSPPM_INTEGRATOR_H
+
+#include "ArAurora.h"
+#include "ArMathUtils.h"
+#include "ArIntegrator.h"
+#include "ArLightDistrib.h"
+#include "ArParallel.h"
+#include "ArMemory.h"
+
+#include <atomic>
+
+namespace Aurora
+{
+	class ABSDF;
+
+	//Note: the photon statistics of one pixel. The visible point is the first diffuse (or the
+	//      last glossy) surface found by the camera path of the current iteration, the photons
+	//      arriving within |radius| of it are added to |phi| concurrently.
+	struct ASPPMPixel
+	{
+		ASPPMPixel() : M(0) {}
+
+		Float radius = 0;
+		ASpectrum Ld;						//direct lighting summed over the iterations
+
+		struct AVisiblePoint
+		{
+			AVector3f p;
+			AVector3f wo;
+			const ABSDF *bsdf = nullptr;
+			ASpectrum beta;
+		} vp;
+
+		AAtomicFloat phi[ASpectrum::nSamples];	//flux of the photons of this iteration
+		std::atomic<int> M;					//number of photons of this iteration
+		Float N = 0;						//photon count after the radius reductions
+		ASpectrum tau;						//accumulated flux
+	};
+
+	struct ASPPMPixelListNode
+	{
+		ASPPMPixel *pixel;
+		ASPPMPixelListNode *next;
+	};
+
+	//Note: stochastic progressive photon mapping (Hachisuka and Jensen 2009). Every iteration
+	//      traces a camera path per pixel up to its first diffuse surface, hashes these visible
+	//      points into a grid of cells as large as the largest search radius and then traces
+	//      photons from the lights, which add their flux to all the visible points around their
+	//      surface hits. The search radii shrink progressively, which makes the estimate of
+	//      caustics and other specular-diffuse-specular paths consistent. The grid and the
+	//      photon paths live in per-thread arenas that are reset after every iteration, so that
+	//      the memory doesn't grow with the number of iterations. The samples per pixel of the
+	//      sampler are the number of iterations.
+	class ASPPMIntegrator : public AIntegrator
+	{
+	public:
+
+		ASPPMIntegrator(const APropertyTreeNode &props);
+
+		ASPPMIntegrator(ACamera::ptr camera, ASampler::ptr sampler, int maxDepth,
+			int photonsPerIteration, Float initialSearchRadius, const std::string &lightSampleStrategy = "bvh");
+
+		virtual void preprocess(const AScene &scene) override;
+
+		virtual void render(const AScene &scene) override;
+
+		virtual std::string toString() const override { return "SPPMIntegrator[]"; }
+
+	private:
+		// Find the visible point of every pixel and add the direct lighting seen along the way
+		void generateVisiblePoints(const AScene &scene, int iteration);
+
+		// Hash the visible points into a grid over their search regions, the nodes are allocated from |arenas|
+		void buildGrid(std::vector<std::atomic<ASPPMPixelListNode*>> &grid, ABounds3f &gridBounds, int gridRes[3]);
+
+		// Trace the photons of the iteration and add them to the visible points around their hits
+		void tracePhotons(const AScene &scene, int iteration,
+			const std::vector<std::atomic<ASPPMPixelListNode*>> &grid, const ABounds3f &gridBounds, const int gridRes[3]);
+
+		// Shrink the search radii, accumulate the photon flux and clear the visible points
+		void updatePixels();
+
+		void writeImage(int nIterations);
+
+		ACamera::ptr m_camera;
+		ASampler::ptr m_sampler;
+
+		int m_maxDepth;
+		int m_photonsPerIteration;		//-1 -> one photon per pixel
+		Float m_initialSearchRadius;
+		std::string m_lightSampleStrategy;
+
+		std::unique_ptr<ALightDistribution> m_lightDistribution;	//direct lighting of the visible points
+		std::unique_ptr<ALightDistribution> m_photonDistribution;	//photons start proportionally to the light power
+
+		ABounds2i m_pixelBounds;
+		std::unique_ptr<ASPPMPixel[]> m_pixels;
+
+		//Note: per-thread arenas, the ones of the visible points and the grid are reset after
+		//      every iteration and the ones of the photon paths after every photon
+		std::vector<MemoryArena::ptr> m_arenas, m_photonArenas;
+	};
+
+}
+
+#endif
\ No newline at end of file
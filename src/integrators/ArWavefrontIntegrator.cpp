@@ -0,0 +1,457 @@
+#include "ArWavefrontIntegrator.h"
+
+#include "ArScene.h"
+#include "ArBSDF.h"
+#include "ArParallel.h"
+
+#include <algorithm>
+
+namespace Aurora
+{
+	//-------------------------------------------APathQueue-------------------------------------
+
+	void APathQueue::clear()
+	{
+		ray.clear(); L.clear(); beta.clear(); etaScale.clear();
+		bounces.clear(); specularBounce.clear(); rng.clear();
+		isect.clear(); hit.clear();
+		pFilm.clear(); rayWeight.clear(); filterWeight.clear(); pixel.clear(); sampleNumber.clear();
+	}
+
+	void APathQueue::push(const ARay &r, const ACameraSample &cameraSample, Float weight,
+		const AVector2i &p, int64_t number, uint64_t rngSequence)
+	{
+		ray.push_back(r);
+		L.push_back(ASpectrum(0.f));
+		beta.push_back(ASpectrum(1.f));
+		etaScale.push_back(1.f);
+		bounces.push_back(0);
+		specularBounce.push_back(false);
+		rng.push_back(ARng(rngSequence));
+		isect.push_back(ASurfaceInteraction());
+		hit.push_back(false);
+		pFilm.push_back(cameraSample.pFilm);
+		rayWeight.push_back(weight);
+		filterWeight.push_back(cameraSample.filterWeight);
+		pixel.push_back(p);
+		sampleNumber.push_back(number);
+	}
+
+	//-------------------------------------------AWavefrontIntegrator-------------------------------------
+
+	AURORA_REGISTER_CLASS(AWavefrontIntegrator, "Wavefront")
+
+	AWavefrontIntegrator::AWavefrontIntegrator(const APropertyTreeNode &node)
+		: ASamplerIntegrator(nullptr, nullptr), m_maxDepth(node.getPropertyList().getInteger("Depth", 2))
+		, m_rrThreshold(1.f)
+		, m_lightSampleStrategy(node.getPropertyList().getString("LightSampleStrategy", "bvh"))
+		, m_queueSize(node.getPropertyList().getInteger("QueueSize", 16384))
+	{
+		//Sampler
+		const auto &samplerNode = node.getPropertyChild("Sampler");
+		m_sampler = ASampler::ptr(static_cast<ASampler*>(AObjectFactory::createInstance(
+			samplerNode.getTypeName(), samplerNode)));
+
+		//Camera
+		const auto &cameraNode = node.getPropertyChild("Camera");
+		m_camera = ACamera::ptr(static_cast<ACamera*>(AObjectFactory::createInstance(
+			cameraNode.getTypeName(), cameraNode)));
+
+		activate();
+	}
+
+	AWavefrontIntegrator::AWavefrontIntegrator(int maxDepth, ACamera::ptr camera, ASampler::ptr sampler,
+		Float rrThreshold, const std::string &lightSampleStrategy, int queueSize)
+		: ASamplerIntegrator(camera, sampler), m_maxDepth(maxDepth), m_rrThreshold(rrThreshold),
+		m_lightSampleStrategy(lightSampleStrategy), m_queueSize(queueSize) {}
+
+	void AWavefrontIntegrator::preprocess(const AScene &scene)
+	{
+		m_lightDistribution = createLightSampleDistribution(m_lightSampleStrategy, scene);
+	}
+
+	void AWavefrontIntegrator::render(const AScene &scene)
+	{
+		if (m_queues.size() != (size_t)numSystemCores())
+		{
+			m_queues.clear();
+			for (int i = 0; i < numSystemCores(); ++i)
+			{
+				m_queues.push_back(std::unique_ptr<AWavefrontQueues>(new AWavefrontQueues()));
+			}
+		}
+
+		ASamplerIntegrator::render(scene);
+	}
+
+	void AWavefrontIntegrator::renderTile(const AScene &scene, const ABounds2i &tileBounds,
+		ASampler &tileSampler, AFilmTile &filmTile, MemoryArena &arena)
+	{
+		// Adaptive sampling decides sample by sample, which doesn't fit waves of paths
+		if (tileSampler.isAdaptive())
+		{
+			ASamplerIntegrator::renderTile(scene, tileBounds, tileSampler, filmTile, arena);
+			return;
+		}
+
+		AWavefrontQueues &queues = *m_queues[AParallelUtils::getThreadIndex()];
+		APathQueue &paths = queues.paths;
+		const AFilterSampler *filterSampler = m_camera->m_film->getFilterSampler();
+
+		std::vector<AVector2i> pixels;
+		for (AVector2i pixel : tileBounds)
+		{
+			pixels.push_back(pixel);
+		}
+
+		// Generate the camera rays of as many pixels as fit into the queue, trace them
+		// all together and repeat with the remaining pixels of the tile
+		const int64_t spp = tileSampler.getEndSampleNumber() - tileSampler.getFirstSampleNumber();
+		size_t next = 0;
+		while (next < pixels.size())
+		{
+			paths.clear();
+			queues.active.clear();
+			do
+			{
+				const AVector2i &pixel = pixels[next++];
+				tileSampler.startPixel(pixel);
+				do
+				{
+					ACameraSample cameraSample = tileSampler.getCameraSample(pixel, filterSampler);
+					ARay ray;
+					Float rayWeight = m_camera->castingRay(cameraSample, ray);
+
+					// Note: the random number sequence of a path only depends on its pixel and sample number
+					int64_t sampleNumber = tileSampler.currentSampleNumber();
+					uint64_t sequence = ((uint64_t)(uint32_t)pixel.x << 40) ^
+						((uint64_t)(uint32_t)pixel.y << 20) ^ (uint64_t)sampleNumber;
+
+					if (rayWeight > 0)
+					{
+						queues.active.push_back((int)paths.size());
+						if (filmTile.isRecordingFeatures())
+						{
+							addFeatures(scene, ray, pixel, filmTile, arena);
+						}
+					}
+					paths.push(ray, cameraSample, rayWeight, pixel, sampleNumber, sequence);
+
+				} while (tileSampler.startNextSample());
+			} while (next < pixels.size() && (int64_t)paths.size() + spp <= m_queueSize);
+
+			tracePaths(scene, queues, arena);
+
+			// Add the contributions of all the camera rays to image
+			for (size_t i = 0; i < paths.size(); ++i)
+			{
+				checkRadiance(paths.L[i], paths.pixel[i], paths.sampleNumber[i]);
+				VLOG(1) << "Camera sample: " << paths.pFilm[i] << " -> L = " << paths.L[i];
+				if (filmTile.isFilterSampling())
+				{
+					filmTile.addPixelSample(paths.pixel[i], paths.L[i], paths.rayWeight[i], paths.filterWeight[i]);
+				}
+				else
+				{
+					filmTile.addSample(paths.pFilm[i], paths.L[i], paths.rayWeight[i]);
+				}
+			}
+		}
+	}
+
+	ASpectrum AWavefrontIntegrator::Li(const ARay &ray, const AScene &scene, ASampler &sampler,
+		MemoryArena &arena, int depth) const
+	{
+		// A single path in flight in the queues of this thread, seeded from the sampler
+		AWavefrontQueues &queues = *m_queues[AParallelUtils::getThreadIndex()];
+		queues.paths.clear();
+		queues.active.clear();
+		uint64_t sequence = (uint64_t)(sampler.get1D() * 4294967296.0);
+		queues.paths.push(ray, ACameraSample(), 1.f, AVector2i(0), sampler.currentSampleNumber(), sequence);
+		queues.active.push_back(0);
+		tracePaths(scene, queues, arena);
+		return queues.paths.L[0];
+	}
+
+	void AWavefrontIntegrator::tracePaths(const AScene &scene, AWavefrontQueues &queues, MemoryArena &arena) const
+	{
+		while (!queues.active.empty())
+		{
+			intersectStage(scene, queues);
+			emissionStage(scene, queues);
+			materialStage(queues, arena);
+			lightSampleStage(scene, queues);
+			shadowRayStage(scene, queues, arena);
+			lightRayStage(scene, queues, arena);
+			scatterStage(queues);
+
+			// All the bsdfs of this bounce are dead now
+			arena.Reset();
+		}
+	}
+
+	void AWavefrontIntegrator::intersectStage(const AScene &scene, AWavefrontQueues &queues) const
+	{
+		APathQueue &paths = queues.paths;
+		for (int i : queues.active)
+		{
+			paths.isect[i] = ASurfaceInteraction();
+			paths.hit[i] = scene.hit(paths.ray[i], paths.isect[i]);
+		}
+	}
+
+	void AWavefrontIntegrator::emissionStage(const AScene &scene, AWavefrontQueues &queues) const
+	{
+		APathQueue &paths = queues.paths;
+		size_t nAlive = 0;
+		for (int i : queues.active)
+		{
+			// Possibly add emitted light at intersection
+			if (paths.bounces[i] == 0 || paths.specularBounce[i])
+			{
+				// Add emitted light at path vertex or from the environment
+				if (paths.hit[i])
+				{
+					paths.L[i] += paths.beta[i] * paths.isect[i].Le(-paths.ray[i].direction());
+				}
+				else
+				{
+					for (const auto &light : scene.m_infiniteLights)
+						paths.L[i] += paths.beta[i] * light->Le(paths.ray[i]);
+				}
+			}
+
+			// Terminate path if ray escaped or _maxDepth_ was reached
+			if (paths.hit[i] && paths.bounces[i] < m_maxDepth)
+			{
+				queues.active[nAlive++] = i;
+			}
+		}
+		queues.active.resize(nAlive);
+	}
+
+	void AWavefrontIntegrator::materialStage(AWavefrontQueues &queues, MemoryArena &arena) const
+	{
+		APathQueue &paths = queues.paths;
+
+		// Sort the paths by material so that the same bsdf setup runs back to back
+		std::sort(queues.active.begin(), queues.active.end(), [&](int a, int b) -> bool
+		{
+			return paths.isect[a].hitable->getMaterial() < paths.isect[b].hitable->getMaterial();
+		});
+
+		queues.shading.clear();
+		for (int i : queues.active)
+		{
+			ASurfaceInteraction &isect = paths.isect[i];
+			isect.computeScatteringFunctions(paths.ray[i], arena, true);
+
+			// Note: bsdf == nullptr indicates that the current surface has no effect on light,
+			//       the path skips over it without counting a bounce.
+			if (!isect.bsdf)
+			{
+				paths.ray[i] = isect.spawnRay(paths.ray[i].direction());
+				continue;
+			}
+			queues.shading.push_back(i);
+		}
+	}
+
+	void AWavefrontIntegrator::lightSampleStage(const AScene &scene, AWavefrontQueues &queues) const
+	{
+		APathQueue &paths = queues.paths;
+		queues.shadowRays.clear();
+		queues.lightRays.clear();
+
+		const int nLights = int(scene.m_lights.size());
+		if (nLights == 0)
+			return;
+
+		const ABxDFType bsdfFlags = ABxDFType(BSDF_ALL & ~BSDF_SPECULAR);
+		for (int i : queues.shading)
+		{
+			const ASurfaceInteraction &isect = paths.isect[i];
+			ARng &rng = paths.rng[i];
+
+			// Skip light sampling for perfectly specular BSDFs
+			if (isect.bsdf->numComponents(bsdfFlags) == 0)
+				continue;
+
+			// Randomly choose a single light to sample
+			Float lightSelectPdf;
+			int lightIndex = m_lightDistribution->sample(rng.uniformFloat(), isect.p, isect.n, lightSelectPdf);
+			if (lightSelectPdf == 0)
+				continue;
+
+			const ALight &light = *scene.m_lights[lightIndex];
+			AVector2f uLight(rng.uniformFloat(), rng.uniformFloat());
+			AVector2f uScattering(rng.uniformFloat(), rng.uniformFloat());
+
+			// Sample light source, the shadow ray is traced in the next stage
+			AVector3f wi;
+			Float lightPdf = 0, scatteringPdf = 0;
+			AVisibilityTester visibility;
+			ASpectrum Li = light.sample_Li(isect, uLight, wi, lightPdf, visibility);
+			if (lightPdf > 0 && !Li.isBlack())
+			{
+				ASpectrum f = isect.bsdf->f(isect.wo, wi, bsdfFlags) * absDot(wi, isect.n);
+				scatteringPdf = isect.bsdf->pdf(isect.wo, wi, bsdfFlags);
+				if (!f.isBlack())
+				{
+					Float weight = isDeltaLight(light.m_flags) ? 1 : powerHeuristic(1, lightPdf, 1, scatteringPdf);
+					queues.shadowRays.path.push_back(i);
+					queues.shadowRays.ray.push_back(visibility.P0().spawnRayTo(visibility.P1()));
+					queues.shadowRays.Ld.push_back(paths.beta[i] * f * Li * weight / (lightPdf * lightSelectPdf));
+				}
+			}
+
+			// Sample BSDF with multiple importance sampling, the ray is traced in the next stage
+			if (!isDeltaLight(light.m_flags))
+			{
+				ABxDFType sampledType;
+				ASpectrum f = isect.bsdf->sample_f(isect.wo, wi, uScattering, scatteringPdf, sampledType, bsdfFlags);
+				f *= absDot(wi, isect.n);
+				if (!f.isBlack() && scatteringPdf > 0)
+				{
+					Float weight = 1;
+					if ((sampledType & BSDF_SPECULAR) == 0)
+					{
+						lightPdf = light.pdf_Li(isect, wi);
+						if (lightPdf == 0)
+							continue;
+						weight = powerHeuristic(1, scatteringPdf, 1, lightPdf);
+					}
+					queues.lightRays.path.push_back(i);
+					queues.lightRays.ray.push_back(isect.spawnRay(wi));
+					queues.lightRays.light.push_back(&light);
+					queues.lightRays.weight.push_back(paths.beta[i] * f * weight / (scatteringPdf * lightSelectPdf));
+				}
+			}
+		}
+	}
+
+	void AWavefrontIntegrator::shadowRayStage(const AScene &scene, AWavefrontQueues &queues, MemoryArena &arena) const
+	{
+		AShadowRayQueue &shadowRays = queues.shadowRays;
+		const int nRays = int(shadowRays.path.size());
+		if (nRays == 0)
+			return;
+
+		// All the shadow rays of this bounce are tested as one batch
+		bool *occluded = arena.Alloc<bool>(nRays, false);
+		scene.occluded(shadowRays.ray.data(), nRays, occluded);
+		for (int k = 0; k < nRays; ++k)
+		{
+			if (!occluded[k])
+			{
+				queues.paths.L[shadowRays.path[k]] += shadowRays.Ld[k];
+			}
+		}
+	}
+
+	void AWavefrontIntegrator::lightRayStage(const AScene &scene, AWavefrontQueues &queues, MemoryArena &arena) const
+	{
+		ALightRayQueue &lightRays = queues.lightRays;
+		const int nRays = int(lightRays.path.size());
+		if (nRays == 0)
+			return;
+
+		// Note: a ray towards an area light needs the closest hit to know whether it reaches that light,
+		//       a ray towards an infinite light only has to escape the scene, those are tested as one batch.
+		ARay *escapeRays = arena.Alloc<ARay>(nRays, false);
+		int *escapeIndices = arena.Alloc<int>(nRays, false);
+		int nEscapeRays = 0;
+		for (int k = 0; k < nRays; ++k)
+		{
+			const ARay &ray = lightRays.ray[k];
+			if (lightRays.light[k]->m_flags & (int)ALightFlags::ALightInfinite)
+			{
+				escapeRays[nEscapeRays] = ray;
+				escapeIndices[nEscapeRays++] = k;
+				continue;
+			}
+
+			// Add light contribution if the ray reaches the sampled light
+			ASurfaceInteraction lightIsect;
+			if (scene.hit(ray, lightIsect) && lightIsect.hitable->getAreaLight() == lightRays.light[k])
+			{
+				ASpectrum Li = lightIsect.Le(-ray.direction());
+				if (!Li.isBlack())
+					queues.paths.L[lightRays.path[k]] += lightRays.weight[k] * Li;
+			}
+		}
+
+		if (nEscapeRays == 0)
+			return;
+
+		bool *occluded = arena.Alloc<bool>(nEscapeRays, false);
+		scene.occluded(escapeRays, nEscapeRays, occluded);
+		for (int e = 0; e < nEscapeRays; ++e)
+		{
+			if (occluded[e])
+				continue;
+			int k = escapeIndices[e];
+			ASpectrum Li = lightRays.light[k]->Le(lightRays.ray[k]);
+			if (!Li.isBlack())
+				queues.paths.L[lightRays.path[k]] += lightRays.weight[k] * Li;
+		}
+	}
+
+	void AWavefrontIntegrator::scatterStage(AWavefrontQueues &queues) const
+	{
+		APathQueue &paths = queues.paths;
+
+		// Paths that passed through a surface without bsdf stay alive as they are
+		size_t nAlive = 0;
+		for (int i : queues.active)
+		{
+			if (paths.isect[i].bsdf == nullptr)
+				queues.active[nAlive++] = i;
+		}
+		queues.active.resize(nAlive);
+
+		for (int i : queues.shading)
+		{
+			const ASurfaceInteraction &isect = paths.isect[i];
+			ARng &rng = paths.rng[i];
+			ASpectrum &beta = paths.beta[i];
+
+			// Sample BSDF to get new path direction
+			AVector3f wo = -paths.ray[i].direction(), wi;
+			Float pdf;
+			ABxDFType flags;
+			AVector2f u(rng.uniformFloat(), rng.uniformFloat());
+			ASpectrum f = isect.bsdf->sample_f(wo, wi, u, pdf, flags, BSDF_ALL);
+			if (f.isBlack() || pdf == 0.f)
+				continue;
+			beta *= f * absDot(wi, isect.n) / pdf;
+
+			DCHECK(!glm::isinf(beta.y()));
+
+			paths.specularBounce[i] = (flags & BSDF_SPECULAR) != 0;
+			if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION))
+			{
+				// Update the term that tracks radiance scaling for refraction
+				Float eta = isect.bsdf->m_eta;
+				paths.etaScale[i] *= (dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+			}
+
+			paths.ray[i] = isect.spawnRay(wi);
+
+			// Possibly terminate the path with Russian roulette
+			ASpectrum rrBeta = beta * paths.etaScale[i];
+			if (rrBeta.maxComponentValue() < m_rrThreshold && paths.bounces[i] > 3)
+			{
+				Float q = glm::max((Float).05f, 1 - rrBeta.maxComponentValue());
+				if (rng.uniformFloat() < q)
+					continue;
+				beta /= 1 - q;
+				DCHECK(!glm::isinf(beta.y()));
+			}
+
+			++paths.bounces[i];
+			queues.active.push_back(i);
+		}
+	}
+
+}
@@ -0,0 +1,117 @@
+#ifndef ARWAVEFRONT_INTEGRATOR_H
+#define ARWAVEFRONT_INTEGRATOR_H
+
+#include "ArAurora.h"
+#include "ArMathUtils.h"
+#include "ArIntegrator.h"
+#include "ArInteraction.h"
+#include "ArLightDistrib.h"
+#include "ArLight.h"
+#include "ArRng.h"
+
+namespace Aurora
+{
+	//Note: structure-of-arrays state of the paths in flight, indexed by path id
+	struct APathQueue
+	{
+		std::vector<ARay> ray;
+		std::vector<ASpectrum> L, beta;
+		std::vector<Float> etaScale;
+		std::vector<int> bounces;
+		std::vector<uint8_t> specularBounce;
+		std::vector<ARng> rng;
+		std::vector<ASurfaceInteraction> isect;
+		std::vector<uint8_t> hit;
+
+		// Camera sample of the path
+		std::vector<AVector2f> pFilm;
+		std::vector<Float> rayWeight, filterWeight;
+		std::vector<AVector2i> pixel;
+		std::vector<int64_t> sampleNumber;
+
+		size_t size() const { return ray.size(); }
+		void clear();
+		void push(const ARay &r, const ACameraSample &cameraSample, Float rayWeight,
+			const AVector2i &pixel, int64_t sampleNumber, uint64_t rngSequence);
+	};
+
+	//Note: shadow rays of light sampling, the contribution is added if the ray is unoccluded
+	struct AShadowRayQueue
+	{
+		std::vector<int> path;
+		std::vector<ARay> ray;
+		std::vector<ASpectrum> Ld;
+
+		void clear() { path.clear(); ray.clear(); Ld.clear(); }
+	};
+
+	//Note: rays of BSDF sampling, the contribution is added if the ray reaches the sampled light
+	struct ALightRayQueue
+	{
+		std::vector<int> path;
+		std::vector<ARay> ray;
+		std::vector<const ALight*> light;
+		std::vector<ASpectrum> weight;
+
+		void clear() { path.clear(); ray.clear(); light.clear(); weight.clear(); }
+	};
+
+	struct AWavefrontQueues
+	{
+		APathQueue paths;
+		std::vector<int> active;	//paths still alive
+		std::vector<int> shading;	//alive paths at a surface with a bsdf
+		AShadowRayQueue shadowRays;
+		ALightRayQueue lightRays;
+	};
+
+	//Note: the same estimator as APathIntegrator, but instead of following one path at a time
+	//      it keeps up to m_queueSize paths of a tile in flight and advances all of them stage
+	//      by stage (intersection, emission, material, light sampling, shadow rays, scattering).
+	//      Every path draws its random numbers after the camera sample from its own ARng.
+	class AWavefrontIntegrator : public ASamplerIntegrator
+	{
+	public:
+
+		AWavefrontIntegrator(const APropertyTreeNode &props);
+
+		AWavefrontIntegrator(int maxDepth, ACamera::ptr camera, ASampler::ptr sampler,
+			Float rrThreshold = 1, const std::string &lightSampleStrategy = "bvh", int queueSize = 16384);
+
+		virtual void preprocess(const AScene &scene) override;
+
+		virtual void render(const AScene &scene) override;
+
+		virtual void renderTile(const AScene &scene, const ABounds2i &tileBounds,
+			ASampler &tileSampler, AFilmTile &filmTile, MemoryArena &arena) override;
+
+		virtual ASpectrum Li(const ARay &ray, const AScene &scene, ASampler &sampler,
+			MemoryArena &arena, int depth) const override;
+
+		virtual std::string toString() const override { return "WavefrontIntegrator[]"; }
+
+	private:
+		// Advance all the paths of the queues until every one of them is terminated
+		void tracePaths(const AScene &scene, AWavefrontQueues &queues, MemoryArena &arena) const;
+
+		void intersectStage(const AScene &scene, AWavefrontQueues &queues) const;
+		void emissionStage(const AScene &scene, AWavefrontQueues &queues) const;
+		void materialStage(AWavefrontQueues &queues, MemoryArena &arena) const;
+		void lightSampleStage(const AScene &scene, AWavefrontQueues &queues) const;
+		void shadowRayStage(const AScene &scene, AWavefrontQueues &queues, MemoryArena &arena) const;
+		void lightRayStage(const AScene &scene, AWavefrontQueues &queues, MemoryArena &arena) const;
+		void scatterStage(AWavefrontQueues &queues) const;
+
+		int m_maxDepth;
+		Float m_rrThreshold;
+		std::string m_lightSampleStrategy;
+		int m_queueSize;
+		std::unique_ptr<ALightDistribution> m_lightDistribution;
+
+		//Note: per-thread queues kept alive across tiles, like the memory arenas
+		std::vector<std::unique_ptr<AWavefrontQueues>> m_queues;
+	};
+
+}
+
+#endif
@@ -56,23 +56,40 @@ namespace Aurora
 		// Compute emitted light if ray hit an area light source -> Le (emission term)
 		L += isect.Le(wo);
 
-		// Add contribution of each light source -> shadow ray
+		// Add contribution of each light source -> shadow ray. Every light takes its stratified
+		// samples and the shadow rays of all of them are tested as one batch
+		int nShadowRays = 0;
+		for (const auto &light : scene.m_lights)
+			nShadowRays += light->m_nSamples;
+		AShadowRayBatch shadowRays(arena, nShadowRays);
 		for (const auto &light : scene.m_lights)
 		{
-			AVector3f wi;
-			Float pdf;
-			AVisibilityTester visibility;
-			ASpectrum Li = light->sample_Li(isect, sampler.get2D(), wi, pdf, visibility);
-
-			if (Li.isBlack() || pdf == 0)
-				continue;
-
-			ASpectrum f = isect.bsdf->f(wo, wi);
-			if (!f.isBlack() && visibility.unoccluded(scene))
+			const int nSamples = light->m_nSamples;
+			AVector2f *uLight = arena.Alloc<AVector2f>(nSamples, false);
+			if (nSamples == 1)
+				uLight[0] = sampler.get2D();
+			else
+				latinHypercube(uLight, nSamples, sampler);
+
+			shadowRays.setWeight((Float)1 / nSamples);
+			for (int k = 0; k < nSamples; ++k)
 			{
-				L += f * Li * absDot(wi, n) / pdf;
+				AVector3f wi;
+				Float pdf;
+				AVisibilityTester visibility;
+				ASpectrum Li = light->sample_Li(isect, uLight[k], wi, pdf, visibility);
+
+				if (Li.isBlack() || pdf == 0)
+					continue;
+
+				ASpectrum f = isect.bsdf->f(wo, wi);
+				if (!f.isBlack())
+				{
+					shadowRays.add(visibility.P0().spawnRayTo(visibility.P1()), f * Li * absDot(wi, n) / pdf);
+				}
 			}
 		}
+		L += shadowRays.resolve(scene);
 
 		if (depth + 1 < m_maxDepth)
 		{
@@ -49,6 +49,18 @@ namespace Aurora
 		return (m_twoSided ? 2 : 1) * m_Lemit * m_area * aPi;
 	}
 
+	bool ADiffuseAreaLight::bounds(ALightBounds &bounds) const
+	{
+		ADirectionCone normals = m_shape->normalBounds();
+		bounds.m_bounds = m_shape->worldBound();
+		bounds.m_phi = power().maxComponentValue();
+		bounds.m_w = normals.m_w;
+		bounds.m_cosTheta_o = normals.m_cosTheta;
+		bounds.m_cosTheta_e = glm::cos(aPiOver2);
+		bounds.m_twoSided = m_twoSided;
+		return true;
+	}
+
 	ASpectrum ADiffuseAreaLight::sample_Li(const AInteraction &ref, const AVector2f &u, AVector3f &wi,
 		Float &pdf, AVisibilityTester &vis) const
 	{
@@ -22,6 +22,8 @@ namespace Aurora
 
 		virtual ASpectrum power() const override;
 
+		virtual bool bounds(ALightBounds &bounds) const override;
+
 		virtual ASpectrum sample_Li(const AInteraction &ref, const AVector2f &u, AVector3f &wo,
 			Float &pdf, AVisibilityTester &vis) const override;
 
@@ -0,0 +1,69 @@
+#include "ArBlueNoiseSampler.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(ABlueNoiseSampler, "BlueNoise")
+
+	constexpr int ABlueNoiseSampler::aTileSize;
+	constexpr int ABlueNoiseSampler::aNumPairs;
+
+	ABlueNoiseSampler::ABlueNoiseSampler(const APropertyTreeNode &node) : ALowDiscrepancySampler(node.getPropertyList())
+	{
+		if (!isPowerOf2(samplesPerPixel))
+			LOG(WARNING) << "BlueNoise sampler with " << samplesPerPixel << " samples per pixel, powers of two stratify best";
+		activate();
+	}
+
+	ABlueNoiseSampler::ABlueNoiseSampler(int64_t samplesPerPixel, int seed) : ALowDiscrepancySampler(samplesPerPixel, seed) {}
+
+	std::unique_ptr<ASampler> ABlueNoiseSampler::clone(int seed)
+	{
+		ABlueNoiseSampler *bs = new ABlueNoiseSampler(*this);
+		bs->setCloneSeed(seed);
+		return std::unique_ptr<ASampler>(bs);
+	}
+
+	// Sample |index| of a pair of dimensions with the keys of the pixel, |hash| Owen-scrambles the bits below them
+	static AVector2f blueNoiseSample(const uint8_t *keys, uint32_t pair, uint32_t index, uint64_t hash)
+	{
+		uint32_t x, y;
+		ABlueNoiseSampler::keyedSample(keys, pair, index, x, y);
+		x = (x & 0xff000000u) | (nestedUniformScramble(x, (uint32_t)hash) & 0x00ffffffu);
+		y = (y & 0xff000000u) | (nestedUniformScramble(y, (uint32_t)(hash >> 32)) & 0x00ffffffu);
+		return AVector2f(toUnitFloat(x), toUnitFloat(y));
+	}
+
+	Float ABlueNoiseSampler::sample1D(int64_t index, uint32_t dimension) const
+	{
+		AVector2f u = sample2D(index, dimension & ~1u);
+		return (dimension & 1) ? u.y : u.x;
+	}
+
+	AVector2f ABlueNoiseSampler::sample2D(int64_t index, uint32_t dimension) const
+	{
+		// A pair that starts at an odd dimension takes one dimension from each of two pairs
+		if (dimension & 1)
+			return AVector2f(sample1D(index, dimension), sample1D(index, dimension + 1));
+
+		uint64_t hash = hashSample(m_currentPixel, dimension, m_seed);
+		uint32_t pair = dimension >> 1;
+		if (pair < aNumPairs)
+		{
+			// Other seeds look the keys up at other offsets into the tile
+			uint32_t offset = (uint32_t)mixBits(m_seed);
+			int x = (m_currentPixel.x + (int)(offset & (aTileSize - 1))) & (aTileSize - 1);
+			int y = (m_currentPixel.y + (int)((offset >> 16) & (aTileSize - 1))) & (aTileSize - 1);
+			const uint8_t *keys = &aKeys[((y * aTileSize + x) * aNumPairs + pair) * 3];
+			return blueNoiseSample(keys, pair, (uint32_t)index, mixBits(hash));
+		}
+
+		// Owen-scrambled Sobol padding as in ASobolSampler
+		uint32_t i = nestedUniformScramble((uint32_t)index, (uint32_t)hash);
+		uint32_t x, y;
+		sobol2D(i, x, y);
+		uint64_t scramble = mixBits(hash);
+		return AVector2f(toUnitFloat(nestedUniformScramble(x, (uint32_t)(hash >> 32))),
+			toUnitFloat(nestedUniformScramble(y, (uint32_t)scramble)));
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef ARBLUENOISESAMPLER_H
+#define ARBLUENOISESAMPLER_H
+
+#include "ArLowDiscrepancy.h"
+
+namespace Aurora
+{
+	//Note: Sobol samples whose errors are distributed as a blue noise in screen space (Heitz et
+	//      al. 2019). The pixels of a 64 x 64 tile repeated over the image have precomputed keys
+	//      for the first aNumPairs pairs of dimensions: a ranking key that selects the aligned
+	//      block of Sobol points the pixel takes its samples from, and scrambling keys that shift
+	//      the 8 leading bits of the coordinates. The keys were optimized offline by
+	//      src/tools/ArBlueNoiseTableGen.cpp so that neighbouring pixels make different errors
+	//      at all the sample counts from 1 to 64, which keeps the error blue along the passes of
+	//      a progressive render. The bits below the keys are Owen-scrambled per pixel, and the
+	//      dimensions past the tables are padded as in the Sobol sampler.
+	class ABlueNoiseSampler final : public ALowDiscrepancySampler
+	{
+	public:
+		typedef std::shared_ptr<ABlueNoiseSampler> ptr;
+
+		ABlueNoiseSampler(const APropertyTreeNode &node);
+		ABlueNoiseSampler(int64_t samplesPerPixel, int seed = 0);
+
+		virtual int roundCount(int n) const override { return (int)roundUpPow2(n); }
+
+		virtual std::unique_ptr<ASampler> clone(int seed) override;
+
+		virtual std::string toString() const override { return "BlueNoiseSampler[]"; }
+
+		static constexpr int aTileSize = 64;
+		static constexpr int aNumPairs = 4;
+
+		// Ranking, x and y scrambling key of every pair of dimensions of every pixel of the tile
+		static const uint8_t aKeys[aTileSize * aTileSize * aNumPairs * 3];
+
+		// The 32 bit coordinates of sample |index| of pair |pair| with the keys |keys|. Every pair
+		// takes the Sobol points in another fixed order, which decorrelates the pairs
+		static void keyedSample(const uint8_t *keys, uint32_t pair, uint32_t index, uint32_t &x, uint32_t &y)
+		{
+			sobol2D(nestedUniformScramble(index ^ keys[0], (uint32_t)mixBits(pair + 1)), x, y);
+			x ^= (uint32_t)keys[1] << 24;
+			y ^= (uint32_t)keys[2] << 24;
+		}
+
+	protected:
+		virtual Float sample1D(int64_t index, uint32_t dimension) const override;
+		virtual AVector2f sample2D(int64_t index, uint32_t dimension) const override;
+	};
+}
+
+#endif
\ No newline at end of file
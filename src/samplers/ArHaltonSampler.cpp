@@ -0,0 +1,67 @@
+#include "ArHaltonSampler.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(AHaltonSampler, "Halton")
+
+	constexpr int AHaltonSampler::aBaseScales[2];
+	constexpr int AHaltonSampler::aBaseExponents[2];
+	constexpr uint64_t AHaltonSampler::aSampleStride;
+
+	AHaltonSampler::AHaltonSampler(const APropertyTreeNode &node) : ALowDiscrepancySampler(node.getPropertyList()) { activate(); }
+
+	AHaltonSampler::AHaltonSampler(int64_t samplesPerPixel, int seed) : ALowDiscrepancySampler(samplesPerPixel, seed) {}
+
+	std::unique_ptr<ASampler> AHaltonSampler::clone(int seed)
+	{
+		AHaltonSampler *hs = new AHaltonSampler(*this);
+		hs->setCloneSeed(seed);
+		return std::unique_ptr<ASampler>(hs);
+	}
+
+	void AHaltonSampler::startPixel(const AVector2i &p)
+	{
+		// The first Halton index that falls into pixel p: its scaled radical inverses in base 2 and 3
+		// are p mod the scales, i.e. the index modulo 2^7 and 3^5 are known and combine to the
+		// index modulo the stride
+		m_pixelOffset = 0;
+		for (int i = 0; i < 2; ++i)
+		{
+			int scale = aBaseScales[i];
+			uint64_t pm = (uint64_t)(((i == 0 ? p.x : p.y) % scale + scale) % scale);
+			uint64_t dimOffset = inverseRadicalInverse(pm, aPrimes[i], aBaseExponents[i]);
+			uint64_t m = aSampleStride / scale;
+			m_pixelOffset += dimOffset * m * multiplicativeInverse((int64_t)m, scale);
+		}
+		m_pixelOffset %= aSampleStride;
+
+		ALowDiscrepancySampler::startPixel(p);
+	}
+
+	Float AHaltonSampler::sampleDimension(uint64_t index, uint32_t dimension) const
+	{
+		// The digits below the scales select the pixel, the ones above them are the position in it
+		if (dimension == 0)
+			return radicalInverse(2, index >> aBaseExponents[0]);
+		if (dimension == 1)
+			return radicalInverse(3, index / aBaseScales[1]);
+
+		// Past the prime table the bases repeat with other scrambles
+		const int nBases = aPrimeTableSize - 2;
+		int base = aPrimes[2 + (dimension - 2) % nBases];
+		uint32_t hash = (uint32_t)mixBits(((uint64_t)dimension << 32) | m_seed);
+		return owenScrambledRadicalInverse(base, index, hash);
+	}
+
+	Float AHaltonSampler::sample1D(int64_t index, uint32_t dimension) const
+	{
+		return sampleDimension(haltonIndex(index), dimension);
+	}
+
+	AVector2f AHaltonSampler::sample2D(int64_t index, uint32_t dimension) const
+	{
+		uint64_t i = haltonIndex(index);
+		return AVector2f(sampleDimension(i, dimension), sampleDimension(i, dimension + 1));
+	}
+
+}
\ No newline at end of file
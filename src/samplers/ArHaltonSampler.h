@@ -0,0 +1,45 @@
+#ifndef ARHALTONSAMPLER_H
+#define ARHALTONSAMPLER_H
+
+#include "ArLowDiscrepancy.h"
+
+namespace Aurora
+{
+	//Note: the Halton sequence over the whole image (Keller 2013). The first two dimensions
+	//      are scaled by 2^7 and 3^5 so that they tile the image with blocks of 128 x 243 pixels,
+	//      the index of the n-th sample of a pixel follows from the Chinese remainder theorem
+	//      without any search. The other dimensions use the following prime bases with Owen
+	//      scrambling, which removes the correlation between the bases of higher primes.
+	class AHaltonSampler final : public ALowDiscrepancySampler
+	{
+	public:
+		typedef std::shared_ptr<AHaltonSampler> ptr;
+
+		AHaltonSampler(const APropertyTreeNode &node);
+		AHaltonSampler(int64_t samplesPerPixel, int seed = 0);
+
+		virtual void startPixel(const AVector2i &p) override;
+
+		virtual std::unique_ptr<ASampler> clone(int seed) override;
+
+		virtual std::string toString() const override { return "HaltonSampler[]"; }
+
+	protected:
+		virtual Float sample1D(int64_t index, uint32_t dimension) const override;
+		virtual AVector2f sample2D(int64_t index, uint32_t dimension) const override;
+
+	private:
+		// Index into the Halton sequence of sample |index| of the current pixel
+		uint64_t haltonIndex(int64_t index) const { return m_pixelOffset + (uint64_t)index * aSampleStride; }
+
+		Float sampleDimension(uint64_t haltonIndex, uint32_t dimension) const;
+
+		static constexpr int aBaseScales[2] = { 128, 243 };
+		static constexpr int aBaseExponents[2] = { 7, 5 };
+		static constexpr uint64_t aSampleStride = 128 * 243;
+
+		uint64_t m_pixelOffset = 0;
+	};
+}
+
+#endif
\ No newline at end of file
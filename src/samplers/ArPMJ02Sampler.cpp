@@ -0,0 +1,72 @@
+#include "ArPMJ02Sampler.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(APMJ02Sampler, "PMJ02")
+
+	constexpr int APMJ02Sampler::aNumSets;
+	constexpr int APMJ02Sampler::aMaxSetSize;
+
+	APMJ02Sampler::APMJ02Sampler(const APropertyTreeNode &node) : ALowDiscrepancySampler(node.getPropertyList())
+	{
+		if (!isPowerOf2(samplesPerPixel))
+			LOG(WARNING) << "PMJ02 sampler with " << samplesPerPixel << " samples per pixel, powers of two stratify best";
+		generateSets();
+		activate();
+	}
+
+	APMJ02Sampler::APMJ02Sampler(int64_t samplesPerPixel, int seed) : ALowDiscrepancySampler(samplesPerPixel, seed)
+	{
+		generateSets();
+	}
+
+	void APMJ02Sampler::generateSets()
+	{
+		// Sample arrays and sample counts beyond the table size continue in other tables
+		int64_t setSize = glm::clamp(roundUpPow2(samplesPerPixel), (int64_t)2, (int64_t)aMaxSetSize);
+		m_log2SetSize = log2Int((uint64_t)setSize);
+
+		std::shared_ptr<std::vector<AVector2f>> sets = std::make_shared<std::vector<AVector2f>>(aNumSets * setSize);
+		ARng rng(m_seed);
+		for (int i = 0; i < aNumSets; ++i)
+			generatePMJ02(&(*sets)[i * setSize], (int)setSize, rng);
+		m_sets = sets;
+	}
+
+	std::unique_ptr<ASampler> APMJ02Sampler::clone(int seed)
+	{
+		APMJ02Sampler *ps = new APMJ02Sampler(*this);
+		ps->setCloneSeed(seed);
+		return std::unique_ptr<ASampler>(ps);
+	}
+
+	Float APMJ02Sampler::sample1D(int64_t index, uint32_t dimension) const
+	{
+		return sample2D(index, dimension).x;
+	}
+
+	AVector2f APMJ02Sampler::sample2D(int64_t index, uint32_t dimension) const
+	{
+		uint64_t hash = hashSample(m_currentPixel, dimension, m_seed);
+		uint64_t wrap = (uint64_t)index >> m_log2SetSize;
+		if (wrap > 0)
+			hash = mixBits(hash ^ wrap);
+
+		// Shuffling the order within the aligned blocks of 2^k samples keeps every prefix of a
+		// power of two length a (0,2) set
+		const int shift = 32 - m_log2SetSize;
+		uint32_t i = (uint32_t)index & ((1u << m_log2SetSize) - 1);
+		i = nestedUniformScramble(i << shift, (uint32_t)hash) >> shift;
+
+		int set = (int)((hash >> 32) % aNumSets);
+		const AVector2f &u = (*m_sets)[((size_t)set << m_log2SetSize) + i];
+
+		// Scramble the coordinates like the digits of the (0,2) points
+		uint64_t scramble = mixBits(hash);
+		uint32_t x = (uint32_t)((double)u.x * 4294967296.0);
+		uint32_t y = (uint32_t)((double)u.y * 4294967296.0);
+		return AVector2f(toUnitFloat(nestedUniformScramble(x, (uint32_t)scramble)),
+			toUnitFloat(nestedUniformScramble(y, (uint32_t)(scramble >> 32))));
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef ARPMJ02SAMPLER_H
+#define ARPMJ02SAMPLER_H
+
+#include "ArLowDiscrepancy.h"
+
+namespace Aurora
+{
+	//Note: progressive multi-jittered (0,2) samples (Christensen et al. 2018) from a few tables
+	//      generated once per scene. Every dimension of a pixel picks a table, shuffles the
+	//      order of its samples and scrambles their coordinates by a hash of the pixel and the
+	//      dimension, all of which keeps the (0,2) stratification. The tables are shared by the
+	//      clones of a sampler.
+	class APMJ02Sampler final : public ALowDiscrepancySampler
+	{
+	public:
+		typedef std::shared_ptr<APMJ02Sampler> ptr;
+
+		APMJ02Sampler(const APropertyTreeNode &node);
+		APMJ02Sampler(int64_t samplesPerPixel, int seed = 0);
+
+		virtual int roundCount(int n) const override { return (int)roundUpPow2(n); }
+
+		virtual std::unique_ptr<ASampler> clone(int seed) override;
+
+		virtual std::string toString() const override { return "PMJ02Sampler[]"; }
+
+	protected:
+		virtual Float sample1D(int64_t index, uint32_t dimension) const override;
+		virtual AVector2f sample2D(int64_t index, uint32_t dimension) const override;
+
+	private:
+		void generateSets();
+
+		static constexpr int aNumSets = 32;
+		static constexpr int aMaxSetSize = 1 << 16;
+
+		int m_log2SetSize;
+		std::shared_ptr<const std::vector<AVector2f>> m_sets;	//aNumSets tables of 2^m_log2SetSize samples
+	};
+}
+
+#endif
\ No newline at end of file
@@ -29,13 +29,19 @@ namespace Aurora
 
 	void ARandomSampler::startPixel(const AVector2i &p)
 	{
-		for (size_t i = 0; i < m_sampleArray1D.size(); ++i)
-			for (size_t j = 0; j < m_sampleArray1D[i].size(); ++j)
-				m_sampleArray1D[i][j] = m_rng.uniformFloat();
-
-		for (size_t i = 0; i < m_sampleArray2D.size(); ++i)
-			for (size_t j = 0; j < m_sampleArray2D[i].size(); ++j)
-				m_sampleArray2D[i][j] = { m_rng.uniformFloat(), m_rng.uniformFloat() };
+		for (size_t i = 0; i < numSampleArrays1D(); ++i)
+		{
+			Float *array = sampleArray1D(i);
+			for (size_t j = 0; j < sampleArray1DSize(i); ++j)
+				array[j] = m_rng.uniformFloat();
+		}
+
+		for (size_t i = 0; i < numSampleArrays2D(); ++i)
+		{
+			AVector2f *array = sampleArray2D(i);
+			for (size_t j = 0; j < sampleArray2DSize(i); ++j)
+				array[j] = { m_rng.uniformFloat(), m_rng.uniformFloat() };
+		}
 
 		ASampler::startPixel(p);
 	}
@@ -0,0 +1,41 @@
+#include "ArSobolSampler.h"
+
+namespace Aurora
+{
+	AURORA_REGISTER_CLASS(ASobolSampler, "Sobol")
+
+	ASobolSampler::ASobolSampler(const APropertyTreeNode &node) : ALowDiscrepancySampler(node.getPropertyList())
+	{
+		if (!isPowerOf2(samplesPerPixel))
+			LOG(WARNING) << "Sobol sampler with " << samplesPerPixel << " samples per pixel, powers of two stratify best";
+		activate();
+	}
+
+	ASobolSampler::ASobolSampler(int64_t samplesPerPixel, int seed) : ALowDiscrepancySampler(samplesPerPixel, seed) {}
+
+	std::unique_ptr<ASampler> ASobolSampler::clone(int seed)
+	{
+		ASobolSampler *ss = new ASobolSampler(*this);
+		ss->setCloneSeed(seed);
+		return std::unique_ptr<ASampler>(ss);
+	}
+
+	Float ASobolSampler::sample1D(int64_t index, uint32_t dimension) const
+	{
+		uint64_t hash = hashSample(m_currentPixel, dimension, m_seed);
+		uint32_t i = nestedUniformScramble((uint32_t)index, (uint32_t)hash);
+		return toUnitFloat(nestedUniformScramble(reverseBits32(i), (uint32_t)(hash >> 32)));
+	}
+
+	AVector2f ASobolSampler::sample2D(int64_t index, uint32_t dimension) const
+	{
+		uint64_t hash = hashSample(m_currentPixel, dimension, m_seed);
+		uint32_t i = nestedUniformScramble((uint32_t)index, (uint32_t)hash);
+		uint32_t x, y;
+		sobol2D(i, x, y);
+		uint64_t scramble = mixBits(hash);
+		return AVector2f(toUnitFloat(nestedUniformScramble(x, (uint32_t)(hash >> 32))),
+			toUnitFloat(nestedUniformScramble(y, (uint32_t)scramble)));
+	}
+
+}
\ No newline at end of file
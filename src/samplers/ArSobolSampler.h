@@ -0,0 +1,34 @@
+#ifndef ARSOBOLSAMPLER_H
+#define ARSOBOLSAMPLER_H
+
+#include "ArLowDiscrepancy.h"
+
+namespace Aurora
+{
+	//Note: Owen-scrambled Sobol points (Burley 2020). Every dimension of a pixel draws from the
+	//      first two Sobol dimensions with its own shuffle of the sample indices and its own
+	//      nested uniform scramble of the coordinates, both seeded by a hash of the pixel and the
+	//      dimension. This pads the dimensions instead of using high dimensional Sobol points,
+	//      which keeps every dimension and every pair of them well stratified. Sample counts
+	//      that are powers of two give the best results.
+	class ASobolSampler final : public ALowDiscrepancySampler
+	{
+	public:
+		typedef std::shared_ptr<ASobolSampler> ptr;
+
+		ASobolSampler(const APropertyTreeNode &node);
+		ASobolSampler(int64_t samplesPerPixel, int seed = 0);
+
+		virtual int roundCount(int n) const override { return (int)roundUpPow2(n); }
+
+		virtual std::unique_ptr<ASampler> clone(int seed) override;
+
+		virtual std::string toString() const override { return "SobolSampler[]"; }
+
+	protected:
+		virtual Float sample1D(int64_t index, uint32_t dimension) const override;
+		virtual AVector2f sample2D(int64_t index, uint32_t dimension) const override;
+	};
+}
+
+#endif
\ No newline at end of file
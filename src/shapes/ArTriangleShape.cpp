@@ -1,6 +1,8 @@
 #include "ArTriangleShape.h"
 
 #include <array>
+#include <mutex>
+#include <unordered_map>
 
 #include "ArSampler.h"
 #include "ArInteraction.h"
@@ -13,12 +15,46 @@ namespace Aurora
 {
 	//-------------------------------------------ATriangleMesh-------------------------------------
 
-	ATriangleMesh::ATriangleMesh(ATransform *objectToWorld, const std::string &filename)
+	//Note: object space mesh data shared by all the entities (and scenes) that load the same file
+	struct AMeshData
 	{
 		std::vector<AVector3f> gPosition;
 		std::vector<AVector3f> gNormal;
 		std::vector<AVector2f> gUV;
 		std::vector<int> gIndices;
+	};
+
+	static std::shared_ptr<const AMeshData> loadMeshData(const std::string &filename)
+	{
+		//Note: meshes imported so far, an import holds the lock since entities are parsed one by one
+		//      anyway. The triangle meshes keep their data alive, so a mesh is shared as long as any
+		//      scene uses it (in batch mode the rendered one and the one being parsed) and is freed
+		//      along with the last scene that references it.
+		static std::mutex cacheMutex;
+		static std::unordered_map<std::string, std::weak_ptr<const AMeshData>> cache;
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto it = cache.find(filename);
+		if (it != cache.end())
+		{
+			if (std::shared_ptr<const AMeshData> data = it->second.lock())
+				return data;
+		}
+
+		// Drop the entries of the meshes released in the meantime
+		for (auto entry = cache.begin(); entry != cache.end();)
+		{
+			if (entry->second.expired())
+				entry = cache.erase(entry);
+			else
+				++entry;
+		}
+
+		std::shared_ptr<AMeshData> data = std::make_shared<AMeshData>();
+		std::vector<AVector3f> &gPosition = data->gPosition;
+		std::vector<AVector3f> &gNormal = data->gNormal;
+		std::vector<AVector2f> &gUV = data->gUV;
+		std::vector<int> &gIndices = data->gIndices;
 
 		auto process_mesh = [&](aiMesh *mesh, const aiScene *scene) -> void
 		{
@@ -84,6 +120,17 @@ namespace Aurora
 		// Process the mesh node
 		process_node(scene->mRootNode, scene);
 
+		cache[filename] = data;
+		return data;
+	}
+
+	ATriangleMesh::ATriangleMesh(ATransform *objectToWorld, const std::string &filename)
+		: m_data(loadMeshData(filename))
+	{
+		const std::vector<AVector3f> &gPosition = m_data->gPosition;
+		const std::vector<AVector3f> &gNormal = m_data->gNormal;
+		const std::vector<AVector2f> &gUV = m_data->gUV;
+
 		// Vertex data
 		// Note: we transform the vertex into world space in advance for efficient ray intersection routine
 		m_nVertices = gPosition.size();
@@ -109,11 +156,11 @@ namespace Aurora
 				m_uv[i] = gUV[i];
 			}
 		}
+	}
 
-		m_indices.resize(gIndices.size());
-		m_indices.assign(gIndices.begin(), gIndices.end());
+	size_t ATriangleMesh::numTriangles() const { return m_data->gIndices.size() / 3; }
 
-	}
+	const std::vector<int>& ATriangleMesh::getIndices() const { return m_data->gIndices; }
 
 	//-------------------------------------------ATriangleShape-------------------------------------
 
@@ -431,6 +478,7 @@ namespace Aurora
 
 		// Override surface normal in _isect_ for triangle
 		isect.n = AVector3f(normalize(cross(dp02, dp12)));
+		isect.ng = isect.n;
 		tHit = t;
 
 		if (m_mesh->hasNormal())
@@ -452,6 +500,27 @@ namespace Aurora
 		return true;
 	}
 
+	ADirectionCone ATriangleShape::normalBounds() const
+	{
+		const auto &p0 = m_mesh->getPosition(m_indices[0]);
+		const auto &p1 = m_mesh->getPosition(m_indices[1]);
+		const auto &p2 = m_mesh->getPosition(m_indices[2]);
+		AVector3f n = cross(p1 - p0, p2 - p0);
+		if (lengthSquared(n) == 0)
+			return ADirectionCone::entireSphere();
+
+		// Note: hit() replaces the geometric normal by the interpolated shading normal,
+		//       so the cone has to face the same side as the vertex normals
+		if (m_mesh->hasNormal())
+		{
+			AVector3f ns = m_mesh->getNormal(m_indices[0]) + m_mesh->getNormal(m_indices[1])
+				+ m_mesh->getNormal(m_indices[2]);
+			if (dot(n, ns) < 0)
+				n = -n;
+		}
+		return ADirectionCone(n);
+	}
+
 	Float ATriangleShape::solidAngle(const AVector3f &p, int nSamples) const
 	{
 		// Project the vertices into the unit sphere around p.
@@ -5,6 +5,8 @@
 
 namespace Aurora
 {
+	struct AMeshData;
+
 	class ATriangleMesh final
 	{
 	public:
@@ -13,7 +15,7 @@ namespace Aurora
 
 		ATriangleMesh(ATransform *objectToWorld, const std::string &filename);
 
-		size_t numTriangles() const { return m_indices.size() / 3; }
+		size_t numTriangles() const;
 		size_t numVertices() const { return m_nVertices; }
 
 		bool hasUV() const { return m_uv != nullptr; }
@@ -23,7 +25,8 @@ namespace Aurora
 		const AVector3f& getNormal(const int &index) const { return m_normal[index]; }
 		const AVector2f& getUV(const int &index) const { return m_uv[index]; }
 
-		const std::vector<int>& getIndices() const { return m_indices; }
+		//Note: the indices are shared with the other meshes of the same file
+		const std::vector<int>& getIndices() const;
 
 	private:
 
@@ -31,8 +34,10 @@ namespace Aurora
 		std::unique_ptr<AVector3f[]> m_position = nullptr;
 		std::unique_ptr<AVector3f[]> m_normal = nullptr;
 		std::unique_ptr<AVector2f[]> m_uv = nullptr;
-		std::vector<int> m_indices;
 		int m_nVertices;
+
+		//Note: object space data of the file, cached while any mesh uses it
+		std::shared_ptr<const AMeshData> m_data;
 	};
 
 	class ATriangleShape final : public AShape
@@ -58,6 +63,8 @@ namespace Aurora
 
 		virtual Float solidAngle(const AVector3f &p, int nSamples = 512) const override;
 
+		virtual ADirectionCone normalBounds() const override;
+
 		virtual std::string toString() const override { return "TriangleShape[]"; }
 
 	private:
@@ -0,0 +1,259 @@
+//Note: offline generator of the keys of the blue noise sampler (ArBlueNoiseTables.cpp). Every
+//      pixel of a toroidal tile gets a ranking key per pair of dimensions, which selects the
+//      aligned block of Sobol points the pixel uses, and a scrambling key per dimension, which
+//      is a random digital shift of the points (Heitz et al. 2019, "A Low-Discrepancy Sampler
+//      that Distributes Monte Carlo Errors as a Blue Noise in Screen Space"). The keys start
+//      out random and are then permuted among the pixels, as in Heitz and Belcour 2019, so
+//      that the errors of neighbouring pixels for a set of test integrands differ as much as
+//      possible. The errors of all the sample counts up to 2^aMaxLogSpp enter the energy, so
+//      the error stays blue along a progressive render.
+//
+//      usage: BlueNoiseTableGen <ArBlueNoiseTables.cpp>
+
+#include "ArLowDiscrepancy.h"
+#include "ArBlueNoiseSampler.h"
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <random>
+
+using namespace Aurora;
+
+static constexpr int aTileSize = ABlueNoiseSampler::aTileSize;
+static constexpr int aNumPairs = ABlueNoiseSampler::aNumPairs;
+static constexpr int aNumPixels = aTileSize * aTileSize;
+static constexpr int aNumIntegrands = 32;
+static constexpr int aMaxLogSpp = 6;
+static constexpr int aErrorSize = aNumIntegrands * (aMaxLogSpp + 1);
+static constexpr int aRadius = 6;
+
+struct AKeys { uint8_t rank, scrambleX, scrambleY; };
+
+struct APixelKeys { AKeys pairs[aNumPairs]; };
+
+// The samples the sampler takes with these keys at the 8 bit resolution of the keys
+static void keySample(const AKeys &keys, uint32_t pair, uint32_t index, double &x, double &y)
+{
+	const uint8_t k[3] = { keys.rank, keys.scrambleX, keys.scrambleY };
+	uint32_t sx, sy;
+	ABlueNoiseSampler::keyedSample(k, pair, index, sx, sy);
+	x = ((sx >> 24) + 0.5) / 256.0;
+	y = ((sy >> 24) + 0.5) / 256.0;
+}
+
+// A random half plane of the unit square
+struct AHeaviside
+{
+	double nx, ny, c, reference;
+	double operator()(double x, double y) const { return nx * x + ny * y > c ? 1.0 : 0.0; }
+};
+
+// The product of half planes in some of the pairs of dimensions. The ones of a single pair
+// make the error of every pair blue, the ones of several pairs make the errors of integrands
+// that couple the pairs blue, as the light selection and the light sample of a path do.
+struct AIntegrand
+{
+	bool used[aNumPairs];
+	AHeaviside factors[aNumPairs];
+	double reference;
+};
+
+static AHeaviside randomHeaviside(std::mt19937 &rng)
+{
+	std::uniform_real_distribution<double> uniform;
+	AHeaviside h;
+	double phi = 2 * M_PI * uniform(rng);
+	h.nx = std::cos(phi);
+	h.ny = std::sin(phi);
+	h.c = h.nx * uniform(rng) + h.ny * uniform(rng);
+	const int n = 1 << 20;
+	double sum = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		uint32_t x, y;
+		sobol2D((uint32_t)i, x, y);
+		sum += h((x + 0.5) / 4294967296.0, (y + 0.5) / 4294967296.0);
+	}
+	h.reference = sum / n;
+	return h;
+}
+
+static void computeErrors(const APixelKeys &keys, const std::vector<AIntegrand> &integrands, float *errors)
+{
+	double u[1 << aMaxLogSpp][aNumPairs][2];
+	for (uint32_t n = 0; n < (1u << aMaxLogSpp); ++n)
+		for (uint32_t pair = 0; pair < aNumPairs; ++pair)
+			keySample(keys.pairs[pair], pair, n, u[n][pair][0], u[n][pair][1]);
+
+	for (int i = 0; i < aNumIntegrands; ++i)
+	{
+		const AIntegrand &f = integrands[i];
+		double sum = 0;
+		uint32_t n = 0;
+		for (int l = 0; l <= aMaxLogSpp; ++l)
+		{
+			for (; n < (1u << l); ++n)
+			{
+				double v = 1;
+				for (int pair = 0; pair < aNumPairs; ++pair)
+				{
+					if (f.used[pair])
+						v *= f.factors[pair](u[n][pair][0], u[n][pair][1]);
+				}
+				sum += v;
+			}
+			errors[l * aNumIntegrands + i] = (float)(sum / n - f.reference);
+		}
+	}
+}
+
+static void optimize(std::vector<APixelKeys> &keys, std::mt19937 &rng)
+{
+	// Half of the integrands depend on a single pair, the others on two or more pairs
+	std::vector<AIntegrand> integrands(aNumIntegrands);
+	std::uniform_int_distribution<int> pairDist(0, aNumPairs - 1);
+	for (int i = 0; i < aNumIntegrands; ++i)
+	{
+		AIntegrand &f = integrands[i];
+		for (int pair = 0; pair < aNumPairs; ++pair)
+			f.used[pair] = false;
+		if (i < aNumIntegrands / 2)
+			f.used[i % aNumPairs] = true;
+		else
+		{
+			int nUsed = 2 + (i % (aNumPairs - 1));
+			for (int k = 0; k < nUsed;)
+			{
+				int pair = pairDist(rng);
+				if (!f.used[pair])
+				{
+					f.used[pair] = true;
+					++k;
+				}
+			}
+		}
+		f.reference = 1;
+		for (int pair = 0; pair < aNumPairs; ++pair)
+		{
+			if (f.used[pair])
+			{
+				f.factors[pair] = randomHeaviside(rng);
+				f.reference *= f.factors[pair].reference;
+			}
+		}
+	}
+
+	std::uniform_int_distribution<int> byte(0, 255);
+	for (APixelKeys &k : keys)
+		for (AKeys &pk : k.pairs)
+			pk = { (uint8_t)byte(rng), (uint8_t)byte(rng), (uint8_t)byte(rng) };
+
+	// Errors normalized per integrand and sample count, so that all of them weigh the same
+	std::vector<float> errors(aNumPixels * aErrorSize);
+	for (int p = 0; p < aNumPixels; ++p)
+		computeErrors(keys[p], integrands, &errors[p * aErrorSize]);
+	for (int j = 0; j < aErrorSize; ++j)
+	{
+		double sum2 = 0;
+		for (int p = 0; p < aNumPixels; ++p)
+			sum2 += errors[p * aErrorSize + j] * errors[p * aErrorSize + j];
+		float scale = (float)(1.0 / std::sqrt(sum2 / aNumPixels + 1e-12));
+		for (int p = 0; p < aNumPixels; ++p)
+			errors[p * aErrorSize + j] *= scale;
+	}
+
+	// Energy of Georgiev and Fajardo 2016 over a window of the torus
+	const float sigmaI2 = 2.1f * 2.1f, sigmaS2 = 1.0f * aErrorSize;
+	std::vector<float> spatial((2 * aRadius + 1) * (2 * aRadius + 1));
+	for (int dy = -aRadius; dy <= aRadius; ++dy)
+		for (int dx = -aRadius; dx <= aRadius; ++dx)
+			spatial[(dy + aRadius) * (2 * aRadius + 1) + dx + aRadius] = std::exp(-(dx * dx + dy * dy) / sigmaI2);
+
+	auto energy = [&](int p, const float *e, int skip) -> float
+	{
+		int px = p % aTileSize, py = p / aTileSize;
+		float E = 0;
+		for (int dy = -aRadius; dy <= aRadius; ++dy)
+		{
+			for (int dx = -aRadius; dx <= aRadius; ++dx)
+			{
+				if (dx == 0 && dy == 0)
+					continue;
+				int q = ((py + dy + aTileSize) % aTileSize) * aTileSize + (px + dx + aTileSize) % aTileSize;
+				if (q == skip)
+					continue;
+				const float *f = &errors[q * aErrorSize];
+				float d2 = 0;
+				for (int i = 0; i < aErrorSize; ++i)
+					d2 += (e[i] - f[i]) * (e[i] - f[i]);
+				E += spatial[(dy + aRadius) * (2 * aRadius + 1) + dx + aRadius] * std::exp(-d2 / sigmaS2);
+			}
+		}
+		return E;
+	};
+
+	// Greedy swaps of the keys of two pixels, the errors move along with the keys
+	std::uniform_int_distribution<int> pixel(0, aNumPixels - 1);
+	const int nSwaps = aNumPixels * 400;
+	int accepted = 0;
+	for (int s = 0; s < nSwaps; ++s)
+	{
+		int p = pixel(rng), q = pixel(rng);
+		if (p == q)
+			continue;
+		float *ep = &errors[p * aErrorSize], *eq = &errors[q * aErrorSize];
+		float before = energy(p, ep, q) + energy(q, eq, p);
+		float after = energy(p, eq, q) + energy(q, ep, p);
+		if (after < before)
+		{
+			std::swap_ranges(ep, ep + aErrorSize, eq);
+			std::swap(keys[p], keys[q]);
+			++accepted;
+		}
+	}
+	fprintf(stderr, "%d of %d swaps accepted\n", accepted, nSwaps);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: BlueNoiseTableGen <ArBlueNoiseTables.cpp>\n");
+		return 1;
+	}
+
+	std::mt19937 rng(20211);
+	std::vector<APixelKeys> keys(aNumPixels);
+	optimize(keys, rng);
+	std::vector<uint8_t> table(aNumPixels * aNumPairs * 3);
+	for (int p = 0; p < aNumPixels; ++p)
+	{
+		for (int pair = 0; pair < aNumPairs; ++pair)
+		{
+			uint8_t *k = &table[(p * aNumPairs + pair) * 3];
+			k[0] = keys[p].pairs[pair].rank;
+			k[1] = keys[p].pairs[pair].scrambleX;
+			k[2] = keys[p].pairs[pair].scrambleY;
+		}
+	}
+
+	FILE *f = fopen(argv[1], "w");
+	if (!f)
+	{
+		fprintf(stderr, "can't open %s\n", argv[1]);
+		return 1;
+	}
+	fprintf(f, "// Generated by src/tools/ArBlueNoiseTableGen.cpp, don't edit.\n\n");
+	fprintf(f, "#include \"ArBlueNoiseSampler.h\"\n\nnamespace Aurora\n{\n");
+	fprintf(f, "\tconst uint8_t ABlueNoiseSampler::aKeys[aTileSize * aTileSize * aNumPairs * 3] =\n\t{\n");
+	for (size_t i = 0; i < table.size(); ++i)
+	{
+		if (i % 24 == 0)
+			fprintf(f, "\t\t");
+		fprintf(f, "0x%02x,%s", table[i], (i % 24 == 23 || i + 1 == table.size()) ? "\n" : " ");
+	}
+	fprintf(f, "\t};\n}");
+	fclose(f);
+	return 0;
+}
\ No newline at end of file
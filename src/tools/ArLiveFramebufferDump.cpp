@@ -0,0 +1,91 @@
+//Note: reference consumer of the live framebuffer of a render started with --liveview. It
+//      takes a consistent frame of the framebuffer and writes it as a png or, for a ".pfm"
+//      file, as linear floats. With an interval it keeps on writing every new frame to the
+//      same image until the framebuffer stops changing, which an image viewer that reloads
+//      the file on change turns into a live preview.
+//
+//      usage: LiveFramebufferDump <framebuffer> <image.png|image.pfm> [<interval ms>]
+
+#include "ArLiveFramebuffer.h"
+
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+using namespace Aurora;
+
+static bool writeImage(const std::string &filename, int width, int height, const std::vector<float> &rgb)
+{
+	const std::string tmpFilename = filename + ".tmp";
+	bool written = false;
+	if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".pfm") == 0)
+	{
+		std::ofstream out(tmpFilename, std::ios::binary);
+		out << "PF\n" << width << " " << height << "\n-1.0\n";
+		for (int y = height - 1; y >= 0; --y)
+		{
+			out.write(reinterpret_cast<const char*>(&rgb[3 * (size_t)y * width]), 3 * width * sizeof(float));
+		}
+		written = (bool)out;
+	}
+	else
+	{
+		std::vector<Byte> bytes(rgb.size());
+		for (size_t i = 0; i < rgb.size(); ++i)
+		{
+			bytes[i] = (Byte)clamp(255.f * gammaCorrect(rgb[i]) + 0.5f, 0.f, 255.f);
+		}
+		written = stbi_write_png(tmpFilename.c_str(), width, height, 3, bytes.data(), 3 * width) != 0;
+	}
+
+	// Replace the image at once, so that a viewer never loads a partial file
+	std::remove(filename.c_str());
+	return written && std::rename(tmpFilename.c_str(), filename.c_str()) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	google::InitGoogleLogging(argv[0]);
+	FLAGS_logtostderr = true;
+
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: LiveFramebufferDump <framebuffer> <image.png|image.pfm> [<interval ms>]\n");
+		return 1;
+	}
+	const std::string filename = argv[2];
+	const int intervalMS = argc > 3 ? atoi(argv[3]) : 0;
+
+	ALiveFramebufferReader reader(argv[1]);
+	if (!reader.isValid())
+		return 1;
+
+	std::vector<float> rgb;
+	uint64_t lastFrame = 0;
+	auto lastChange = std::chrono::steady_clock::now();
+	while (true)
+	{
+		uint64_t frame = 0;
+		if (reader.readFrame(rgb, &frame) && frame != lastFrame)
+		{
+			if (!writeImage(filename, reader.getWidth(), reader.getHeight(), rgb))
+			{
+				fprintf(stderr, "Failed to write %s\n", filename.c_str());
+				return 1;
+			}
+			printf("Frame %llu -> %s\n", (unsigned long long)frame, filename.c_str());
+			lastFrame = frame;
+			lastChange = std::chrono::steady_clock::now();
+		}
+		if (intervalMS <= 0)
+			return lastFrame > 0 ? 0 : 1;
+
+		// The render is considered over once no frame arrived for a while
+		if (std::chrono::steady_clock::now() - lastChange > std::chrono::seconds(10))
+			return 0;
+		std::this_thread::sleep_for(std::chrono::milliseconds(intervalMS));
+	}
+}
\ No newline at end of file